@@ -1,4 +1,16 @@
 #include "application.h"
+#include "editor/camera.h"
+#include "editor/cost_comparison.h"
+#include "editor/ds_budget.h"
+#include "editor/gpu_particle_simulator.h"
+#include "gl_program_cache.h"
+#include "gl_texture_pool.h"
+#include "gl_texture_uploader.h"
+#include "gl_viewport.h"
+#include "memory_tracker.h"
+#include "spl/spl_archive.h"
+#include "spl/spl_cost_estimator.h"
+#include "texture_cache.h"
 #include "fonts/IconsFontAwesome6.h"
 
 #include <SDL2/SDL.h>
@@ -9,7 +21,9 @@
 #include <imgui_impl_sdl2.h>
 #include <imgui_impl_opengl3.h>
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -38,45 +52,24 @@ static void debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity
 }
 
 int Application::run(int argc, char** argv) {
-    SDL_SetMainReady();
-    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-        spdlog::error("SDL_Init Error: {}", SDL_GetError());
-        return 1;
+    if (argc > 1 && std::string_view(argv[1]).starts_with("--")) {
+        return runBatch(argc, argv);
     }
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-
-    constexpr auto windowFlags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
-    m_window = SDL_CreateWindow("NitroEFX", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1920, 1080, windowFlags);
-    if (m_window == nullptr) {
-        spdlog::error("SDL_CreateWindow Error: {}", SDL_GetError());
+    if (!initWindow(false)) {
         return 1;
     }
 
-    m_context = SDL_GL_CreateContext(m_window);
-    SDL_GL_MakeCurrent(m_window, m_context);
-    SDL_GL_SetSwapInterval(1); // Enable vsync
-
-	glewExperimental = GL_TRUE;
-	const GLenum glewError = glewInit();
-	if (glewError != GLEW_OK) {
-		spdlog::error("GLEW Error: {}", (const char*)glewGetErrorString(glewError));
-		return 1;
-	}
-
-	glEnable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_DEBUG_OUTPUT);
-	glDebugMessageCallback(debugCallback, nullptr);
+    // Created before the uploader, whose worker decodes through it
+    if (char* prefPath = SDL_GetPrefPath("nitroefx", "nitroefx")) {
+        g_textureCache = new TextureCache(std::filesystem::path(prefPath) / "texture_cache");
+        g_programCache = new GLProgramCache(std::filesystem::path(prefPath) / "program_cache");
+        SDL_free(prefPath);
+    }
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDepthFunc(GL_LESS);
+    // Batch mode never gets here, so its textures stay synchronous
+    g_textureUploader = new GLTextureUploader(m_window, m_context);
+    g_texturePool = new GLTexturePool();
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -98,6 +91,7 @@ int Application::run(int argc, char** argv) {
 		const auto now = std::chrono::high_resolution_clock::now();
 		const auto delta = std::chrono::duration<float>(now - lastFrame).count();
         pollEvents();
+        g_textureUploader->update();
 
 		m_editor->updateParticles(delta);
 		m_editor->renderParticles();
@@ -129,9 +123,365 @@ int Application::run(int argc, char** argv) {
 		lastFrame = now;
     }
 
+    // Flushes the project catalog and releases the editors while the GL context is still alive
+    g_projectManager->closeProject(true);
+
+    delete g_texturePool;
+    g_texturePool = nullptr;
+
+    // The uploader's worker may still be decoding through the cache
+    delete g_textureUploader;
+    g_textureUploader = nullptr;
+
+    delete g_textureCache;
+    g_textureCache = nullptr;
+
+    delete g_programCache;
+    g_programCache = nullptr;
+
     return 0;
 }
 
+bool Application::initWindow(bool hidden) {
+    SDL_SetMainReady();
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        spdlog::error("SDL_Init Error: {}", SDL_GetError());
+        return false;
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+
+    // Batch commands still need a GL context, but no visible window
+    const auto windowFlags = SDL_WINDOW_OPENGL | (hidden ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+    m_window = SDL_CreateWindow("NitroEFX", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1920, 1080, windowFlags);
+    if (m_window == nullptr) {
+        spdlog::error("SDL_CreateWindow Error: {}", SDL_GetError());
+        return false;
+    }
+
+    m_context = SDL_GL_CreateContext(m_window);
+    SDL_GL_MakeCurrent(m_window, m_context);
+    SDL_GL_SetSwapInterval(1); // Enable vsync
+
+	glewExperimental = GL_TRUE;
+	const GLenum glewError = glewInit();
+	if (glewError != GLEW_OK) {
+		spdlog::error("GLEW Error: {}", (const char*)glewGetErrorString(glewError));
+		return false;
+	}
+
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(debugCallback, nullptr);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthFunc(GL_LESS);
+
+    return true;
+}
+
+int Application::runBatch(int argc, char** argv) {
+    const std::string_view command = argv[1];
+
+    if (command == "--validate-gpu") {
+        if (argc < 3) {
+            spdlog::error("Usage: nitroefx --validate-gpu <archive.spa> [frames]");
+            return 1;
+        }
+
+        if (!initWindow(true)) {
+            return 1;
+        }
+
+        const u32 frames = argc > 3 ? (u32)std::strtoul(argv[3], nullptr, 10) : 120;
+        return validateGPU(argv[2], frames) ? 0 : 1;
+    }
+
+    if (command == "--compare") {
+        if (argc < 4) {
+            spdlog::error("Usage: nitroefx --compare <a.spa> <b.spa> [resource index|all] [frames]");
+            return 1;
+        }
+
+        if (!initWindow(true)) {
+            return 1;
+        }
+
+        const std::string_view resource = argc > 4 ? argv[4] : "all";
+        const u32 frames = argc > 5 ? (u32)std::strtoul(argv[5], nullptr, 10) : 300;
+        return compareArchives(argv[2], argv[3], resource, frames) ? 0 : 1;
+    }
+
+    if (command == "--estimate") {
+        if (argc < 3) {
+            spdlog::error("Usage: nitroefx --estimate <archive.spa|directory> [peak|steady|vram] [top]");
+            return 1;
+        }
+
+        const std::string_view sortKey = argc > 3 ? argv[3] : "peak";
+        const size_t top = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 50;
+        return estimateCosts(argv[2], sortKey, top) ? 0 : 1;
+    }
+
+    if (command == "--memory-report") {
+        if (argc < 3) {
+            spdlog::error("Usage: nitroefx --memory-report [--frames <n>] <archive.spa>...");
+            return 1;
+        }
+
+        u32 frames = 60;
+        std::vector<std::filesystem::path> paths;
+        for (int i = 2; i < argc; i++) {
+            if (std::string_view(argv[i]) == "--frames" && i + 1 < argc) {
+                frames = (u32)std::strtoul(argv[++i], nullptr, 10);
+            } else {
+                paths.emplace_back(argv[i]);
+            }
+        }
+
+        if (!initWindow(true)) {
+            return 1;
+        }
+
+        return reportMemory(paths, frames) ? 0 : 1;
+    }
+
+    spdlog::error("Unknown command: {}", command);
+    return 1;
+}
+
+bool Application::validateGPU(const std::filesystem::path& path, u32 frames) {
+    const SPLArchive archive(path);
+    bool passed = true;
+
+    for (size_t i = 0; i < archive.getResourceCount(); i++) {
+        const auto report = GPUParticleSimulator::validate(
+            archive.getResource(i),
+            archive.getTextures(),
+            frames,
+            1.0f / SPLArchive::SPL_FRAMES_PER_SECOND
+        );
+
+        const auto log = report.passed ? spdlog::level::info : spdlog::level::err;
+        spdlog::log(log, "[{}] {} ({} particles, {} frames{}): alive mismatches {}, pos {:.2e}, vel {:.2e}, color {:.2e}, alpha {:.2e}, scale {:.2e}",
+            i,
+            report.passed ? "PASS" : "FAIL",
+            report.particles,
+            report.frames,
+            report.deterministic ? "" : ", counts only",
+            report.aliveMismatches,
+            report.maxPositionError,
+            report.maxVelocityError,
+            report.maxColorError,
+            report.maxAlphaError,
+            report.maxScaleError
+        );
+
+        passed &= report.passed;
+    }
+
+    return passed;
+}
+
+bool Application::compareArchives(const std::filesystem::path& a, const std::filesystem::path& b, std::string_view resource, u32 frames) {
+    const SPLArchive archiveA(a);
+    const SPLArchive archiveB(b);
+
+    size_t first = 0;
+    size_t last = std::min(archiveA.getResourceCount(), archiveB.getResourceCount());
+    if (resource != "all") {
+        first = std::strtoull(resource.data(), nullptr, 10);
+        last = first + 1;
+    }
+
+    if (first >= archiveA.getResourceCount() || first >= archiveB.getResourceCount()) {
+        spdlog::error("Resource {} does not exist in both archives", first);
+        return false;
+    }
+
+    if (archiveA.getResourceCount() != archiveB.getResourceCount()) {
+        spdlog::warn("Resource counts differ ({} vs {}), comparing the first {}",
+            archiveA.getResourceCount(), archiveB.getResourceCount(), last);
+    }
+
+    CostComparisonSettings settings;
+    settings.frames = frames;
+    settings.deltaTime = 1.0f / SPLArchive::SPL_FRAMES_PER_SECOND;
+
+    const auto delta = [](f64 before, f64 after) {
+        return before > 0 ? (after - before) / before * 100.0 : 0.0;
+    };
+
+    for (size_t i = first; i < last; i++) {
+        const auto [statsA, statsB] = CostComparator::compare(archiveA, i, archiveB, i, settings);
+
+        spdlog::info("[{}] {} frames (A) / {} frames (B)", i, statsA.frames, statsB.frames);
+        spdlog::info("    peak particles   {:>10} {:>10} {:+.1f}%", statsA.peakParticles, statsB.peakParticles, delta(statsA.peakParticles, statsB.peakParticles));
+        spdlog::info("    avg particles    {:>10.1f} {:>10.1f} {:+.1f}%", statsA.averageParticles, statsB.averageParticles, delta(statsA.averageParticles, statsB.averageParticles));
+        spdlog::info("    update ns/frame  {:>10.0f} {:>10.0f} {:+.1f}%", statsA.updateNsPerFrame, statsB.updateNsPerFrame, delta(statsA.updateNsPerFrame, statsB.updateNsPerFrame));
+        spdlog::info("    instance bytes   {:>10} {:>10} {:+.1f}%", statsA.peakInstanceBytes, statsB.peakInstanceBytes, delta((f64)statsA.peakInstanceBytes, (f64)statsB.peakInstanceBytes));
+        spdlog::info("    peak overdraw    {:>10.2f} {:>10.2f} {:+.1f}%", statsA.peakOverdraw, statsB.peakOverdraw, delta(statsA.peakOverdraw, statsB.peakOverdraw));
+        spdlog::info("    avg overdraw     {:>10.2f} {:>10.2f} {:+.1f}%", statsA.averageOverdraw, statsB.averageOverdraw, delta(statsA.averageOverdraw, statsB.averageOverdraw));
+        spdlog::info("    overflow frames  {:>10} {:>10}", statsA.overflowFrames, statsB.overflowFrames);
+
+        if (statsA.saturated || statsB.saturated) {
+            spdlog::warn("    particle pool exhausted, counts are a lower bound");
+        }
+    }
+
+    return true;
+}
+
+bool Application::estimateCosts(const std::filesystem::path& path, std::string_view sortKey, size_t top) {
+    struct Entry {
+        std::filesystem::path archive;
+        size_t index;
+        SPLCostEstimate cost;
+    };
+
+    std::vector<std::filesystem::path> archives;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".spa") {
+                archives.push_back(entry.path());
+            }
+        }
+    } else {
+        archives.push_back(path);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<Entry> entries;
+    for (const auto& archivePath : archives) {
+        const SPLArchive archive(archivePath, false);
+        const auto costs = SPLCostEstimator::estimate(archive);
+        for (size_t i = 0; i < costs.size(); i++) {
+            entries.push_back({ archivePath, i, costs[i] });
+        }
+    }
+
+    const auto key = [sortKey](const Entry& entry) -> f32 {
+        if (sortKey == "steady") {
+            return entry.cost.getSteadyTotal();
+        } else if (sortKey == "vram") {
+            return (f32)(entry.cost.textureBytes + entry.cost.paletteBytes);
+        }
+
+        return entry.cost.getPeakTotal();
+    };
+
+    std::ranges::sort(entries, [&](const Entry& a, const Entry& b) { return key(a) > key(b); });
+
+    const auto elapsed = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Estimated {} resources in {} archives in {:.2f} ms", entries.size(), archives.size(), elapsed);
+
+    for (size_t i = 0; i < std::min(top, entries.size()); i++) {
+        const auto& [archive, index, cost] = entries[i];
+        const bool overflow = cost.getPeakTotal() > DSLimits::MAX_VERTICES / 4;
+
+        spdlog::log(overflow ? spdlog::level::warn : spdlog::level::info,
+            "{}[{}]: peak {:.0f} ({:.0f} children), steady {:.1f} ({:.1f} children), {:.1f}/s, {} instance bytes, {} textures, {} + {} bytes VRAM",
+            archive.filename().string(),
+            index,
+            cost.getPeakTotal(),
+            cost.peakChildren,
+            cost.getSteadyTotal(),
+            cost.steadyChildren,
+            cost.emissionRate,
+            cost.peakInstanceBytes,
+            cost.textureCount,
+            cost.textureBytes,
+            cost.paletteBytes
+        );
+    }
+
+    return !archives.empty();
+}
+
+bool Application::reportMemory(const std::vector<std::filesystem::path>& paths, u32 frames) {
+    // Holds the same things an editor tab does
+    struct Tab {
+        std::filesystem::path path;
+        std::unique_ptr<SPLArchive> archive;
+        std::unique_ptr<ParticleSystem> particleSystem;
+        std::unique_ptr<GLViewport> viewport;
+    };
+
+    std::vector<Tab> tabs;
+    Camera camera(glm::radians(45.0f), { 800, 600 }, 1.0f, 500.0f);
+
+    for (const auto& path : paths) {
+        auto archive = std::make_unique<SPLArchive>();
+        if (!archive->parse(path)) {
+            spdlog::error("Failed to open {}", path.string());
+            continue;
+        }
+
+        archive->createTextures();
+
+        auto particleSystem = std::make_unique<ParticleSystem>(1000, archive->getTextures());
+        auto viewport = std::make_unique<GLViewport>(glm::vec2(800, 600));
+
+        // Play every resource for a while so the instance lists grow like they do in the editor
+        for (const auto& resource : archive->getResources()) {
+            particleSystem->addEmitter(resource);
+        }
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            particleSystem->update(1.0f / SPLArchive::SPL_FRAMES_PER_SECOND);
+
+            viewport->bind();
+            particleSystem->render(camera.getView(), camera.getProj(), camera.getPosition());
+            viewport->unbind();
+        }
+
+        tabs.push_back({ path, std::move(archive), std::move(particleSystem), std::move(viewport) });
+    }
+
+    glFinish();
+
+    for (const auto& tab : tabs) {
+        memory::Usage usage;
+        tab.archive->getMemoryUsage(usage);
+        tab.particleSystem->getMemoryUsage(usage);
+        usage[memory::Category::Framebuffers] += tab.viewport->getMemoryUsage();
+
+        spdlog::info("{}: CPU {}, GPU {}",
+            tab.path.filename().string(),
+            memory::formatSize(usage.getTotal() - usage.getGPUTotal()),
+            memory::formatSize(usage.getGPUTotal())
+        );
+
+        for (size_t i = 0; i < memory::CATEGORY_COUNT; i++) {
+            if (usage.bytes[i] > 0) {
+                spdlog::info("    {:<16} {:>10}", memory::getName((memory::Category)i), memory::formatSize(usage.bytes[i]));
+            }
+        }
+    }
+
+    // Process wide, this includes what the tabs share and temporaries that are gone by now
+    spdlog::info("Total over {} archives ({:>10} {:>10} {:>12})", tabs.size(), "current", "peak", "allocations");
+    for (size_t i = 0; i < memory::CATEGORY_COUNT; i++) {
+        const auto category = (memory::Category)i;
+        spdlog::info("    {:<16} {:>10} {:>10} {:>12}",
+            memory::getName(category),
+            memory::formatSize(memory::getCurrent(category)),
+            memory::formatSize(memory::getPeak(category)),
+            memory::getAllocationCount(category)
+        );
+    }
+
+    return tabs.size() == paths.size();
+}
+
 void Application::pollEvents() {
 	SDL_Event event;
 	while (SDL_PollEvent(&event)) {
@@ -197,9 +547,9 @@ void Application::handleKeydown(const SDL_Event& event) {
 	case SDLK_s:
 		if (event.key.keysym.mod & KMOD_CTRL) {
 			if (event.key.keysym.mod & KMOD_SHIFT) {
-				spdlog::warn("Save All not implemented");
-			} else {
-				spdlog::warn("Save not implemented");
+				g_projectManager->saveAllEditors();
+			} else if (g_projectManager->hasActiveEditor()) {
+				g_projectManager->saveEditor(g_projectManager->getActiveEditor());
 			}
 		}
 		break;
@@ -288,7 +638,7 @@ void Application::renderMenuBar() {
 			}
 
 			if (ImGui::MenuItem(ICON_FA_FLOPPY_DISK " Save", "Ctrl+S", false, hasActiveEditor)) {
-				spdlog::warn("Save not implemented");
+				g_projectManager->saveEditor(g_projectManager->getActiveEditor());
 			}
 
 			if (ImGui::MenuItem(ICON_FA_FLOPPY_DISK " Save As...", nullptr, false, hasActiveEditor)) {
@@ -296,7 +646,7 @@ void Application::renderMenuBar() {
 			}
 
 			if (ImGui::MenuItem(ICON_FA_FLOPPY_DISK " Save All", "Ctrl+Shift+S", false, hasOpenEditors)) {
-				spdlog::warn("Save All not implemented");
+				g_projectManager->saveAllEditors();
 			}
 
 			if (ImGui::MenuItem(ICON_FA_XMARK " Close", "Ctrl+W", false, hasActiveEditor)) {
@@ -355,6 +705,14 @@ void Application::renderMenuBar() {
 				m_editor->openEditor();
 			}
 
+			if (ImGui::MenuItem("DS Budget")) {
+				m_editor->openBudget();
+			}
+
+			if (ImGui::MenuItem("Memory")) {
+				m_editor->openMemory();
+			}
+
 			ImGui::EndMenu();
 		}
 
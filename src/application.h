@@ -4,7 +4,9 @@
 #include "editor/project_manager.h"
 
 #include <SDL_events.h>
+#include <filesystem>
 #include <string_view>
+#include <vector>
 
 
 class Application {
@@ -12,6 +14,15 @@ public:
     int run(int argc, char** argv);
 
 private:
+    bool initWindow(bool hidden);
+
+    // Command line batch mode, runs without the editor UI
+    int runBatch(int argc, char** argv);
+    static bool validateGPU(const std::filesystem::path& path, u32 frames);
+    static bool compareArchives(const std::filesystem::path& a, const std::filesystem::path& b, std::string_view resource, u32 frames);
+    static bool estimateCosts(const std::filesystem::path& path, std::string_view sortKey, size_t top);
+    static bool reportMemory(const std::vector<std::filesystem::path>& paths, u32 frames);
+
     void pollEvents();
     void handleKeydown(const SDL_Event& event);
     void dispatchEvent(const SDL_Event& event);
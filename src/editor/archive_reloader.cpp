@@ -0,0 +1,221 @@
+#include "archive_reloader.h"
+#include "editor_instance.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <unordered_set>
+
+
+namespace {
+
+// The file on disk holding the archive, which is the outermost container for paths like "effects.narc/0003.spa"
+std::filesystem::path getSourceFile(const std::filesystem::path& path) {
+    std::filesystem::path source;
+    for (const auto& component : path) {
+        source /= component;
+
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(source, ec)) {
+            return std::filesystem::absolute(source, ec);
+        }
+    }
+
+    return {};
+}
+
+}
+
+
+std::vector<std::shared_ptr<EditorInstance>> ArchiveReloader::update(std::span<const std::shared_ptr<EditorInstance>> editors) {
+    updateWatches(editors);
+
+    const auto now = Clock::now();
+    for (const auto& event : m_watcher.poll()) {
+        // Replacing a file by renaming a new one over it shows up as Added
+        if (event.type != FileWatchEvent::Type::Removed) {
+            m_changedFiles[event.path.string()] = now;
+        }
+    }
+
+    startReloads(editors);
+
+    std::vector<std::shared_ptr<EditorInstance>> reloaded;
+    for (auto it = m_reloads.begin(); it != m_reloads.end();) {
+        if ((*it)->done) {
+            finishReload(**it, editors, reloaded);
+            it = m_reloads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return reloaded;
+}
+
+void ArchiveReloader::updateWatches(std::span<const std::shared_ptr<EditorInstance>> editors) {
+    std::erase_if(m_sourceFiles, [editors](const auto& entry) {
+        return std::ranges::none_of(editors, [id = entry.first](const auto& editor) { return editor->getUniqueID() == id; });
+    });
+
+    std::set<std::filesystem::path> directories;
+    for (const auto& editor : editors) {
+        if (!editor->isLoaded()) {
+            continue;
+        }
+
+        auto& source = m_sourceFiles[editor->getUniqueID()];
+        if (source.empty()) {
+            source = getSourceFile(editor->getPath());
+        }
+
+        if (!source.empty()) {
+            directories.insert(source.parent_path());
+        }
+    }
+
+    for (const auto& directory : directories) {
+        if (!m_watchedDirectories.contains(directory)) {
+            m_watcher.watch(directory);
+        }
+    }
+
+    for (const auto& directory : m_watchedDirectories) {
+        if (!directories.contains(directory)) {
+            m_watcher.unwatch(directory);
+        }
+    }
+
+    m_watchedDirectories = std::move(directories);
+}
+
+void ArchiveReloader::startReloads(std::span<const std::shared_ptr<EditorInstance>> editors) {
+    const auto now = Clock::now();
+
+    for (auto it = m_changedFiles.begin(); it != m_changedFiles.end();) {
+        if (now - it->second < SETTLE_TIME) {
+            ++it;
+            continue;
+        }
+
+        bool deferred = false;
+        std::vector<std::shared_ptr<SPLArchive>> started;
+
+        for (const auto& editor : editors) {
+            if (!editor->isLoaded() || m_sourceFiles[editor->getUniqueID()].string() != it->first) {
+                continue;
+            }
+
+            const auto& archive = editor->getSharedArchive();
+            if (std::ranges::find(started, archive) != started.end()) {
+                continue;
+            }
+
+            // Written by SPLArchive::save, the archive already holds what is on disk
+            if (archive->isSourceUnchanged()) {
+                continue;
+            }
+
+            // Still parsing the previous version, start over once that one is in
+            if (std::ranges::any_of(m_reloads, [&archive](const auto& reload) { return reload->archive == archive; })) {
+                deferred = true;
+                continue;
+            }
+
+            const bool modified = std::ranges::any_of(editors, [&archive](const auto& other) {
+                return other->isLoaded() && other->getSharedArchive() == archive && other->isModified();
+            });
+
+            if (modified) {
+                spdlog::warn("{} changed on disk, not reloading it over unsaved changes", editor->getPath().string());
+                continue;
+            }
+
+            auto reload = std::make_unique<Reload>();
+            reload->archive = archive;
+            reload->path = editor->getPath();
+            reload->job = std::jthread([reload = reload.get()](std::stop_token stop) {
+                auto parsed = std::make_shared<SPLArchive>();
+                if (parsed->parse(reload->path, stop)) {
+                    reload->parsed = std::move(parsed);
+                }
+
+                reload->done = true;
+            });
+
+            started.push_back(archive);
+            m_reloads.push_back(std::move(reload));
+        }
+
+        if (deferred) {
+            ++it;
+        } else {
+            it = m_changedFiles.erase(it);
+        }
+    }
+}
+
+void ArchiveReloader::finishReload(Reload& reload, std::span<const std::shared_ptr<EditorInstance>> editors, std::vector<std::shared_ptr<EditorInstance>>& reloaded) {
+    reload.job.join();
+
+    if (!reload.parsed) {
+        spdlog::error("Failed to reload {}, keeping the previous contents", reload.path.string());
+        return;
+    }
+
+    std::vector<std::shared_ptr<EditorInstance>> users;
+    for (const auto& editor : editors) {
+        if (editor->isLoaded() && editor->getSharedArchive() == reload.archive) {
+            users.push_back(editor);
+        }
+    }
+
+    // Closed in the meantime
+    if (users.empty()) {
+        return;
+    }
+
+    // Edited while the file was being parsed
+    if (std::ranges::any_of(users, [](const auto& editor) { return editor->isModified(); })) {
+        spdlog::warn("{} changed on disk, not reloading it over unsaved changes", reload.path.string());
+        return;
+    }
+
+    const auto start = Clock::now();
+
+    auto& current = *reload.archive;
+    auto& previous = *reload.parsed;
+    current.replaceContents(previous);
+
+    size_t changedResources = 0;
+    for (size_t i = 0; i < current.getResourceCount(); i++) {
+        if (i >= previous.getResourceCount() || current.getResourceHash(i) != previous.getResourceHash(i)) {
+            ++changedResources;
+        }
+    }
+
+    std::unordered_set<u64> previousTextures;
+    for (size_t i = 0; i < previous.getTextureCount(); i++) {
+        previousTextures.insert(previous.getTextureHash(i));
+    }
+
+    size_t changedTextures = 0;
+    for (size_t i = 0; i < current.getTextureCount(); i++) {
+        if (!current.getTexture(i).param.useSharedTexture && !previousTextures.contains(current.getTextureHash(i))) {
+            ++changedTextures;
+        }
+    }
+
+    for (const auto& editor : users) {
+        editor->onArchiveReloaded(previous);
+        reloaded.push_back(editor);
+    }
+
+    spdlog::info("Reloaded {} ({} of {} resources and {} of {} textures changed), {:.2f} ms on the main thread",
+        reload.path.filename().string(),
+        changedResources,
+        current.getResourceCount(),
+        changedTextures,
+        current.getTextureCount(),
+        std::chrono::duration<f32, std::milli>(Clock::now() - start).count()
+    );
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "file_watcher.h"
+#include "types.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+class EditorInstance;
+class SPLArchive;
+
+// Reloads open archives when their file changes on disk, e.g. because another tool exported it again.
+// The file is parsed in the background and then swapped into the SPLArchive the tabs already share:
+// textures whose contents didn't change keep their GL texture, running emitters move over to the resource
+// with the same index. Tabs with unsaved changes are left alone.
+class ArchiveReloader {
+public:
+    // Call once per frame. Returns the editors whose archive was replaced.
+    std::vector<std::shared_ptr<EditorInstance>> update(std::span<const std::shared_ptr<EditorInstance>> editors);
+
+    // Writers often touch a file several times in a row, only reload once it stopped changing
+    static constexpr auto SETTLE_TIME = std::chrono::milliseconds(250);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Reload {
+        std::shared_ptr<SPLArchive> archive; // The one being replaced
+        std::filesystem::path path;
+        std::shared_ptr<SPLArchive> parsed; // Null if parsing failed
+        std::atomic<bool> done = false;
+
+        // Declared last so it is joined before anything it writes to is destroyed
+        std::jthread job;
+    };
+
+    void updateWatches(std::span<const std::shared_ptr<EditorInstance>> editors);
+    void startReloads(std::span<const std::shared_ptr<EditorInstance>> editors);
+    void finishReload(Reload& reload, std::span<const std::shared_ptr<EditorInstance>> editors, std::vector<std::shared_ptr<EditorInstance>>& reloaded);
+
+private:
+    FileWatcher m_watcher;
+    std::set<std::filesystem::path> m_watchedDirectories;
+    std::unordered_map<u64, std::filesystem::path> m_sourceFiles; // By EditorInstance::getUniqueID
+    std::unordered_map<std::string, Clock::time_point> m_changedFiles; // Source file -> last change
+    std::vector<std::unique_ptr<Reload>> m_reloads;
+};
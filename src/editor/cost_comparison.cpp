@@ -0,0 +1,98 @@
+#include "cost_comparison.h"
+#include "camera.h"
+#include "ds_budget.h"
+#include "particle_system.h"
+#include "random.h"
+#include "spl/spl_archive.h"
+
+#include <chrono>
+#include <glm/glm.hpp>
+
+
+namespace {
+
+// Large enough that typical effects never hit it, unlike the editor's pool
+constexpr u32 s_maxParticles = 1 << 14;
+
+constexpr f32 s_screenArea = (f32)(DSLimits::SCREEN_WIDTH * DSLimits::SCREEN_HEIGHT);
+
+}
+
+
+SPLRunStats CostComparator::run(const SPLResource& resource, std::span<const SPLTexture> textures, const CostComparisonSettings& settings) {
+    SPLRunStats stats{};
+
+    // Same default view as a freshly opened editor, at DS resolution
+    const Camera camera(glm::radians(45.0f), { DSLimits::SCREEN_WIDTH, DSLimits::SCREEN_HEIGHT }, 1.0f, 500.0f);
+
+    // Only the tracker sees the particles, so nothing is drawn into whatever framebuffer is bound
+    // and the instance buffer shared with the editors doesn't grow to fit s_maxParticles
+    ParticleSystem system(s_maxParticles, textures, true);
+    DSBudgetTracker tracker;
+    system.getRenderer()->setBudgetTracker(&tracker);
+
+    random::seed(settings.seed);
+    system.addEmitter(resource, settings.looping);
+
+    std::chrono::nanoseconds updateTime{};
+    f64 totalParticles = 0;
+    f64 totalOverdraw = 0;
+
+    for (u32 frame = 0; frame < settings.frames; frame++) {
+        const auto start = std::chrono::steady_clock::now();
+        system.update(settings.deltaTime);
+        updateTime += std::chrono::steady_clock::now() - start;
+
+        system.render(camera.getView(), camera.getProj(), camera.getPosition());
+
+        const auto& budget = tracker.getCurrent();
+        const u32 particles = (u32)system.getParticleCount();
+        const f32 overdraw = (f32)budget.totalFill / s_screenArea;
+
+        stats.peakParticles = std::max(stats.peakParticles, particles);
+        stats.peakInstanceBytes = std::max<u64>(stats.peakInstanceBytes, (u64)budget.polygons * sizeof(ParticleInstance));
+        stats.peakOverdraw = std::max(stats.peakOverdraw, overdraw);
+        stats.saturated |= particles >= system.getMaxParticles();
+
+        totalParticles += particles;
+        totalOverdraw += overdraw;
+        ++stats.frames;
+
+        // Single shot effects are done once everything has died
+        if (!settings.looping && system.getEmitterCount() == 0) {
+            break;
+        }
+    }
+
+    if (stats.frames > 0) {
+        stats.averageParticles = (f32)(totalParticles / stats.frames);
+        stats.averageOverdraw = (f32)(totalOverdraw / stats.frames);
+        stats.updateNsPerFrame = (f64)updateTime.count() / stats.frames;
+    }
+
+    stats.overflowFrames = tracker.getOverflowFrames();
+
+    // Don't leave the rest of the editor with a predictable sequence
+    random::reseed();
+
+    return stats;
+}
+
+CostComparison CostComparator::compare(
+    const SPLResource& a, std::span<const SPLTexture> texturesA,
+    const SPLResource& b, std::span<const SPLTexture> texturesB,
+    const CostComparisonSettings& settings
+) {
+    return {
+        .a = run(a, texturesA, settings),
+        .b = run(b, texturesB, settings)
+    };
+}
+
+CostComparison CostComparator::compare(const SPLArchive& a, size_t indexA, const SPLArchive& b, size_t indexB, const CostComparisonSettings& settings) {
+    return compare(
+        a.getResource(indexA), a.getTextures(),
+        b.getResource(indexB), b.getTextures(),
+        settings
+    );
+}
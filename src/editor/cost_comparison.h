@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.h"
+#include "spl/spl_resource.h"
+
+#include <span>
+
+
+class SPLArchive;
+
+struct CostComparisonSettings {
+    u32 frames = 300;
+    f32 deltaTime = 1.0f / 30.0f;
+    u64 seed = 0x5EED;
+    bool looping = false;
+};
+
+// Measured cost of playing a resource once (or looped) for a fixed number of frames
+struct SPLRunStats {
+    u32 frames = 0;
+    u32 peakParticles = 0;
+    f32 averageParticles = 0;
+    f64 updateNsPerFrame = 0;
+    u64 peakInstanceBytes = 0;
+    f32 peakOverdraw = 0; // DS screen fill divided by the screen area
+    f32 averageOverdraw = 0;
+    u32 overflowFrames = 0; // Frames exceeding a DS hardware limit
+    bool saturated = false; // The particle pool ran out, counts are a lower bound
+};
+
+struct CostComparison {
+    SPLRunStats a;
+    SPLRunStats b;
+};
+
+// Runs resources headless under identical seeds and timestep so their costs can be compared.
+// Nothing is drawn and the textures don't need GL objects, but the renderer's shared GL resources
+// still require a current context.
+class CostComparator {
+public:
+    static SPLRunStats run(const SPLResource& resource, std::span<const SPLTexture> textures, const CostComparisonSettings& settings);
+
+    static CostComparison compare(
+        const SPLResource& a, std::span<const SPLTexture> texturesA,
+        const SPLResource& b, std::span<const SPLTexture> texturesB,
+        const CostComparisonSettings& settings
+    );
+
+    static CostComparison compare(const SPLArchive& a, size_t indexA, const SPLArchive& b, size_t indexB, const CostComparisonSettings& settings);
+};
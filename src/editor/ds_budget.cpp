@@ -0,0 +1,194 @@
+#include "ds_budget.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+constexpr glm::vec4 s_quadCorners[4] = {
+    { -1.0f, -1.0f, 0.0f, 1.0f },
+    {  1.0f, -1.0f, 0.0f, 1.0f },
+    {  1.0f,  1.0f, 0.0f, 1.0f },
+    { -1.0f,  1.0f, 0.0f, 1.0f }
+};
+
+u32 getBitsPerTexel(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::A3I5: return 8;
+    case TextureFormat::Palette4: return 2;
+    case TextureFormat::Palette16: return 4;
+    case TextureFormat::Palette256: return 8;
+    case TextureFormat::Comp4x4: return 2;
+    case TextureFormat::A5I3: return 8;
+    case TextureFormat::Direct: return 16;
+    default: return 0;
+    }
+}
+
+u32 alignUp(u32 value, u32 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+
+void DSBudgetTracker::beginFrame(const glm::mat4& view, const glm::mat4& proj) {
+    m_current = {};
+    m_viewProj = proj * view;
+    m_scanlineFill.fill(0);
+    std::ranges::fill(m_textureUsage, 0);
+}
+
+void DSBudgetTracker::addQuad(u32 texture, const glm::mat4& transform) {
+    addQuads(texture, 1);
+
+    const glm::mat4 mvp = m_viewProj * transform;
+
+    glm::vec2 screen[4];
+    for (u32 i = 0; i < 4; i++) {
+        const glm::vec4 clip = mvp * s_quadCorners[i];
+        if (clip.w <= 0.0f) {
+            return; // Partially behind the camera, the DS would clip it anyway
+        }
+
+        const glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+        screen[i] = {
+            (ndc.x * 0.5f + 0.5f) * DSLimits::SCREEN_WIDTH,
+            (0.5f - ndc.y * 0.5f) * DSLimits::SCREEN_HEIGHT
+        };
+    }
+
+    f32 minY = screen[0].y;
+    f32 maxY = screen[0].y;
+    for (u32 i = 1; i < 4; i++) {
+        minY = std::min(minY, screen[i].y);
+        maxY = std::max(maxY, screen[i].y);
+    }
+
+    const s32 firstLine = std::max(0, (s32)std::ceil(minY - 0.5f));
+    const s32 lastLine = std::min((s32)DSLimits::SCREEN_HEIGHT - 1, (s32)std::floor(maxY - 0.5f));
+
+    // The quad is convex, so each scanline crosses it in a single span
+    for (s32 line = firstLine; line <= lastLine; line++) {
+        const f32 y = (f32)line + 0.5f;
+        f32 left = (f32)DSLimits::SCREEN_WIDTH;
+        f32 right = 0.0f;
+
+        for (u32 i = 0; i < 4; i++) {
+            const auto& a = screen[i];
+            const auto& b = screen[(i + 1) % 4];
+            if ((y < a.y) == (y < b.y)) {
+                continue;
+            }
+
+            const f32 x = a.x + (y - a.y) / (b.y - a.y) * (b.x - a.x);
+            left = std::min(left, x);
+            right = std::max(right, x);
+        }
+
+        left = std::max(left, 0.0f);
+        right = std::min(right, (f32)DSLimits::SCREEN_WIDTH);
+        if (right > left) {
+            m_scanlineFill[line] += (u32)(right - left + 0.5f);
+        }
+    }
+}
+
+void DSBudgetTracker::addQuads(u32 texture, u32 count) {
+    m_current.polygons += count;
+    m_current.vertices += count * 4;
+
+    if (texture >= m_textureUsage.size()) {
+        m_textureUsage.resize(texture + 1, 0);
+    }
+
+    m_textureUsage[texture] += count;
+}
+
+void DSBudgetTracker::endFrame(std::span<const SPLTexture> textures) {
+    // Shared textures reuse the VRAM of the texture they point to
+    std::vector<bool> resident(textures.size(), false);
+    for (size_t i = 0; i < std::min(textures.size(), m_textureUsage.size()); i++) {
+        if (m_textureUsage[i] == 0) {
+            continue;
+        }
+
+        const auto& param = textures[i].param;
+        const size_t index = param.useSharedTexture ? param.sharedTexID : i;
+        if (index < resident.size()) {
+            resident[index] = true;
+        }
+    }
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        if (resident[i]) {
+            m_current.textureBytes += getTextureVRAMSize(textures[i]);
+            m_current.paletteBytes += getPaletteVRAMSize(textures[i]);
+        }
+    }
+
+    for (const u32 fill : m_scanlineFill) {
+        m_current.totalFill += fill;
+        m_current.maxScanlineFill = std::max(m_current.maxScanlineFill, fill);
+        if (fill > m_budgets.scanlineFill) {
+            ++m_current.overflowingScanlines;
+        }
+    }
+
+    m_current.overflow.polygons = m_current.polygons > DSLimits::MAX_POLYGONS;
+    m_current.overflow.vertices = m_current.vertices > DSLimits::MAX_VERTICES;
+    m_current.overflow.textureVRAM = m_current.textureBytes > m_budgets.textureVRAM;
+    m_current.overflow.paletteVRAM = m_current.paletteBytes > m_budgets.paletteVRAM;
+    m_current.overflow.scanlineFill = m_current.overflowingScanlines > 0;
+
+    m_history[m_historyHead] = m_current;
+    m_historyHead = (m_historyHead + 1) % HISTORY_SIZE;
+    ++m_frameCount;
+
+    if (m_current.overflows()) {
+        ++m_overflowFrames;
+    }
+}
+
+void DSBudgetTracker::reset() {
+    m_current = {};
+    m_history.fill({});
+    m_historyHead = 0;
+    m_frameCount = 0;
+    m_overflowFrames = 0;
+}
+
+std::vector<DSFrameBudget> DSBudgetTracker::getHistory() const {
+    const size_t count = std::min<size_t>(m_frameCount, HISTORY_SIZE);
+
+    std::vector<DSFrameBudget> history;
+    history.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        history.push_back(m_history[(m_historyHead + HISTORY_SIZE - count + i) % HISTORY_SIZE]);
+    }
+
+    return history;
+}
+
+u32 DSBudgetTracker::getTextureVRAMSize(const SPLTexture& texture) {
+    const u32 texels = (u32)texture.width * texture.height;
+    u32 size = texels * getBitsPerTexel(texture.param.format) / 8;
+
+    // 4x4 compressed textures also need 16 bits of palette index data per block
+    if (texture.param.format == TextureFormat::Comp4x4) {
+        size += texels / 16 * 2;
+    }
+
+    return size;
+}
+
+u32 DSBudgetTracker::getPaletteVRAMSize(const SPLTexture& texture) {
+    if (texture.param.format == TextureFormat::Direct || texture.param.format == TextureFormat::None) {
+        return 0;
+    }
+
+    // 4 color palettes are 8 byte aligned, all others 16
+    const u32 alignment = texture.param.format == TextureFormat::Palette4 ? 8 : 16;
+    return alignUp((u32)texture.paletteData.size(), alignment);
+}
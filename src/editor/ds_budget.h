@@ -0,0 +1,89 @@
+#pragma once
+
+#include "types.h"
+#include "spl/spl_resource.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+
+// Limits enforced by the DS 3D engine
+struct DSLimits {
+    static constexpr u32 MAX_POLYGONS = 2048; // Polygon RAM
+    static constexpr u32 MAX_VERTICES = 6144; // Vertex RAM
+    static constexpr u32 SCREEN_WIDTH = 256;
+    static constexpr u32 SCREEN_HEIGHT = 192;
+};
+
+// Budgets that depend on how the game sets up VRAM, so they are configurable
+struct DSBudgets {
+    u32 textureVRAM = 128 * 1024; // One 128KB bank
+    u32 paletteVRAM = 16 * 1024; // Bank F
+    u32 scanlineFill = DSLimits::SCREEN_WIDTH * 4; // Pixels per scanline, rough estimate of what the renderer can keep up with
+};
+
+struct DSFrameBudget {
+    u32 polygons = 0;
+    u32 vertices = 0;
+    u32 textureBytes = 0;
+    u32 paletteBytes = 0;
+    u32 maxScanlineFill = 0; // Estimated pixels drawn on the busiest scanline
+    u32 totalFill = 0; // Estimated pixels drawn over the whole screen
+    u32 overflowingScanlines = 0;
+
+    struct {
+        bool polygons;
+        bool vertices;
+        bool textureVRAM;
+        bool paletteVRAM;
+        bool scanlineFill;
+    } overflow = {};
+
+    bool overflows() const {
+        return overflow.polygons || overflow.vertices || overflow.textureVRAM
+            || overflow.paletteVRAM || overflow.scanlineFill;
+    }
+};
+
+// Tracks the per-frame hardware metrics of the particles submitted to a ParticleRenderer.
+// Every particle is a single quad, which the DS stores as 1 polygon with 4 vertices.
+class DSBudgetTracker {
+public:
+    static constexpr size_t HISTORY_SIZE = 300;
+
+    void beginFrame(const glm::mat4& view, const glm::mat4& proj);
+    void addQuad(u32 texture, const glm::mat4& transform);
+
+    // For quads whose transforms aren't available on the CPU (GPU simulation),
+    // these don't contribute to the scanline estimate
+    void addQuads(u32 texture, u32 count);
+
+    void endFrame(std::span<const SPLTexture> textures);
+    void reset();
+
+    const DSFrameBudget& getCurrent() const { return m_current; }
+    const DSBudgets& getBudgets() const { return m_budgets; }
+    DSBudgets& getBudgets() { return m_budgets; }
+
+    // Oldest first
+    std::vector<DSFrameBudget> getHistory() const;
+    u32 getOverflowFrames() const { return m_overflowFrames; }
+    u32 getFrameCount() const { return m_frameCount; }
+
+    static u32 getTextureVRAMSize(const SPLTexture& texture);
+    static u32 getPaletteVRAMSize(const SPLTexture& texture);
+
+private:
+    DSBudgets m_budgets;
+    DSFrameBudget m_current;
+
+    glm::mat4 m_viewProj = glm::mat4(1);
+    std::array<u32, DSLimits::SCREEN_HEIGHT> m_scanlineFill = {};
+    std::vector<u32> m_textureUsage;
+
+    std::array<DSFrameBudget, HISTORY_SIZE> m_history = {};
+    size_t m_historyHead = 0;
+    u32 m_frameCount = 0;
+    u32 m_overflowFrames = 0;
+};
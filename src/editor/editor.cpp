@@ -1,6 +1,7 @@
 #include "editor.h"
 #include "project_manager.h"
 #include "spl/enum_names.h"
+#include "spl/spl_cost_estimator.h"
 #include "help_messages.h"
 
 #include <array>
@@ -9,6 +10,7 @@
 #include <glm/gtc/integer.hpp>
 #include <imgui.h>
 #include <imgui_internal.h>
+#include <spdlog/spdlog.h>
 
 #define LOCK_EDITOR() auto activeEditor_locked = m_activeEditor.lock()
 #define NOTIFY(action) activeEditor_locked->valueChanged(action)
@@ -23,12 +25,22 @@ constexpr std::array s_emitterSpawnTypes = {
     "Interval"
 };
 
+constexpr std::array s_simulationBackends = {
+    "CPU",
+    "GPU (Compute)"
+};
+
 }
 
 
 void Editor::render() {
     const auto& instances = g_projectManager->getOpenEditors();
 
+    // The budget panel only shows the active tab
+    for (const auto& instance : instances) {
+        instance->setBudgetTracking(m_budget_open && instance == g_projectManager->getActiveEditor());
+    }
+
     ImGuiWindowClass windowClass;
     windowClass.DockNodeFlagsOverrideSet = ImGuiDockNodeFlags_NoTabBar
         | ImGuiDockNodeFlags_NoDockingOverCentralNode
@@ -60,6 +72,22 @@ void Editor::render() {
         g_projectManager->closeEditor(instance);
     }
 
+    // Selections and interval spawns refer to resources by index, which may be gone after a reload
+    for (const auto& instance : m_reloader.update(g_projectManager->getOpenEditors())) {
+        const auto id = instance->getUniqueID();
+        const auto count = instance->getArchive().getResourceCount();
+
+        if (m_selectedResources.contains(id) && m_selectedResources[id] >= (int)count) {
+            m_selectedResources[id] = -1;
+        }
+
+        std::erase_if(m_emitterTasks, [id, count](const auto& task) {
+            return task.editorID == id && task.resourceIndex >= count;
+        });
+    }
+
+    m_residency.update(g_projectManager->getOpenEditors(), g_projectManager->getActiveEditor());
+
     ImGui::End();
 
     if (m_picker_open) {
@@ -69,11 +97,19 @@ void Editor::render() {
     if (m_editor_open) {
         renderResourceEditor();
     }
+
+    if (m_budget_open) {
+        renderBudgetPanel();
+    }
+
+    if (m_memory_open) {
+        renderMemoryPanel();
+    }
 }
 
 void Editor::renderParticles() {
     const auto& editor = g_projectManager->getActiveEditor();
-    if (!editor) {
+    if (!editor || !editor->isLoaded()) {
         return;
     }
 
@@ -84,13 +120,32 @@ void Editor::openPicker() {
     m_picker_open = true;
 }
 
+void Editor::initSelection(const EditorInstance& editor) {
+    const auto id = editor.getUniqueID();
+    if (m_selectedResources.contains(id)) {
+        return;
+    }
+
+    // The catalog the resource came from may be older than the archive
+    const int resource = editor.getInitialSelection();
+    m_selectedResources[id] = resource < (int)editor.getSharedArchive()->getResourceCount() ? resource : -1;
+}
+
 void Editor::openEditor() {
     m_editor_open = true;
 }
 
+void Editor::openBudget() {
+    m_budget_open = true;
+}
+
+void Editor::openMemory() {
+    m_memory_open = true;
+}
+
 void Editor::updateParticles(float deltaTime) {
     const auto& editor = g_projectManager->getActiveEditor();
-    if (!editor) {
+    if (!editor || !editor->isLoaded()) {
         return;
     }
 
@@ -110,7 +165,7 @@ void Editor::updateParticles(float deltaTime) {
 
 void Editor::playEmitterAction(EmitterSpawnType spawnType) {
     const auto& editor = g_projectManager->getActiveEditor();
-    if (!editor) {
+    if (!editor || !editor->isLoaded()) {
         return;
     }
 
@@ -132,7 +187,7 @@ void Editor::playEmitterAction(EmitterSpawnType spawnType) {
 
 void Editor::killEmitters() {
     const auto& editor = g_projectManager->getActiveEditor();
-    if (!editor) {
+    if (!editor || !editor->isLoaded()) {
         return;
     }
 
@@ -161,14 +216,18 @@ void Editor::renderResourcePicker() {
             return;
         }
 
+        if (!editor->isLoaded()) {
+            ImGui::Text("Loading...");
+            ImGui::End();
+            return;
+        }
+
         auto& archive = editor->getArchive();
         auto& resources = archive.getResources();
         auto& textures = archive.getTextures();
 
         const auto id = editor->getUniqueID();
-        if (!m_selectedResources.contains(id)) {
-            m_selectedResources[id] = -1;
-        }
+        initSelection(*editor);
 
         const auto contentRegion = ImGui::GetContentRegionAvail();
         if (ImGui::BeginListBox("##Resources", contentRegion)) {
@@ -192,6 +251,16 @@ void Editor::renderResourcePicker() {
 
                 if (ImGui::IsItemHovered()) {
                     bgColor = style.Colors[ImGuiCol_ButtonHovered];
+
+                    const auto cost = SPLCostEstimator::estimate(resource, textures);
+                    ImGui::SetTooltip("Peak %.0f particles (%.0f children)\nSteady %.1f particles\nTextures %u (%u + %u bytes VRAM)",
+                        cost.getPeakTotal(),
+                        cost.peakChildren,
+                        cost.getSteadyTotal(),
+                        cost.textureCount,
+                        cost.textureBytes,
+                        cost.paletteBytes
+                    );
                 }
 
                 // Draw a filled rectangle behind the item
@@ -203,7 +272,18 @@ void Editor::renderResourcePicker() {
                 );
 
                 ImGui::SetCursorScreenPos(cursor);
-                ImGui::Image((ImTextureID)(uintptr_t)texture.glTexture->getHandle(), { 32, 32 });
+                if (texture.glTexture && texture.glTexture->isReady()) {
+                    ImGui::Image((ImTextureID)(uintptr_t)texture.glTexture->getHandle(), { 32, 32 });
+                } else {
+                    // Still uploading, show a placeholder of the same size
+                    ImGui::GetWindowDrawList()->AddRectFilled(
+                        cursor,
+                        { cursor.x + 32, cursor.y + 32 },
+                        ImGui::GetColorU32(ImGuiCol_FrameBg),
+                        2.5f
+                    );
+                    ImGui::Dummy({ 32, 32 });
+                }
 
                 ImGui::SameLine();
 
@@ -221,6 +301,200 @@ void Editor::renderResourcePicker() {
     ImGui::End();
 }
 
+void Editor::renderBudgetPanel() {
+    if (ImGui::Begin("DS Budget##Editor", &m_budget_open)) {
+        const auto& editor = g_projectManager->getActiveEditor();
+        if (!editor) {
+            ImGui::Text("No editor open");
+            ImGui::End();
+            return;
+        }
+
+        auto& tracker = editor->getBudgetTracker();
+        auto& budgets = tracker.getBudgets();
+        const auto& frame = tracker.getCurrent();
+
+        const auto budgetBar = [](const char* label, u32 value, u32 limit, bool overflow) {
+            const auto text = fmt::format("{} / {}", value, limit);
+            if (overflow) {
+                ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.25f, 0.25f, 1.0f));
+            }
+
+            ImGui::ProgressBar(limit > 0 ? std::min((f32)value / limit, 1.0f) : 0.0f, { -160, 0 }, text.c_str());
+            if (overflow) {
+                ImGui::PopStyleColor();
+            }
+
+            ImGui::SameLine();
+            ImGui::TextUnformatted(label);
+        };
+
+        budgetBar("Polygons", frame.polygons, DSLimits::MAX_POLYGONS, frame.overflow.polygons);
+        budgetBar("Vertices", frame.vertices, DSLimits::MAX_VERTICES, frame.overflow.vertices);
+        budgetBar("Texture VRAM", frame.textureBytes, budgets.textureVRAM, frame.overflow.textureVRAM);
+        budgetBar("Palette VRAM", frame.paletteBytes, budgets.paletteVRAM, frame.overflow.paletteVRAM);
+        budgetBar("Scanline Fill", frame.maxScanlineFill, budgets.scanlineFill, frame.overflow.scanlineFill);
+
+        if (frame.overflowingScanlines > 0) {
+            ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "%u scanlines over the fill estimate", frame.overflowingScanlines);
+        }
+
+        ImGui::Text("%u of %u frames overflowed", tracker.getOverflowFrames(), tracker.getFrameCount());
+        ImGui::SameLine();
+        if (ImGui::Button("Reset")) {
+            tracker.reset();
+        }
+
+        const auto history = tracker.getHistory();
+        std::vector<f32> polygons(history.size());
+        std::vector<f32> fill(history.size());
+        for (size_t i = 0; i < history.size(); i++) {
+            polygons[i] = (f32)history[i].vertices / 4;
+            fill[i] = (f32)history[i].maxScanlineFill;
+        }
+
+        // The vertex limit is reached first for quads (6144 / 4 = 1536), so plot against that
+        ImGui::PlotLines("##Polygons", polygons.data(), (int)polygons.size(), 0, "Polygons",
+            0.0f, (f32)DSLimits::MAX_VERTICES / 4, { -1, 80 });
+        ImGui::PlotLines("##Fill", fill.data(), (int)fill.size(), 0, "Scanline Fill",
+            0.0f, (f32)budgets.scanlineFill, { -1, 80 });
+
+        if (ImGui::TreeNode("Budgets")) {
+            ImGui::InputScalar("Texture VRAM (bytes)", ImGuiDataType_U32, &budgets.textureVRAM);
+            ImGui::InputScalar("Palette VRAM (bytes)", ImGuiDataType_U32, &budgets.paletteVRAM);
+            ImGui::InputScalar("Scanline Fill (pixels)", ImGuiDataType_U32, &budgets.scanlineFill);
+            ImGui::TreePop();
+        }
+    }
+
+    ImGui::End();
+}
+
+void Editor::renderMemoryPanel() {
+    if (!ImGui::Begin("Memory##Editor", &m_memory_open)) {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::BeginTable("##MemoryTotals", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchSame)) {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Current");
+        ImGui::TableSetupColumn("Peak");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableHeadersRow();
+
+        u64 cpuTotal = 0;
+        u64 gpuTotal = 0;
+        for (size_t i = 0; i < memory::CATEGORY_COUNT; i++) {
+            const auto category = (memory::Category)i;
+            const u64 current = memory::getCurrent(category);
+            (memory::isGPU(category) ? gpuTotal : cpuTotal) += current;
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s%s", memory::getName(category), memory::isGPU(category) ? " (GPU)" : "");
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(memory::formatSize(current).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(memory::formatSize(memory::getPeak(category)).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)memory::getAllocationCount(category));
+        }
+
+        ImGui::EndTable();
+        ImGui::Text("CPU %s | GPU %s", memory::formatSize(cpuTotal).c_str(), memory::formatSize(gpuTotal).c_str());
+    }
+
+    ImGui::Text("Open tabs: GPU %s of %s budget, %zu evicted",
+        memory::formatSize(m_residency.getResidentMemory()).c_str(),
+        memory::formatSize(m_residency.getBudget()).c_str(),
+        m_residency.getEvictedCount()
+    );
+
+    ImGui::SeparatorText("Per tab");
+    ImGui::TextDisabled("Textures shared between tabs are counted for each of them");
+
+    constexpr auto tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollX | ImGuiTableFlags_SizingFixedFit;
+    if (ImGui::BeginTable("##MemoryTabs", (int)memory::CATEGORY_COUNT + 2, tableFlags)) {
+        ImGui::TableSetupColumn("Tab");
+        for (size_t i = 0; i < memory::CATEGORY_COUNT; i++) {
+            ImGui::TableSetupColumn(memory::getName((memory::Category)i));
+        }
+
+        ImGui::TableSetupColumn("Total");
+        ImGui::TableHeadersRow();
+
+        for (const auto& editor : g_projectManager->getOpenEditors()) {
+            if (!editor->isLoaded()) {
+                continue;
+            }
+
+            const auto usage = editor->getMemoryUsage();
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s%s", editor->getPath().filename().string().c_str(), editor->isResident() ? "" : " (evicted)");
+
+            for (const u64 bytes : usage.bytes) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(memory::formatSize(bytes).c_str());
+            }
+
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(memory::formatSize(usage.getTotal()).c_str());
+        }
+
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+void Editor::renderComparison(const CostComparison& comparison) {
+    if (!ImGui::BeginTable("##Comparison", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchSame)) {
+        return;
+    }
+
+    ImGui::TableSetupColumn("Metric");
+    ImGui::TableSetupColumn("Saved");
+    ImGui::TableSetupColumn("Current");
+    ImGui::TableSetupColumn("Change");
+    ImGui::TableHeadersRow();
+
+    const auto row = [](const char* name, f64 saved, f64 current, const char* format) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(name);
+        ImGui::TableNextColumn();
+        ImGui::Text(format, saved);
+        ImGui::TableNextColumn();
+        ImGui::Text(format, current);
+        ImGui::TableNextColumn();
+
+        // Lower is cheaper, so increases are shown in red
+        const f64 change = saved > 0 ? (current - saved) / saved * 100.0 : 0.0;
+        const ImVec4 color = change > 0.5 ? ImVec4(1.0f, 0.4f, 0.4f, 1.0f)
+            : change < -0.5 ? ImVec4(0.4f, 1.0f, 0.4f, 1.0f)
+            : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+        ImGui::TextColored(color, "%+.1f%%", change);
+    };
+
+    const auto& [a, b] = comparison;
+    row("Peak particles", a.peakParticles, b.peakParticles, "%.0f");
+    row("Avg particles", a.averageParticles, b.averageParticles, "%.1f");
+    row("Update ns/frame", a.updateNsPerFrame, b.updateNsPerFrame, "%.0f");
+    row("Instance bytes", (f64)a.peakInstanceBytes, (f64)b.peakInstanceBytes, "%.0f");
+    row("Peak overdraw", a.peakOverdraw, b.peakOverdraw, "%.2f");
+    row("Avg overdraw", a.averageOverdraw, b.averageOverdraw, "%.2f");
+    row("Overflow frames", a.overflowFrames, b.overflowFrames, "%.0f");
+
+    ImGui::EndTable();
+
+    if (a.saturated || b.saturated) {
+        ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "Particle pool exhausted, counts are a lower bound");
+    }
+}
+
 void Editor::renderResourceEditor() {
     if (ImGui::Begin("Resource Editor##Editor", &m_editor_open)) {
         ImGui::SliderFloat("Global Time Scale", &m_timeScale, 0.0f, 2.0f, "%.2f");
@@ -232,6 +506,12 @@ void Editor::renderResourceEditor() {
             return;
         }
 
+        if (!editor->isLoaded()) {
+            ImGui::Text("Loading...");
+            ImGui::End();
+            return;
+        }
+
         m_activeEditor = editor;
 
         auto& archive = editor->getArchive();
@@ -239,9 +519,7 @@ void Editor::renderResourceEditor() {
         auto& textures = archive.getTextures();
 
         const auto id = editor->getUniqueID();
-        if (!m_selectedResources.contains(id)) {
-            m_selectedResources[id] = -1;
-        }
+        initSelection(*editor);
 
         if (m_selectedResources[id] != -1) {
             auto& resource = resources[m_selectedResources[id]];
@@ -265,6 +543,69 @@ void Editor::renderResourceEditor() {
                 killEmitters();
             }
 
+            auto& particleSystem = editor->getParticleSystem();
+            int backend = (int)particleSystem.getBackend();
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(150);
+            if (ImGui::Combo("Backend", &backend, s_simulationBackends.data(), s_simulationBackends.size())) {
+                killEmitters();
+                particleSystem.setBackend((SimulationBackend)backend);
+            }
+
+            ImGui::SameLine();
+            if (ImGui::Button("Validate GPU")) {
+                m_validationReport = GPUParticleSimulator::validate(
+                    resource,
+                    textures,
+                    120,
+                    1.0f / SPLArchive::SPL_FRAMES_PER_SECOND
+                );
+            }
+
+            ImGui::SameLine();
+            if (ImGui::Button("Compare with Saved")) {
+                // A = the resource as it is on disk, B = the current edits.
+                // The comparison only needs the texture params, not GL textures.
+                const SPLArchive saved(editor->getPath(), false);
+                const size_t index = m_selectedResources[id];
+                if (index < saved.getResourceCount()) {
+                    m_comparison = CostComparator::compare(
+                        saved.getResource(index), saved.getTextures(),
+                        resource, textures,
+                        { .deltaTime = 1.0f / SPLArchive::SPL_FRAMES_PER_SECOND }
+                    );
+                } else {
+                    spdlog::warn("Resource {} does not exist in the saved file", index);
+                }
+            }
+
+            if (m_comparison) {
+                renderComparison(m_comparison.value());
+            }
+
+            if (m_validationReport) {
+                const auto& report = m_validationReport.value();
+                ImGui::TextColored(
+                    report.passed ? ImVec4(0.4f, 1.0f, 0.4f, 1.0f) : ImVec4(1.0f, 0.4f, 0.4f, 1.0f),
+                    "%s: %u particles, %u frames, %u alive mismatches%s",
+                    report.passed ? "Passed" : "Failed",
+                    report.particles,
+                    report.frames,
+                    report.aliveMismatches,
+                    report.deterministic ? "" : " (counts only)"
+                );
+                ImGui::Text("Max error: pos %.2e, vel %.2e, color %.2e, alpha %.2e, scale %.2e",
+                    report.maxPositionError,
+                    report.maxVelocityError,
+                    report.maxColorError,
+                    report.maxAlphaError,
+                    report.maxScaleError
+                );
+            }
+
+            // Only the edited resources are encoded again when saving
+            const u64 changeCount = editor->getChangeCount();
+
             if (ImGui::BeginTabBar("##editorTabs")) {
                 if (ImGui::BeginTabItem("General")) {
                     ImGui::BeginChild("##headerEditor", {}, ImGuiChildFlags_Border);
@@ -289,6 +630,10 @@ void Editor::renderResourceEditor() {
 
                 ImGui::EndTabBar();
             }
+
+            if (editor->getChangeCount() != changeCount) {
+                archive.markResourceDirty(m_selectedResources[id]);
+            }
         }
     }
 
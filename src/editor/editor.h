@@ -1,9 +1,13 @@
 #pragma once
 #include "spl/spl_resource.h"
+#include "archive_reloader.h"
+#include "cost_comparison.h"
 #include "editor_instance.h"
+#include "residency_manager.h"
 #include "types.h"
 
 #include <chrono>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -19,6 +23,8 @@ public:
     void renderParticles();
     void openPicker();
     void openEditor();
+    void openBudget();
+    void openMemory();
     void updateParticles(float deltaTime);
 
     void playEmitterAction(EmitterSpawnType spawnType);
@@ -29,6 +35,9 @@ public:
 private:
     void renderResourcePicker();
     void renderResourceEditor();
+    void renderBudgetPanel();
+    void renderMemoryPanel();
+    void renderComparison(const CostComparison& comparison);
 
     void renderHeaderEditor(SPLResourceHeader& header) const;
     void renderBehaviorEditor(SPLResource& res);
@@ -44,10 +53,15 @@ private:
 
     void renderChildrenEditor(SPLResource& res);
 
+    // Selects the resource the editor was opened for, the first time it is shown after loading
+    void initSelection(const EditorInstance& editor);
+
 
 private:
     bool m_picker_open = true;
     bool m_editor_open = true;
+    bool m_budget_open = false;
+    bool m_memory_open = false;
     float m_timeScale = 1.0f;
 
     EmitterSpawnType m_emitterSpawnType = EmitterSpawnType::SingleShot;
@@ -55,6 +69,8 @@ private:
 
     std::unordered_map<u64, int> m_selectedResources;
     std::weak_ptr<EditorInstance> m_activeEditor;
+    ResidencyManager m_residency;
+    ArchiveReloader m_reloader;
 
     struct EmitterSpawnTask {
         u64 resourceIndex;
@@ -64,4 +80,6 @@ private:
     };
 
     std::vector<EmitterSpawnTask> m_emitterTasks;
+    std::optional<GPUValidationReport> m_validationReport;
+    std::optional<CostComparison> m_comparison;
 };
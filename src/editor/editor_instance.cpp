@@ -8,35 +8,162 @@
 #include <random>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <array>
+#include <chrono>
+#include <spdlog/spdlog.h>
+
+
+namespace {
+
+constexpr std::array s_renderModes = {
+    "Unsorted",
+    "Depth Sorted",
+    "Weighted OIT",
+    "Overdraw"
+};
+
+}
 
 
 EditorInstance::EditorInstance(const std::filesystem::path& path)
-    : m_path(path), m_archive(path), m_particleSystem(1000, m_archive.getTextures())
-    , m_camera(glm::radians(45.0f), { 800, 800 }, 1.0f, 500.0f) {
+    : EditorInstance(path, std::make_shared<ArchiveLoad>()) {
+    // Parsing runs on the job, the GL side is created in finishLoading once it is done.
+    // The job only touches the load, which may outlive this instance if another one shares it.
+    m_load->job = std::jthread([load = m_load.get(), path](std::stop_token stop) {
+        auto archive = std::make_shared<SPLArchive>();
+        const bool parsed = archive->parse(path, stop, [load](f32 progress) {
+            load->progress = progress;
+        });
+
+        if (parsed) {
+            load->archive = std::move(archive);
+        } else if (!stop.stop_requested()) {
+            spdlog::error("Failed to open {}", path.string());
+        }
+
+        load->done = true;
+    });
+}
+
+EditorInstance::EditorInstance(const std::filesystem::path& path, std::shared_ptr<ArchiveLoad> load)
+    : m_path(path), m_camera(glm::radians(45.0f), { 800, 800 }, 1.0f, 500.0f), m_load(std::move(load)) {
+    m_uniqueID = random::nextU64();
+
+    m_updateProj = true;
+}
+
+EditorInstance::EditorInstance(const std::filesystem::path& path, std::shared_ptr<SPLArchive> archive)
+    : m_path(path), m_camera(glm::radians(45.0f), { 800, 800 }, 1.0f, 500.0f) {
     m_uniqueID = random::nextU64();
 
     m_updateProj = true;
+
+    // Nothing to parse, finishLoading only has to set up this instance's particle system
+    m_parsedArchive = std::move(archive);
+    m_loadState = LoadState::Parsed;
+}
+
+EditorInstance::~EditorInstance() {
+    // The archive may be shared with other editors that still need the textures
+    if (isLoaded() && m_resident) {
+        m_archive->releaseTextures();
+    }
+}
+
+void EditorInstance::finishLoading() {
+    if (m_loadState == LoadState::Parsing && m_load->done) {
+        m_parsedArchive = m_load->archive;
+        m_loadState = m_parsedArchive ? LoadState::Parsed : LoadState::Failed;
+        m_load.reset();
+    }
+
+    if (m_loadState != LoadState::Parsed) {
+        return;
+    }
+
+    m_archive = std::move(m_parsedArchive);
+
+    // Textures fill in as g_textureUploader gets to them
+    const auto start = std::chrono::steady_clock::now();
+    m_archive->createTextures();
+
+    m_particleSystem = std::make_unique<ParticleSystem>(1000, m_archive->getTextures());
+    m_particleSystem->getRenderer()->setBudgetTracker(m_budgetTracking ? &m_budgetTracker : nullptr);
+
+    spdlog::info("Opened {} ({} resources, {} textures), {:.2f} ms on the main thread",
+        m_path.filename().string(),
+        m_archive->getResourceCount(),
+        m_archive->getTextureCount(),
+        std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count()
+    );
+
+    m_loadState = LoadState::Loaded;
+}
+
+void EditorInstance::renderLoading(bool& open) {
+    const ImVec2 size = ImGui::GetContentRegionAvail();
+    ImGui::SetCursorPos({ ImGui::GetCursorPosX() + size.x * 0.25f, ImGui::GetCursorPosY() + size.y * 0.5f - 30.0f });
+
+    if (m_loadState == LoadState::Failed) {
+        ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "Failed to open %s", m_path.filename().string().c_str());
+        return;
+    }
+
+    ImGui::BeginGroup();
+    ImGui::Text("Opening %s...", m_path.filename().string().c_str());
+    ImGui::ProgressBar(m_load ? m_load->progress.load() : 1.0f, { size.x * 0.5f, 0 });
+
+    // Closing the tab drops its share of the load, the job is stopped and joined with the last one
+    if (ImGui::Button("Cancel")) {
+        open = false;
+    }
+
+    ImGui::EndGroup();
 }
 
 std::pair<bool, bool> EditorInstance::render() {
     bool open = true;
     bool active = false;
 
+    finishLoading();
     m_camera.setViewportHovered(false);
 
     const auto name = m_modified ? m_path.filename().string() + "*" : m_path.filename().string();
-    if (ImGui::BeginTabItem(name.c_str(), &open)) {
+    const bool selected = ImGui::BeginTabItem(name.c_str(), &open);
+    if (isLoaded() && ImGui::IsItemHovered()) {
+        const auto usage = getMemoryUsage();
+        ImGui::SetTooltip("GPU %.1f MB, CPU %.1f MB%s",
+            usage.getGPUTotal() / (1024.0 * 1024.0),
+            (usage.getTotal() - usage.getGPUTotal()) / (1024.0 * 1024.0),
+            m_resident ? "" : "\nEvicted while hidden, restored when shown"
+        );
+    }
+
+    if (selected) {
         active = true;
+
+        if (!isLoaded()) {
+            m_camera.setActive(false);
+            renderLoading(open);
+            ImGui::EndTabItem();
+            return { open, active };
+        }
+
         m_camera.setActive(true);
+        makeResident();
 
         const ImVec2 size = ImGui::GetContentRegionAvail();
         m_size = { size.x, size.y };
 
-        ImGui::Image((ImTextureID)(uintptr_t)m_viewport.getTexture(), size);
+        const ImVec2 viewportPos = ImGui::GetCursorScreenPos();
+        const glm::vec2 uvScale = m_viewport.getUVScale();
+        ImGui::Image((ImTextureID)(uintptr_t)m_viewport.getTexture(), size, { 0.0f, 0.0f }, { uvScale.x, uvScale.y });
         if (ImGui::IsItemHovered()) {
             m_camera.setViewportHovered(true);
         }
 
+        renderOverlay(viewportPos);
+
         ImGui::EndTabItem();
     } else {
         m_camera.setActive(false);
@@ -45,29 +172,227 @@ std::pair<bool, bool> EditorInstance::render() {
     return { open, active };
 }
 
+void EditorInstance::renderOverlay(const ImVec2& viewportPos) {
+    ImGui::SetCursorScreenPos({ viewportPos.x + 8, viewportPos.y + 8 });
+
+    auto renderer = m_particleSystem->getRenderer();
+    int mode = (int)renderer->getRenderMode();
+
+    ImGui::SetNextItemWidth(140);
+    if (ImGui::Combo("##RenderMode", &mode, s_renderModes.data(), s_renderModes.size())) {
+        renderer->setRenderMode((ParticleRenderMode)mode);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark")) {
+        m_benchmarkRequested = true;
+    }
+
+    ImGui::SetCursorScreenPos({ viewportPos.x + 8, ImGui::GetCursorScreenPos().y });
+    ImGui::Text("CPU %.3f ms | GPU %.3f ms", m_frameTiming.cpuTime, m_frameTiming.gpuTime);
+
+    if (m_budgetTracking && m_budgetTracker.getCurrent().overflows()) {
+        ImGui::SetCursorScreenPos({ viewportPos.x + 8, ImGui::GetCursorScreenPos().y });
+        ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "DS hardware budget exceeded");
+    }
+
+    if (renderer->getRenderMode() == ParticleRenderMode::Overdraw) {
+        ImGui::SetCursorScreenPos({ viewportPos.x + 8, ImGui::GetCursorScreenPos().y });
+        ImGui::Text("Overdraw max %.0f | avg %.2f | %llu fragments over %llu pixels",
+            m_overdrawStats.maxOverdraw,
+            m_overdrawStats.averageOverdraw,
+            (unsigned long long)m_overdrawStats.fragments,
+            (unsigned long long)m_overdrawStats.coveredPixels
+        );
+        ImGui::SetCursorScreenPos({ viewportPos.x + 8, ImGui::GetCursorScreenPos().y });
+        ImGui::TextDisabled("Blue = 1, Green ~ 2, Yellow ~ 6, Red ~ 13, White = 32+ layers");
+    }
+
+    if (m_hasBenchmarkResults) {
+        for (size_t i = 0; i < m_benchmarkResults.size(); i++) {
+            ImGui::SetCursorScreenPos({ viewportPos.x + 8, ImGui::GetCursorScreenPos().y });
+            ImGui::Text("%-13s CPU %.3f ms | GPU %.3f ms", s_renderModes[i], m_benchmarkResults[i].cpuTime, m_benchmarkResults[i].gpuTime);
+        }
+    }
+}
+
 void EditorInstance::renderParticles() {
+    if (!isLoaded()) {
+        return;
+    }
+
+    // Can become active without its tab being shown first, e.g. from the project manager
+    makeResident();
+
     if (m_updateProj || m_size != m_viewport.getSize()) {
         m_viewport.resize(m_size);
         m_camera.setViewport(m_size.x, m_size.y);
     }
 
+    if (m_timerQueries[0] == 0) {
+        glCall(glGenQueries((s32)m_timerQueries.size(), m_timerQueries.data()));
+    }
+
+    if (m_benchmarkRequested) {
+        m_benchmarkRequested = false;
+        runBenchmark();
+    }
+
+    // Read the query from the previous frame if it is ready, then time this one
+    const u32 current = m_timerQueries[m_timerFrame & 1];
+    const u32 previous = m_timerQueries[(m_timerFrame + 1) & 1];
+    if (m_timerFrame > 0) {
+        s32 available = 0;
+        glCall(glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available));
+        if (available) {
+            u64 elapsed;
+            glCall(glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &elapsed));
+            m_frameTiming.gpuTime = (f32)elapsed / 1e6f;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    glCall(glBeginQuery(GL_TIME_ELAPSED, current));
+
+    drawParticles();
+
+    glCall(glEndQuery(GL_TIME_ELAPSED));
+    m_frameTiming.cpuTime = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count();
+    ++m_timerFrame;
+
+    m_viewport.unbind();
+}
+
+void EditorInstance::drawParticles() {
     m_viewport.bind();
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_particleSystem.render(
+    const auto mode = m_particleSystem->getRenderer()->getRenderMode();
+    if (mode == ParticleRenderMode::WeightedOIT) {
+        m_viewport.beginTransparency();
+    } else if (mode == ParticleRenderMode::Overdraw) {
+        m_viewport.beginOverdraw();
+    }
+
+    m_particleSystem->render(
         m_camera.getView(),
         m_camera.getProj() ,
         m_camera.getPosition()
     );
 
-    m_viewport.unbind();
+    if (mode == ParticleRenderMode::WeightedOIT) {
+        m_viewport.resolveTransparency();
+    } else if (mode == ParticleRenderMode::Overdraw) {
+        m_overdrawStats = m_viewport.resolveOverdraw();
+    }
+}
+
+void EditorInstance::runBenchmark() {
+    // Renders the current (frozen) simulation state repeatedly in every mode so
+    // they can be compared on exactly the same scene
+    auto renderer = m_particleSystem->getRenderer();
+    const auto originalMode = renderer->getRenderMode();
+
+    // The repeated renders aren't real frames and would skew the budget history
+    renderer->setBudgetTracker(nullptr);
+
+    u32 query;
+    glCall(glGenQueries(1, &query));
+
+    for (size_t mode = 0; mode < RENDER_MODE_COUNT; mode++) {
+        renderer->setRenderMode((ParticleRenderMode)mode);
+
+        // Warm up once so lazily created resources are not measured
+        drawParticles();
+        glFinish();
+
+        const auto start = std::chrono::steady_clock::now();
+        glCall(glBeginQuery(GL_TIME_ELAPSED, query));
+
+        for (u32 i = 0; i < BENCHMARK_ITERATIONS; i++) {
+            drawParticles();
+        }
+
+        glCall(glEndQuery(GL_TIME_ELAPSED));
+        glFinish();
+
+        u64 elapsed;
+        glCall(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed));
+
+        const f32 cpuTime = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_benchmarkResults[mode].cpuTime = cpuTime / BENCHMARK_ITERATIONS;
+        m_benchmarkResults[mode].gpuTime = (f32)elapsed / 1e6f / BENCHMARK_ITERATIONS;
+    }
+
+    glCall(glDeleteQueries(1, &query));
+
+    renderer->setRenderMode(originalMode);
+    renderer->setBudgetTracker(m_budgetTracking ? &m_budgetTracker : nullptr);
+    m_hasBenchmarkResults = true;
 }
 
 void EditorInstance::updateParticles(float deltaTime) {
+    if (!isLoaded()) {
+        return;
+    }
+
     m_camera.update();
-    m_particleSystem.update(deltaTime);
+    m_particleSystem->update(deltaTime);
+}
+
+void EditorInstance::evict() {
+    if (!isLoaded() || !m_resident) {
+        return;
+    }
+
+    const u64 size = getMemoryUsage().getGPUTotal();
+    m_viewport.release();
+    m_archive->releaseTextures();
+    m_particleSystem->releaseGPUResources();
+    m_resident = false;
+
+    spdlog::info("Evicted {} from the GPU, {:.1f} MB", m_path.filename().string(), size / (1024.0 * 1024.0));
+}
+
+void EditorInstance::makeResident() {
+    if (!isLoaded() || m_resident) {
+        return;
+    }
+
+    // The viewport is created by the next renderParticles, the GPU simulator by the next update
+    const auto start = std::chrono::steady_clock::now();
+    m_archive->createTextures();
+    m_resident = true;
+
+    spdlog::info("Restored {} in {:.2f} ms",
+        m_path.filename().string(),
+        std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count()
+    );
+}
+
+void EditorInstance::onArchiveReloaded(const SPLArchive& previous) {
+    // Not loaded yet means the particle system will be created from the new contents anyway
+    if (!isLoaded()) {
+        return;
+    }
+
+    m_particleSystem->reattachEmitters(previous.getResources(), m_archive->getResources(), m_archive->getTextureCount());
+    m_particleSystem->getRenderer()->setTextures(m_archive->getTextures());
+}
+
+memory::Usage EditorInstance::getMemoryUsage() const {
+    memory::Usage usage;
+    if (!isLoaded()) {
+        return usage;
+    }
+
+    m_archive->getMemoryUsage(usage);
+    m_particleSystem->getMemoryUsage(usage);
+    usage[memory::Category::Framebuffers] += m_viewport.getMemoryUsage();
+
+    return usage;
 }
 
 void EditorInstance::handleEvent(const SDL_Event& event) {
@@ -80,11 +405,40 @@ void EditorInstance::handleEvent(const SDL_Event& event) {
     }
 }
 
+void EditorInstance::setBudgetTracking(bool enabled) {
+    if (m_budgetTracking == enabled) {
+        return;
+    }
+
+    m_budgetTracking = enabled;
+    if (isLoaded()) {
+        m_particleSystem->getRenderer()->setBudgetTracker(enabled ? &m_budgetTracker : nullptr);
+    }
+}
+
 bool EditorInstance::notifyClosing() {
     return true;
 }
 
 bool EditorInstance::valueChanged(bool changed) {
     m_modified |= changed;
+    m_changeCount += changed ? 1 : 0;
     return changed;
 }
+
+bool EditorInstance::save() {
+    if (!isLoaded()) {
+        return false;
+    }
+
+    if (!m_archive->save(m_path)) {
+        return false;
+    }
+
+    markSaved();
+    return true;
+}
+
+void EditorInstance::markSaved() {
+    m_modified = false;
+}
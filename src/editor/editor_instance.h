@@ -1,11 +1,18 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <filesystem>
+#include <memory>
+#include <thread>
 #include <utility> // std::pair
 #include <SDL2/SDL_events.h>
+#include <imgui.h>
 
 #include "camera.h"
+#include "ds_budget.h"
 #include "gl_viewport.h"
+#include "memory_tracker.h"
 #include "particle_renderer.h"
 #include "particle_system.h"
 #include "spl/spl_archive.h"
@@ -13,8 +20,27 @@
 
 class EditorInstance {
 public:
+    // A parse running in the background, shared by every instance that opens the file before it is done.
+    // The job is stopped once the last of them is closed.
+    struct ArchiveLoad {
+        std::atomic<bool> done = false;
+        std::atomic<f32> progress = 0.0f;
+        std::shared_ptr<SPLArchive> archive; // Set by the job before done, stays null if parsing failed
+
+        // Declared last so it is joined before anything it writes to is destroyed
+        std::jthread job;
+    };
+
+    // The archive is opened in the background, the instance is usable once isLoaded() returns true
     explicit EditorInstance(const std::filesystem::path& path);
 
+    // Waits for a parse another instance started instead of parsing the file again
+    EditorInstance(const std::filesystem::path& path, std::shared_ptr<ArchiveLoad> load);
+
+    // Edits an archive another instance already loaded, changes show up in both
+    EditorInstance(const std::filesystem::path& path, std::shared_ptr<SPLArchive> archive);
+    ~EditorInstance();
+
     std::pair<bool, bool> render();
     void renderParticles();
     void updateParticles(float deltaTime);
@@ -26,28 +52,125 @@ public:
         return m_modified;
     }
 
+    // Incremented by every change, compare before and after to find out whether something was edited
+    u64 getChangeCount() const {
+        return m_changeCount;
+    }
+
+    // Writes the archive back to getPath(), only the resources and textures that changed are re-encoded
+    bool save();
+    void markSaved();
+
+    bool isLoaded() const {
+        return m_loadState == LoadState::Loaded;
+    }
+
+    const std::filesystem::path& getPath() const {
+        return m_path;
+    }
+
     SPLArchive& getArchive() {
+        return *m_archive;
+    }
+
+    const std::shared_ptr<SPLArchive>& getSharedArchive() const {
         return m_archive;
     }
 
+    // Resource to select once the archive is loaded, e.g. the one a search hit pointed at. -1 for none
+    void setInitialSelection(int resource) {
+        m_initialSelection = resource;
+    }
+
+    int getInitialSelection() const {
+        return m_initialSelection;
+    }
+
+    // Null unless the archive is still being parsed
+    const std::shared_ptr<ArchiveLoad>& getPendingLoad() const {
+        return m_load;
+    }
+
     u64 getUniqueID() const {
         return m_uniqueID;
     }
 
     ParticleSystem& getParticleSystem() {
-        return m_particleSystem;
+        return *m_particleSystem;
     }
 
+    DSBudgetTracker& getBudgetTracker() {
+        return m_budgetTracker;
+    }
+
+    // Tracking reads the GPU draw counts back or rasterizes every CPU particle, so it only runs while it is shown
+    void setBudgetTracking(bool enabled);
+
+    // Releases the render targets, the archive's textures and the GPU simulation of a hidden tab.
+    // makeResident brings them back, textures through g_texturePool and g_textureCache.
+    void evict();
+    void makeResident();
+    bool isResident() const {
+        return m_resident;
+    }
+
+    // Called after the archive took over new contents, previous holds the old ones (see SPLArchive::replaceContents)
+    void onArchiveReloaded(const SPLArchive& previous);
+
+    // Everything this tab holds on to, textures shared with other tabs are counted for each
+    memory::Usage getMemoryUsage() const;
+
+private:
+    enum class LoadState {
+        Parsing,
+        Parsed, // Waiting for the main thread to create the GL side
+        Loaded,
+        Failed
+    };
+
+    struct FrameTiming {
+        f32 cpuTime = 0; // ms
+        f32 gpuTime = 0; // ms
+    };
+
+    static constexpr size_t RENDER_MODE_COUNT = 4;
+    static constexpr u32 BENCHMARK_ITERATIONS = 100;
+
+    void finishLoading();
+    void renderLoading(bool& open);
+    void renderOverlay(const ImVec2& viewportPos);
+    void drawParticles();
+    void runBenchmark();
+
 private:
     std::filesystem::path m_path;
-    SPLArchive m_archive;
+    std::shared_ptr<SPLArchive> m_archive;
     GLViewport m_viewport = GLViewport({ 800, 600 });
-    ParticleSystem m_particleSystem;
+    std::unique_ptr<ParticleSystem> m_particleSystem;
+    DSBudgetTracker m_budgetTracker;
     Camera m_camera;
 
     glm::vec2 m_size = { 800, 600 };
     bool m_updateProj;
 
+    // Timer queries are double buffered so reading the result never stalls
+    std::array<u32, 2> m_timerQueries = {};
+    u32 m_timerFrame = 0;
+    FrameTiming m_frameTiming;
+    OverdrawStats m_overdrawStats = {};
+
+    bool m_benchmarkRequested = false;
+    bool m_hasBenchmarkResults = false;
+    std::array<FrameTiming, RENDER_MODE_COUNT> m_benchmarkResults;
+
+    bool m_resident = true;
+    bool m_budgetTracking = false;
     bool m_modified = false; // Has the file been modified?
+    u64 m_changeCount = 0;
     u64 m_uniqueID;
+    int m_initialSelection = -1;
+
+    std::atomic<LoadState> m_loadState = LoadState::Parsing;
+    std::shared_ptr<ArchiveLoad> m_load;
+    std::shared_ptr<SPLArchive> m_parsedArchive; // Taken from m_load, or the archive of another instance
 };
@@ -0,0 +1,1519 @@
+#include "gpu_particle_simulator.h"
+#include "particle_renderer.h"
+#include "particle_system.h"
+#include "gl_program_cache.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <gl/glew.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <numeric>
+#include <spdlog/spdlog.h>
+#include <unordered_set>
+
+#include "random.h"
+
+
+namespace {
+
+constexpr u32 s_workGroupSize = 64;
+constexpr u32 s_maxBehaviors = 8;
+
+// Emitter flags, must match the FLAG_* constants in the shaders
+constexpr u32 s_flagScaleAnim = 1 << 0;
+constexpr u32 s_flagScaleLoop = 1 << 1;
+constexpr u32 s_flagColorAnim = 1 << 2;
+constexpr u32 s_flagColorLoop = 1 << 3;
+constexpr u32 s_flagColorInterpolate = 1 << 4;
+constexpr u32 s_flagColorRandomStart = 1 << 5;
+constexpr u32 s_flagAlphaAnim = 1 << 6;
+constexpr u32 s_flagAlphaLoop = 1 << 7;
+constexpr u32 s_flagTexAnim = 1 << 8;
+constexpr u32 s_flagTexLoop = 1 << 9;
+constexpr u32 s_flagTexRandomInit = 1 << 10;
+constexpr u32 s_flagFollowEmitter = 1 << 11;
+constexpr u32 s_flagRandomInitAngle = 1 << 12;
+constexpr u32 s_flagHasRotation = 1 << 13;
+constexpr u32 s_flagRandomizeLoopedAnim = 1 << 14;
+constexpr u32 s_flagChildResource = 1 << 15;
+constexpr u32 s_flagHasTexAnim = 1 << 16;
+constexpr u32 s_flagPolygonRotXYZ = 1 << 17;
+constexpr u32 s_flagPolygonPlaneXZ = 1 << 18;
+constexpr u32 s_flagDpolFaceEmitter = 1 << 19;
+
+constexpr u32 s_childFlagUsesBehaviors = 1 << 0;
+constexpr u32 s_childFlagScaleAnim = 1 << 1;
+constexpr u32 s_childFlagAlphaAnim = 1 << 2;
+constexpr u32 s_childFlagFollowEmitter = 1 << 3;
+constexpr u32 s_childFlagUseChildColor = 1 << 4;
+
+constexpr u32 s_stateActive = 1 << 0;
+constexpr u32 s_stateVisible = 1 << 1;
+
+struct GPUBehavior {
+    glm::vec4 params;
+    u32 type;
+    u32 mode;
+    u32 apply;
+    u32 _;
+};
+
+// Mirrors the std430 layout of the Emitter struct in the compute shaders
+struct GPUEmitter {
+    glm::vec4 position;
+    glm::vec4 velocity;
+    glm::vec4 initVelocity;
+    glm::vec4 axis;
+    glm::vec4 crossAxis1;
+    glm::vec4 crossAxis2;
+    glm::vec4 basePos;
+    glm::vec4 color; // rgb = header color, a = base alpha
+    glm::vec4 emission; // radius, length, initVelPosAmplifier, initVelAxisAmplifier
+    glm::vec4 scale; // baseScale, aspectRatio, dbbScale, airResistance
+    glm::vec4 variance; // baseScale, lifeTime, initVel, particleLifeTime
+    glm::vec4 rotation; // initAngle, minRotation, maxRotation, loopTime
+    glm::vec4 texCoords; // xy = parent s/t, zw = child s/t
+    glm::vec4 scaleAnim; // start, mid, end
+    glm::vec4 curves; // scale in/out, alpha in/out
+    glm::vec4 colorAnimStart;
+    glm::vec4 colorAnimEnd;
+    glm::vec4 colorCurve; // in, peak, out, tex anim step
+    glm::vec4 alphaAnim; // start, mid, end, randomRange
+    glm::vec4 childColor; // rgb, a = randomInitVelMag
+    glm::vec4 childParams; // endScale, lifeTime, velocityRatio, scaleRatio
+    glm::vec4 childEmission; // emissionDelay, emissionInterval, polygonX, polygonY
+    u32 texAnimTextures[8];
+    u32 flags;
+    u32 childFlags;
+    u32 emissionType;
+    u32 drawType;
+    u32 scaleAnimDir;
+    u32 textureIndex;
+    u32 texAnimCount;
+    u32 childTexture;
+    u32 childEmissionCount;
+    u32 childRotationType;
+    u32 behaviorCount;
+    u32 state;
+    GPUBehavior behaviors[s_maxBehaviors];
+};
+
+struct GPUCounters {
+    s32 freeCount;
+    u32 childRequestCount;
+    u32 maxParticles;
+    u32 maxChildRequests;
+    u32 textureCounts[GPUParticleSimulator::MAX_TEXTURES];
+    u32 textureCursors[GPUParticleSimulator::MAX_TEXTURES];
+};
+
+struct GPUChildRequest {
+    GPUParticle parent;
+    u32 slot;
+    u32 count;
+    u32 _[2];
+};
+
+static_assert(sizeof(GPUParticle) == 96);
+static_assert(sizeof(GPUBehavior) == 32);
+static_assert(offsetof(GPUEmitter, behaviors) % 16 == 0);
+static_assert(sizeof(GPUEmitter) == 688);
+static_assert(sizeof(GPUChildRequest) == 112);
+static_assert(sizeof(ParticleInstance) == 112);
+static_assert(sizeof(DrawElementsIndirectCommand) == 20);
+
+constexpr auto s_commonShader = R"(
+#version 450 core
+
+#define FLAG_SCALE_ANIM (1u << 0)
+#define FLAG_SCALE_LOOP (1u << 1)
+#define FLAG_COLOR_ANIM (1u << 2)
+#define FLAG_COLOR_LOOP (1u << 3)
+#define FLAG_COLOR_INTERPOLATE (1u << 4)
+#define FLAG_COLOR_RANDOM_START (1u << 5)
+#define FLAG_ALPHA_ANIM (1u << 6)
+#define FLAG_ALPHA_LOOP (1u << 7)
+#define FLAG_TEX_ANIM (1u << 8)
+#define FLAG_TEX_LOOP (1u << 9)
+#define FLAG_TEX_RANDOM_INIT (1u << 10)
+#define FLAG_FOLLOW_EMITTER (1u << 11)
+#define FLAG_RANDOM_INIT_ANGLE (1u << 12)
+#define FLAG_HAS_ROTATION (1u << 13)
+#define FLAG_RANDOMIZE_LOOPED_ANIM (1u << 14)
+#define FLAG_CHILD_RESOURCE (1u << 15)
+#define FLAG_HAS_TEX_ANIM (1u << 16)
+#define FLAG_POLYGON_ROT_XYZ (1u << 17)
+#define FLAG_POLYGON_PLANE_XZ (1u << 18)
+#define FLAG_DPOL_FACE_EMITTER (1u << 19)
+
+#define CHILD_USES_BEHAVIORS (1u << 0)
+#define CHILD_SCALE_ANIM (1u << 1)
+#define CHILD_ALPHA_ANIM (1u << 2)
+#define CHILD_FOLLOW_EMITTER (1u << 3)
+#define CHILD_USE_CHILD_COLOR (1u << 4)
+
+#define STATE_ACTIVE (1u << 0)
+#define STATE_VISIBLE (1u << 1)
+
+#define INFO_ALIVE 1u
+#define INFO_CHILD 2u
+
+#define TWO_PI 6.28318530718
+
+struct Particle {
+    vec4 positionAge;
+    vec4 velocityLifeTime;
+    vec4 colorBaseAlpha;
+    vec4 emitterPosAnimAlpha;
+    float rotation;
+    float angularVelocity;
+    float baseScale;
+    float animScale;
+    float emissionTimer;
+    float lifeRateOffset;
+    uint texIndex;
+    uint info;
+};
+
+struct Behavior {
+    vec4 params;
+    uint type;
+    uint mode;
+    uint apply;
+    uint pad;
+};
+
+struct Emitter {
+    vec4 position;
+    vec4 velocity;
+    vec4 initVelocity;
+    vec4 axis;
+    vec4 crossAxis1;
+    vec4 crossAxis2;
+    vec4 basePos;
+    vec4 color;
+    vec4 emission;
+    vec4 scale;
+    vec4 variance;
+    vec4 rotation;
+    vec4 texCoords;
+    vec4 scaleAnim;
+    vec4 curves;
+    vec4 colorAnimStart;
+    vec4 colorAnimEnd;
+    vec4 colorCurve;
+    vec4 alphaAnim;
+    vec4 childColor;
+    vec4 childParams;
+    vec4 childEmission;
+    uint texAnimTextures[8];
+    uint flags;
+    uint childFlags;
+    uint emissionType;
+    uint drawType;
+    uint scaleAnimDir;
+    uint textureIndex;
+    uint texAnimCount;
+    uint childTexture;
+    uint childEmissionCount;
+    uint childRotationType;
+    uint behaviorCount;
+    uint state;
+    Behavior behaviors[8];
+};
+
+struct ChildRequest {
+    Particle parent;
+    uint slot;
+    uint count;
+    uint pad0;
+    uint pad1;
+};
+
+struct Instance {
+    vec4 color;
+    mat4 transform;
+    vec2 texCoords[4];
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) buffer Particles { Particle particles[]; };
+layout(std430, binding = 1) readonly buffer Emitters { Emitter emitters[]; };
+layout(std430, binding = 2) buffer FreeList { uint freeList[]; };
+layout(std430, binding = 3) buffer Counters {
+    int freeCount;
+    uint childRequestCount;
+    uint maxParticles;
+    uint maxChildRequests;
+    uint textureCounts[256];
+    uint textureCursors[256];
+};
+layout(std430, binding = 4) buffer ChildRequests { ChildRequest childRequests[]; };
+layout(std430, binding = 5) writeonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 6) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 7) readonly buffer EmissionRequests { uvec4 emissionRequests[]; };
+
+layout(location = 0) uniform float deltaTime;
+layout(location = 1) uniform uint frame;
+layout(location = 2) uniform uint childPass;
+layout(location = 3) uniform mat4 view;
+layout(location = 4) uniform uint textureCount;
+
+#define EMITTER emitters[slot]
+
+uint rngState;
+
+uint pcgHash(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+void seedRandom(uint a, uint b) {
+    rngState = pcgHash(a ^ pcgHash(b + 0x9E3779B9u));
+}
+
+uint nextU32() {
+    rngState = pcgHash(rngState);
+    return rngState;
+}
+
+float nextF32() {
+    return float(nextU32() >> 8) * (1.0 / 16777216.0);
+}
+
+float nextF32N() {
+    return nextF32() * 2.0 - 1.0;
+}
+
+float range(float mn, float mx) {
+    return mn + nextF32() * (mx - mn);
+}
+
+float aroundZero(float r) {
+    return range(-r, r);
+}
+
+// See random.h
+float scaledRange(float n, float variance) {
+    float mn = n * (1.0 - variance);
+    return mn + nextF32() * (n - mn);
+}
+
+float scaledRange2(float n, float variance) {
+    float mn = n * (1.0 - variance);
+    float mx = n * 2.0 * (1.0 - variance);
+    return mn + nextF32() * (mx - mn);
+}
+
+vec3 unitVector() {
+    return normalize(vec3(nextF32N(), nextF32N(), nextF32N()));
+}
+
+void allocateFailed() {
+    atomicAdd(freeCount, 1);
+}
+
+// Returns the index of a free particle, or -1 if the pool is exhausted
+int allocateParticle() {
+    int top = atomicAdd(freeCount, -1);
+    if (top <= 0) {
+        allocateFailed();
+        return -1;
+    }
+
+    return int(freeList[top - 1]);
+}
+
+void freeParticle(uint index) {
+    int top = atomicAdd(freeCount, 1);
+    freeList[top] = index;
+}
+
+uint particleSlot(Particle p) {
+    return (p.info >> 16) & 0xFFu;
+}
+
+mat4 rotationX(float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(1, 0, 0, 0, 0, c, s, 0, 0, -s, c, 0, 0, 0, 0, 1);
+}
+
+mat4 rotationY(float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, 0, 0, 0, 1);
+}
+
+mat4 rotationZ(float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(c, s, 0, 0, -s, c, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+}
+
+bool buildInstance(Particle p, out Instance inst) {
+    uint slot = particleSlot(p);
+    if ((EMITTER.state & STATE_VISIBLE) == 0u) {
+        return false;
+    }
+
+    float baseScale = p.baseScale;
+    vec3 scale = vec3(baseScale * EMITTER.scale.y, baseScale, 1.0);
+    switch (EMITTER.scaleAnimDir) {
+    case 0u: scale.xy *= p.animScale; break;
+    case 1u: scale.x *= p.animScale; break;
+    case 2u: scale.y *= p.animScale; break;
+    }
+
+    vec3 pos = p.emitterPosAnimAlpha.xyz + p.positionAge.xyz + EMITTER.basePos.xyz;
+
+    if (EMITTER.drawType == 0u) { // Billboard
+        float c = cos(p.rotation);
+        float s = sin(p.rotation);
+        inst.transform = mat4(
+            c * scale.x, s * scale.x, 0, 0,
+            -s * scale.y, c * scale.y, 0, 0,
+            0, 0, scale.z, 0,
+            pos, 1
+        );
+    } else if (EMITTER.drawType == 1u) { // Directional Billboard
+        vec3 velocity = p.velocityLifeTime.xyz;
+        vec3 cameraDir = vec3(-view[0][2], -view[1][2], -view[2][2]);
+        vec3 dir = cross(velocity, cameraDir);
+        if (dot(dir, dir) < 0.0001) {
+            return false;
+        }
+
+        dir = normalize(dir);
+        float d = dot(normalize(velocity), -cameraDir);
+        if (d < 0.0) {
+            return false;
+        }
+
+        scale.y *= (1.0 - d) * EMITTER.scale.z + 1.0;
+        inst.transform = mat4(
+            dir.x * scale.x, dir.y * scale.x, 0, 0,
+            -dir.y * scale.y, dir.x * scale.y, 0, 0,
+            0, 0, 1, 0,
+            pos, 1
+        );
+    } else if (EMITTER.drawType == 2u) { // Polygon
+        mat4 rotation = rotationY(p.rotation);
+        if ((EMITTER.flags & FLAG_POLYGON_ROT_XYZ) != 0u) {
+            rotation = rotationX(p.rotation) * rotation * rotationZ(p.rotation);
+        }
+
+        mat4 plane = (EMITTER.flags & FLAG_POLYGON_PLANE_XZ) != 0u
+            ? mat4(1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1)
+            : mat4(1.0);
+
+        mat4 local = mat4(1.0);
+        local[0][0] = scale.x;
+        local[1][1] = scale.y;
+        local[3] = vec4(EMITTER.childEmission.zw * scale.xy, 0, 1);
+
+        inst.transform = rotation * plane * local;
+        inst.transform[3].xyz += pos;
+    } else { // Directional Polygon (Center)
+        vec3 dir = (EMITTER.flags & FLAG_DPOL_FACE_EMITTER) != 0u ? p.positionAge.xyz : p.velocityLifeTime.xyz;
+        if (dot(dir, dir) < 0.0001) {
+            return false;
+        }
+
+        dir = normalize(dir);
+        bool planeXZ = (EMITTER.flags & FLAG_POLYGON_PLANE_XZ) != 0u;
+        vec3 ref = planeXZ ? vec3(0, 1, 0) : vec3(0, 0, 1);
+        if (abs(dot(dir, ref)) > 0.999) {
+            ref = planeXZ ? vec3(1, 0, 0) : vec3(0, 1, 0);
+        }
+
+        vec3 side = normalize(cross(dir, ref));
+        vec3 normal = cross(side, dir);
+        mat4 basis = mat4(vec4(side, 0), vec4(dir, 0), vec4(normal, 0), vec4(pos, 1));
+
+        vec2 offset = EMITTER.childEmission.zw;
+        if (EMITTER.drawType == 3u) {
+            offset.y += 1.0; // Starts at the particle and extends forwards
+        }
+
+        mat4 local = mat4(1.0);
+        local[0][0] = scale.x;
+        local[1][1] = scale.y;
+        local[3] = vec4(offset * scale.xy, 0, 1);
+
+        inst.transform = basis * rotationY(p.rotation) * local;
+    }
+
+    vec2 st = (p.info & INFO_CHILD) != 0u ? EMITTER.texCoords.zw : EMITTER.texCoords.xy;
+    inst.color = vec4(p.colorBaseAlpha.rgb, p.colorBaseAlpha.a * p.emitterPosAnimAlpha.w);
+    inst.texCoords[0] = vec2(0, 0);
+    inst.texCoords[1] = vec2(st.x, 0);
+    inst.texCoords[2] = st;
+    inst.texCoords[3] = vec2(0, st.y);
+
+    return true;
+}
+
+uint instanceTexture(Particle p) {
+    return p.texIndex < textureCount ? p.texIndex : 0u;
+}
+)";
+
+constexpr auto s_emitShader = R"(
+layout(local_size_x = 64) in;
+
+vec2 circularRand(float radius) {
+    float angle = range(0.0, TWO_PI);
+    return vec2(cos(angle), sin(angle)) * radius;
+}
+
+vec2 diskRand(float radius) {
+    vec2 result;
+    do {
+        result = vec2(range(-radius, radius), range(-radius, radius));
+    } while (dot(result, result) > radius * radius);
+    return result;
+}
+
+vec3 sphericalRand(float radius) {
+    float theta = range(0.0, TWO_PI);
+    float z = range(-1.0, 1.0);
+    float r = sqrt(1.0 - z * z);
+    return vec3(r * cos(theta), r * sin(theta), z) * radius;
+}
+
+vec3 ballRand(float radius) {
+    vec3 result;
+    do {
+        result = vec3(range(-radius, radius), range(-radius, radius), range(-radius, radius));
+    } while (dot(result, result) > radius * radius);
+    return result;
+}
+
+vec3 tiltCoordinates(uint slot, vec3 v) {
+    vec3 axis1 = EMITTER.crossAxis1.xyz;
+    vec3 axis2 = EMITTER.crossAxis2.xyz;
+    return v.x * axis1 + v.y * axis2 + v.z * normalize(cross(axis1, axis2));
+}
+
+vec3 emissionPosition(uint slot, uint i, uint count) {
+    float radius = EMITTER.emission.x;
+    float len = EMITTER.emission.y;
+    vec3 up = cross(EMITTER.crossAxis1.xyz, EMITTER.crossAxis2.xyz);
+
+    switch (EMITTER.emissionType) {
+    case 1u: return sphericalRand(radius);
+    case 2u: return tiltCoordinates(slot, vec3(circularRand(radius), 0));
+    case 3u: {
+        float angle = mix(0.0, TWO_PI, float(i) / float(count));
+        return tiltCoordinates(slot, vec3(sin(angle) * radius, cos(angle) * radius, 0));
+    }
+    case 4u: return ballRand(radius);
+    case 5u: return tiltCoordinates(slot, vec3(diskRand(radius), 0));
+    case 6u: return tiltCoordinates(slot, vec3(circularRand(radius), range(-len, len)));
+    case 7u: return tiltCoordinates(slot, vec3(diskRand(radius), range(-len, len)));
+    case 8u: {
+        vec3 p = sphericalRand(radius);
+        return dot(p, up) <= 0.0 ? -p : p;
+    }
+    case 9u: {
+        vec3 p = ballRand(radius);
+        return dot(p, up) <= 0.0 ? -p : p;
+    }
+    }
+
+    return vec3(0);
+}
+
+void main() {
+    uvec4 request = emissionRequests[gl_WorkGroupID.x];
+    uint slot = request.x;
+    uint batchSize = request.z;
+    uint total = request.y * batchSize;
+
+    for (uint i = gl_LocalInvocationID.x; i < total; i += gl_WorkGroupSize.x) {
+        int index = allocateParticle();
+        if (index < 0) {
+            return;
+        }
+
+        seedRandom(uint(index), request.w + i);
+
+        Particle p;
+        vec3 pos = emissionPosition(slot, i % batchSize, batchSize);
+
+        float magPos = scaledRange2(EMITTER.emission.z, EMITTER.variance.z);
+        float magAxis = scaledRange2(EMITTER.emission.w, EMITTER.variance.z);
+
+        vec3 posNorm;
+        if (EMITTER.emissionType == 6u) {
+            vec3 axis1 = EMITTER.crossAxis1.xyz;
+            vec3 axis2 = EMITTER.crossAxis2.xyz;
+            posNorm = normalize(dot(pos, axis1) * axis1 + dot(pos, axis2) * axis2);
+        } else if (pos == vec3(0)) {
+            posNorm = unitVector();
+        } else {
+            posNorm = normalize(pos);
+        }
+
+        vec3 velocity = posNorm * magPos + EMITTER.axis.xyz * magAxis + EMITTER.initVelocity.xyz;
+
+        vec3 color = EMITTER.color.rgb;
+        if ((EMITTER.flags & FLAG_COLOR_RANDOM_START) != 0u) {
+            uint choice = nextU32() % 3u;
+            color = choice == 0u ? EMITTER.colorAnimStart.rgb : choice == 1u ? color : EMITTER.colorAnimEnd.rgb;
+        }
+
+        p.positionAge = vec4(pos, 0.0);
+        p.velocityLifeTime = vec4(velocity, scaledRange(EMITTER.variance.w, EMITTER.variance.y));
+        p.colorBaseAlpha = vec4(color, EMITTER.color.a);
+        p.emitterPosAnimAlpha = vec4(EMITTER.position.xyz, 1.0);
+        p.rotation = (EMITTER.flags & FLAG_RANDOM_INIT_ANGLE) != 0u ? range(0.0, TWO_PI) : EMITTER.rotation.x;
+        p.angularVelocity = (EMITTER.flags & FLAG_HAS_ROTATION) != 0u ? range(EMITTER.rotation.y, EMITTER.rotation.z) : 0.0;
+        p.baseScale = scaledRange2(EMITTER.scale.x, EMITTER.variance.x);
+        p.animScale = 0.0;
+        p.emissionTimer = 0.0;
+        p.lifeRateOffset = (EMITTER.flags & FLAG_RANDOMIZE_LOOPED_ANIM) != 0u ? nextF32() : 0.0;
+
+        if ((EMITTER.flags & FLAG_HAS_TEX_ANIM) != 0u) {
+            p.texIndex = (EMITTER.flags & FLAG_TEX_RANDOM_INIT) != 0u
+                ? EMITTER.texAnimTextures[nextU32() % max(EMITTER.texAnimCount, 1u)]
+                : EMITTER.texAnimTextures[0];
+        } else {
+            p.texIndex = EMITTER.textureIndex;
+        }
+
+        p.info = INFO_ALIVE | (slot << 16);
+        particles[index] = p;
+    }
+}
+)";
+
+constexpr auto s_updateShader = R"(
+layout(local_size_x = 64) in;
+
+float curve(float lifeRate, float in_, float out_, float start, float mid, float end_) {
+    if (lifeRate < in_) {
+        return mix(start, mid, lifeRate / in_);
+    } else if (lifeRate < out_) {
+        return mid;
+    }
+
+    return mix(mid, end_, (lifeRate - out_) / (1.0 - out_));
+}
+
+void applyBehaviors(uint slot, inout Particle p, inout vec3 acc) {
+    for (uint i = 0u; i < EMITTER.behaviorCount; i++) {
+        Behavior b = EMITTER.behaviors[i];
+
+        switch (b.type) {
+        case 0u: // Gravity
+            acc += b.params.xyz;
+            break;
+        case 1u: // Random
+            if (b.apply != 0u) {
+                acc += vec3(aroundZero(b.params.x), aroundZero(b.params.y), aroundZero(b.params.z));
+            }
+            break;
+        case 2u: // Magnet
+            acc += b.params.w * (b.params.xyz - (p.positionAge.xyz + p.velocityLifeTime.xyz));
+            break;
+        case 3u: { // Spin
+            float angle = b.params.x * deltaTime;
+            float c = cos(angle);
+            float s = sin(angle);
+            vec3 pos = p.positionAge.xyz;
+            if (b.mode == 0u) {
+                p.positionAge.xyz = vec3(pos.x, c * pos.y - s * pos.z, s * pos.y + c * pos.z);
+            } else if (b.mode == 1u) {
+                p.positionAge.xyz = vec3(c * pos.x + s * pos.z, pos.y, -s * pos.x + c * pos.z);
+            } else {
+                p.positionAge.xyz = vec3(c * pos.x - s * pos.y, s * pos.x + c * pos.y, pos.z);
+            }
+        } break;
+        case 4u: { // Collision Plane
+            float cy = b.params.x;
+            float py = p.positionAge.y;
+            float ey = p.emitterPosAnimAlpha.y;
+            bool movedAbove = ey < cy && ey + py > cy;
+            bool movedBelow = ey >= cy && ey + py < cy;
+            if (movedAbove || movedBelow) {
+                p.positionAge.y = cy - ey;
+                if (b.mode == 0u) { // Kill
+                    p.positionAge.w = p.velocityLifeTime.w;
+                } else { // Bounce
+                    p.velocityLifeTime.y *= -b.params.y;
+                }
+            }
+        } break;
+        case 5u: // Convergence
+            p.positionAge.xyz += b.params.w * (b.params.xyz - p.positionAge.xyz) * deltaTime;
+            break;
+        }
+    }
+}
+
+void updateParent(uint slot, inout Particle p) {
+    float lifeRate = p.positionAge.w / p.velocityLifeTime.w;
+    float loopRate = fract(p.lifeRateOffset + p.positionAge.w / EMITTER.rotation.w);
+    uint flags = EMITTER.flags;
+
+    if ((flags & FLAG_SCALE_ANIM) != 0u) {
+        float rate = (flags & FLAG_SCALE_LOOP) != 0u ? loopRate : lifeRate;
+        p.animScale = curve(rate, EMITTER.curves.x, EMITTER.curves.y, EMITTER.scaleAnim.x, EMITTER.scaleAnim.y, EMITTER.scaleAnim.z);
+    }
+
+    if ((flags & FLAG_COLOR_ANIM) != 0u) {
+        float rate = (flags & FLAG_COLOR_LOOP) != 0u ? loopRate : lifeRate;
+        bool interpolate = (flags & FLAG_COLOR_INTERPOLATE) != 0u;
+        float in_ = EMITTER.colorCurve.x;
+        float peak = EMITTER.colorCurve.y;
+        float out_ = EMITTER.colorCurve.z;
+        vec3 start = EMITTER.colorAnimStart.rgb;
+        vec3 end_ = EMITTER.colorAnimEnd.rgb;
+        vec3 color = EMITTER.color.rgb;
+
+        if (rate < in_) {
+            p.colorBaseAlpha.rgb = start;
+        } else if (rate < peak) {
+            p.colorBaseAlpha.rgb = interpolate ? mix(start, color, (rate - in_) / (peak - in_)) : color;
+        } else if (rate < out_) {
+            p.colorBaseAlpha.rgb = interpolate ? mix(color, end_, (rate - peak) / (out_ - peak)) : end_;
+        } else {
+            p.colorBaseAlpha.rgb = end_;
+        }
+    }
+
+    if ((flags & FLAG_ALPHA_ANIM) != 0u) {
+        float rate = (flags & FLAG_ALPHA_LOOP) != 0u ? loopRate : lifeRate;
+        float alpha = curve(rate, EMITTER.curves.z, EMITTER.curves.w, EMITTER.alphaAnim.x, EMITTER.alphaAnim.y, EMITTER.alphaAnim.z);
+        p.emitterPosAnimAlpha.w = clamp(scaledRange(alpha, EMITTER.alphaAnim.w), 0.0, 1.0);
+    }
+
+    if ((flags & FLAG_TEX_ANIM) != 0u) {
+        float rate = (flags & FLAG_TEX_LOOP) != 0u ? loopRate : lifeRate;
+        for (uint i = 0u; i < EMITTER.texAnimCount; i++) {
+            if (rate < EMITTER.colorCurve.w * float(i + 1u)) {
+                p.texIndex = EMITTER.texAnimTextures[i];
+                break;
+            }
+        }
+    }
+
+    if ((flags & FLAG_FOLLOW_EMITTER) != 0u) {
+        p.emitterPosAnimAlpha.xyz = EMITTER.position.xyz;
+    }
+
+    vec3 acc = vec3(0);
+    applyBehaviors(slot, p, acc);
+
+    p.rotation += p.angularVelocity * deltaTime;
+    p.velocityLifeTime.xyz *= EMITTER.scale.w;
+    p.velocityLifeTime.xyz += acc * deltaTime;
+    p.positionAge.xyz += (p.velocityLifeTime.xyz + EMITTER.velocity.xyz) * deltaTime;
+
+    if ((flags & FLAG_CHILD_RESOURCE) != 0u) {
+        float rate = p.positionAge.w / p.velocityLifeTime.w;
+        if (rate >= EMITTER.childEmission.x) {
+            float interval = EMITTER.childEmission.y;
+            uint emissions = 0u;
+
+            if (interval == 0.0 || p.positionAge.w == 0.0) {
+                emissions = 1u;
+            } else {
+                while (p.emissionTimer >= interval) {
+                    p.emissionTimer -= interval;
+                    emissions++;
+                }
+            }
+
+            uint count = emissions * EMITTER.childEmissionCount;
+            if (count > 0u) {
+                uint request = atomicAdd(childRequestCount, 1u);
+                if (request < maxChildRequests) {
+                    childRequests[request].parent = p;
+                    childRequests[request].slot = slot;
+                    childRequests[request].count = count;
+                }
+            }
+        }
+    }
+}
+
+void updateChild(uint slot, inout Particle p) {
+    float lifeRate = p.positionAge.w / p.velocityLifeTime.w;
+    uint childFlags = EMITTER.childFlags;
+
+    if ((childFlags & CHILD_SCALE_ANIM) != 0u) {
+        p.animScale = mix(0.0, EMITTER.childParams.x, lifeRate);
+    }
+
+    if ((childFlags & CHILD_ALPHA_ANIM) != 0u) {
+        p.emitterPosAnimAlpha.w = mix(1.0, 0.0, lifeRate);
+    }
+
+    if ((childFlags & CHILD_FOLLOW_EMITTER) != 0u) {
+        p.emitterPosAnimAlpha.xyz = EMITTER.position.xyz;
+    }
+
+    vec3 acc = vec3(0);
+    if ((childFlags & CHILD_USES_BEHAVIORS) != 0u) {
+        applyBehaviors(slot, p, acc);
+    }
+
+    p.rotation += p.angularVelocity * deltaTime;
+    p.velocityLifeTime.xyz *= EMITTER.scale.w;
+    p.velocityLifeTime.xyz += acc * deltaTime;
+    p.positionAge.xyz += (p.velocityLifeTime.xyz + EMITTER.velocity.xyz) * deltaTime;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= maxParticles) {
+        return;
+    }
+
+    Particle p = particles[index];
+    bool child = (p.info & INFO_CHILD) != 0u;
+    if ((p.info & INFO_ALIVE) == 0u || child != (childPass != 0u)) {
+        return;
+    }
+
+    uint slot = particleSlot(p);
+    if ((EMITTER.state & STATE_ACTIVE) == 0u) {
+        return;
+    }
+
+    // Children are only simulated while the resource has a child resource, same as on the CPU
+    if (child && (EMITTER.flags & FLAG_CHILD_RESOURCE) == 0u) {
+        return;
+    }
+
+    seedRandom(index, frame * 2u + childPass);
+
+    if (child) {
+        updateChild(slot, p);
+    } else {
+        updateParent(slot, p);
+    }
+
+    p.positionAge.w += deltaTime;
+    p.emissionTimer += deltaTime;
+
+    if (p.positionAge.w >= p.velocityLifeTime.w) {
+        p.info &= ~INFO_ALIVE;
+        freeParticle(index);
+    }
+
+    particles[index] = p;
+}
+)";
+
+constexpr auto s_emitChildrenShader = R"(
+layout(local_size_x = 64) in;
+
+void main() {
+    uint r = gl_GlobalInvocationID.x;
+    if (r >= min(childRequestCount, maxChildRequests)) {
+        return;
+    }
+
+    Particle parent = childRequests[r].parent;
+    uint slot = childRequests[r].slot;
+    uint count = childRequests[r].count;
+
+    for (uint i = 0u; i < count; i++) {
+        int index = allocateParticle();
+        if (index < 0) {
+            return;
+        }
+
+        seedRandom(uint(index), frame * 0x10001u + i);
+
+        float mag = EMITTER.childColor.a;
+        Particle p;
+        p.positionAge = vec4(parent.positionAge.xyz, 0.0);
+        p.velocityLifeTime = vec4(
+            parent.velocityLifeTime.xyz * EMITTER.childParams.z + vec3(aroundZero(mag), aroundZero(mag), aroundZero(mag)),
+            EMITTER.childParams.y
+        );
+
+        vec3 color = (EMITTER.childFlags & CHILD_USE_CHILD_COLOR) != 0u ? EMITTER.childColor.rgb : parent.colorBaseAlpha.rgb;
+        p.colorBaseAlpha = vec4(color, parent.colorBaseAlpha.a * parent.emitterPosAnimAlpha.w);
+        p.emitterPosAnimAlpha = vec4(EMITTER.position.xyz, 1.0);
+        p.baseScale = parent.baseScale * parent.animScale * EMITTER.childParams.w;
+        p.animScale = 1.0;
+
+        switch (EMITTER.childRotationType) {
+        case 0u:
+            p.rotation = 0.0;
+            p.angularVelocity = 0.0;
+            break;
+        case 1u:
+            p.rotation = parent.rotation;
+            p.angularVelocity = 0.0;
+            break;
+        default:
+            p.rotation = parent.rotation;
+            p.angularVelocity = parent.angularVelocity;
+            break;
+        }
+
+        p.emissionTimer = 0.0;
+        p.lifeRateOffset = 0.0;
+        p.texIndex = EMITTER.childTexture;
+        p.info = INFO_ALIVE | INFO_CHILD | (slot << 16);
+        particles[index] = p;
+    }
+}
+)";
+
+constexpr auto s_countShader = R"(
+layout(local_size_x = 64) in;
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= maxParticles) {
+        return;
+    }
+
+    Particle p = particles[index];
+    Instance inst;
+    if ((p.info & INFO_ALIVE) != 0u && buildInstance(p, inst)) {
+        atomicAdd(textureCounts[instanceTexture(p)], 1u);
+    }
+}
+)";
+
+constexpr auto s_prefixShader = R"(
+layout(local_size_x = 1) in;
+
+void main() {
+    uint base = 0u;
+    for (uint i = 0u; i < textureCount; i++) {
+        commands[i] = DrawCommand(6u, textureCounts[i], 0u, 0, base);
+        textureCursors[i] = base;
+        base += textureCounts[i];
+    }
+}
+)";
+
+constexpr auto s_scatterShader = R"(
+layout(local_size_x = 64) in;
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= maxParticles) {
+        return;
+    }
+
+    Particle p = particles[index];
+    Instance inst;
+    if ((p.info & INFO_ALIVE) != 0u && buildInstance(p, inst)) {
+        uint dst = atomicAdd(textureCursors[instanceTexture(p)], 1u);
+        instances[dst] = inst;
+    }
+}
+)";
+
+u32 createBuffer(u32 target, size_t size, const void* data = nullptr) {
+    u32 buffer;
+    glCall(glGenBuffers(1, &buffer));
+    glCall(glBindBuffer(target, buffer));
+    glCall(glBufferData(target, size, data, GL_DYNAMIC_DRAW));
+    glCall(glBindBuffer(target, 0));
+    return buffer;
+}
+
+u32 dispatchSize(u32 count) {
+    return (count + s_workGroupSize - 1) / s_workGroupSize;
+}
+
+GPUParticle toGPUParticle(const SPLParticle& ptcl, u32 slot) {
+    return {
+        .position = ptcl.position,
+        .age = ptcl.age,
+        .velocity = ptcl.velocity,
+        .lifeTime = ptcl.lifeTime,
+        .color = ptcl.color,
+        .baseAlpha = ptcl.visibility.baseAlpha,
+        .emitterPos = ptcl.emitterPos,
+        .animAlpha = ptcl.visibility.animAlpha,
+        .rotation = ptcl.rotation,
+        .angularVelocity = ptcl.angularVelocity,
+        .baseScale = ptcl.baseScale,
+        .animScale = ptcl.animScale,
+        .emissionTimer = ptcl.emissionTimer,
+        .lifeRateOffset = ptcl.lifeRateOffset,
+        .texture = ptcl.texture,
+        .info = 1u | (slot << 16)
+    };
+}
+
+}
+
+
+GPUParticleSimulator::GPUParticleSimulator(u32 maxParticles) : m_maxParticles(maxParticles), m_slots() {
+    const std::pair<u32*, size_t> buffers[] = {
+        { &m_particleBuffer, maxParticles * sizeof(GPUParticle) },
+        { &m_emitterBuffer, MAX_EMITTERS * sizeof(GPUEmitter) },
+        { &m_freeListBuffer, maxParticles * sizeof(u32) },
+        { &m_counterBuffer, sizeof(GPUCounters) },
+        { &m_childRequestBuffer, maxParticles * sizeof(GPUChildRequest) },
+        { &m_instanceBuffer, maxParticles * sizeof(ParticleInstance) },
+        { &m_commandBuffer, MAX_TEXTURES * sizeof(DrawElementsIndirectCommand) },
+        { &m_emissionBuffer, MAX_EMITTERS * sizeof(u32) * 4 }
+    };
+
+    u64 totalSize = 0;
+    for (const auto& [buffer, size] : buffers) {
+        *buffer = createBuffer(GL_SHADER_STORAGE_BUFFER, size);
+        totalSize += size;
+    }
+
+    m_memory.set(totalSize);
+
+    m_emitProgram = createProgram(s_emitShader);
+    m_updateProgram = createProgram(s_updateShader);
+    m_emitChildrenProgram = createProgram(s_emitChildrenShader);
+    m_countProgram = createProgram(s_countShader);
+    m_prefixProgram = createProgram(s_prefixShader);
+    m_scatterProgram = createProgram(s_scatterShader);
+
+    m_emissionRequests.reserve(MAX_EMITTERS);
+
+    reset();
+}
+
+GPUParticleSimulator::~GPUParticleSimulator() {
+    const u32 buffers[] = {
+        m_particleBuffer, m_emitterBuffer, m_freeListBuffer, m_counterBuffer,
+        m_childRequestBuffer, m_instanceBuffer, m_commandBuffer, m_emissionBuffer
+    };
+
+    glCall(glDeleteBuffers(std::size(buffers), buffers));
+
+    for (const u32 program : { m_emitProgram, m_updateProgram, m_emitChildrenProgram, m_countProgram, m_prefixProgram, m_scatterProgram }) {
+        glCall(glDeleteProgram(program));
+    }
+}
+
+bool GPUParticleSimulator::updateEmitter(const std::shared_ptr<SPLEmitter>& emitter, f32 deltaTime) {
+    const s32 index = acquireSlot(emitter);
+    if (index < 0) {
+        spdlog::warn("GPU simulation: out of emitter slots");
+        return false;
+    }
+
+    auto& slot = m_slots[index];
+    const auto resource = emitter->m_resource;
+
+    if (!slot.finished && emitter->isFinished()) {
+        // Particles can't outlive their lifetime, and children can't outlive their parent's by more than their own
+        slot.finished = true;
+        slot.drainTime = resource->header.particleLifeTime + deltaTime;
+        if (resource->childResource) {
+            slot.drainTime += resource->childResource->lifeTime;
+        }
+    }
+
+    if (slot.finished) {
+        slot.drainTime -= deltaTime;
+        if (slot.drainTime < 0.0f) {
+            slot = {};
+            return false;
+        }
+    }
+
+    const u32 emissions = emitter->consumeEmissions();
+    if (emissions > 0 && resource->header.emissionCount > 0) {
+        emitter->computeOrthogonalAxes();
+        m_emissionRequests.push_back({ (u32)index, emissions, resource->header.emissionCount, random::nextU32() });
+    }
+
+    slot.updated = true;
+
+    uploadEmitter(index, deltaTime);
+    emitter->advanceTimers(deltaTime);
+
+    return true;
+}
+
+void GPUParticleSimulator::simulate(f32 deltaTime) {
+    // Emitters that weren't updated this frame (paused, or skipped by their update cycle) keep their particles frozen
+    for (u32 i = 0; i < MAX_EMITTERS; i++) {
+        auto& slot = m_slots[i];
+        if (slot.emitter && !slot.updated) {
+            const u32 state = slot.emitter->m_state.renderingDisabled ? 0 : s_stateVisible;
+            glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_emitterBuffer));
+            glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, i * sizeof(GPUEmitter) + offsetof(GPUEmitter, state), sizeof(u32), &state));
+        }
+
+        slot.updated = false;
+    }
+
+    constexpr u32 zero = 0;
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(GPUCounters, childRequestCount), sizeof(u32), &zero));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_particleBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_emitterBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_freeListBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_counterBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_childRequestBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, m_emissionBuffer));
+
+    // Emission happens before the update so new particles are simulated on the frame they're emitted on, same as on the CPU
+    if (!m_emissionRequests.empty()) {
+        glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_emissionBuffer));
+        glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_emissionRequests.size() * sizeof(m_emissionRequests[0]), m_emissionRequests.data()));
+        glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+        glCall(glUseProgram(m_emitProgram));
+        glCall(glDispatchCompute((u32)m_emissionRequests.size(), 1, 1));
+        glCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+        m_emissionRequests.clear();
+    }
+
+    glCall(glUseProgram(m_updateProgram));
+    glCall(glUniform1f(0, deltaTime));
+    glCall(glUniform1ui(1, m_frame));
+    glCall(glUniform1ui(2, 0));
+    glCall(glDispatchCompute(dispatchSize(m_maxParticles), 1, 1));
+    glCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+    glCall(glUseProgram(m_emitChildrenProgram));
+    glCall(glUniform1ui(1, m_frame));
+    glCall(glDispatchCompute(dispatchSize(m_maxParticles), 1, 1));
+    glCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+    glCall(glUseProgram(m_updateProgram));
+    glCall(glUniform1ui(2, 1));
+    glCall(glDispatchCompute(dispatchSize(m_maxParticles), 1, 1));
+    glCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+    glCall(glUseProgram(0));
+
+    ++m_frame;
+}
+
+void GPUParticleSimulator::render(ParticleRenderer& renderer) {
+    const u32 textureCount = (u32)std::min<size_t>(renderer.getTextureCount(), MAX_TEXTURES);
+    if (textureCount == 0) {
+        // Nothing to draw, but the budget tracker's frame that begin() started still has to end
+        renderer.end();
+        return;
+    }
+
+    constexpr u32 zeros[MAX_TEXTURES] = {};
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(GPUCounters, textureCounts), sizeof(zeros), zeros));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_particleBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_emitterBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_counterBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_instanceBuffer));
+    glCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, m_commandBuffer));
+
+    // Count instances per texture, turn the counts into draw commands, then scatter the instances into place
+    glCall(glUseProgram(m_countProgram));
+    glCall(glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(renderer.getView())));
+    glCall(glUniform1ui(4, textureCount));
+    glCall(glDispatchCompute(dispatchSize(m_maxParticles), 1, 1));
+    glCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+    glCall(glUseProgram(m_prefixProgram));
+    glCall(glUniform1ui(4, textureCount));
+    glCall(glDispatchCompute(1, 1, 1));
+    glCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+    glCall(glUseProgram(m_scatterProgram));
+    glCall(glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(renderer.getView())));
+    glCall(glUniform1ui(4, textureCount));
+    glCall(glDispatchCompute(dispatchSize(m_maxParticles), 1, 1));
+    glCall(glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT));
+
+    renderer.renderIndirect(m_instanceBuffer, m_commandBuffer, textureCount);
+}
+
+void GPUParticleSimulator::reset() {
+    m_slots = {};
+    m_emissionRequests.clear();
+    m_frame = 0;
+
+    // The free list is a stack, store it in reverse so that low indices are handed out first
+    std::vector<u32> freeList(m_maxParticles);
+    std::iota(freeList.rbegin(), freeList.rend(), 0u);
+
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_freeListBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, freeList.size() * sizeof(u32), freeList.data()));
+
+    const std::vector<GPUParticle> particles(m_maxParticles, GPUParticle{});
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_particleBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, particles.size() * sizeof(GPUParticle), particles.data()));
+
+    const GPUCounters counters = {
+        .freeCount = (s32)m_maxParticles,
+        .childRequestCount = 0,
+        .maxParticles = m_maxParticles,
+        .maxChildRequests = m_maxParticles,
+        .textureCounts = {},
+        .textureCursors = {}
+    };
+
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GPUCounters), &counters));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+void GPUParticleSimulator::inject(const std::shared_ptr<SPLEmitter>& emitter, std::span<SPLParticle* const> particles) {
+    // Only valid right after a reset, the particles take the first indices of the pool
+    const s32 slot = acquireSlot(emitter);
+    if (slot < 0) {
+        return;
+    }
+
+    const u32 count = std::min<u32>((u32)particles.size(), m_maxParticles);
+    std::vector<GPUParticle> data(count);
+    for (u32 i = 0; i < count; i++) {
+        data[i] = toGPUParticle(*particles[i], slot);
+    }
+
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_particleBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GPUParticle), data.data()));
+
+    const s32 freeCount = (s32)(m_maxParticles - count);
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(GPUCounters, freeCount), sizeof(s32), &freeCount));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+std::vector<GPUParticle> GPUParticleSimulator::readParticles() const {
+    std::vector<GPUParticle> particles(m_maxParticles);
+
+    glCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_particleBuffer));
+    glCall(glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, particles.size() * sizeof(GPUParticle), particles.data()));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+    return particles;
+}
+
+GPUValidationReport GPUParticleSimulator::validate(const SPLResource& resource, std::span<const SPLTexture> textures, u32 frames, f32 deltaTime) {
+    constexpr u32 maxParticles = 1 << 14;
+    constexpr f32 tolerance = 1e-3f;
+
+    GPUValidationReport report{};
+    report.frames = frames;
+
+    // Randomness after emission can't be reproduced on the GPU, only the particle counts are compared then
+    for (const auto& behavior : resource.behaviors) {
+        if (behavior->type == SPLBehaviorType::Random) {
+            report.deterministic = false;
+        }
+    }
+
+    if (resource.header.flags.hasAlphaAnim && resource.alphaAnim && resource.alphaAnim->flags.randomRange > 0.0f) {
+        report.deterministic = false;
+    }
+
+    // Emission is random as well, so both sides start from the same set of CPU emitted particles
+    ParticleSystem cpuSystem(maxParticles, textures);
+    const auto cpuEmitter = std::make_shared<SPLEmitter>(&resource, &cpuSystem);
+    const auto gpuEmitter = std::make_shared<SPLEmitter>(&resource, &cpuSystem);
+
+    cpuEmitter->emit(resource.header.emissionCount);
+    cpuEmitter->m_state.terminate = true;
+    gpuEmitter->m_state.terminate = true;
+
+    const std::vector<SPLParticle*> parents = cpuEmitter->m_particles;
+    report.particles = (u32)parents.size();
+
+    GPUParticleSimulator simulator(maxParticles);
+    simulator.inject(gpuEmitter, parents);
+
+    const auto relativeError = [](const auto& expected, const auto& actual) {
+        return glm::length(actual - expected) / std::max(1.0f, glm::length(expected));
+    };
+
+    for (u32 frame = 0; frame < frames; frame++) {
+        cpuEmitter->update(deltaTime);
+        simulator.updateEmitter(gpuEmitter, deltaTime);
+        simulator.simulate(deltaTime);
+
+        const auto gpuParticles = simulator.readParticles();
+        const std::unordered_set<SPLParticle*> alive(cpuEmitter->m_particles.begin(), cpuEmitter->m_particles.end());
+
+        bool mismatch = false;
+        for (u32 i = 0; i < parents.size(); i++) {
+            const auto& gpu = gpuParticles[i];
+            const bool cpuAlive = alive.contains(parents[i]);
+            const bool gpuAlive = gpu.isAlive() && !gpu.isChild();
+
+            if (cpuAlive != gpuAlive) {
+                mismatch = true;
+                continue;
+            }
+
+            if (!cpuAlive || !report.deterministic) {
+                continue;
+            }
+
+            const auto& cpu = *parents[i];
+            report.maxPositionError = std::max(report.maxPositionError, relativeError(cpu.position, gpu.position));
+            report.maxVelocityError = std::max(report.maxVelocityError, relativeError(cpu.velocity, gpu.velocity));
+            report.maxColorError = std::max(report.maxColorError, glm::length(gpu.color - cpu.color));
+            report.maxAlphaError = std::max(report.maxAlphaError, glm::abs(gpu.animAlpha - cpu.visibility.animAlpha));
+            report.maxScaleError = std::max(report.maxScaleError, glm::abs(gpu.animScale - cpu.animScale) / std::max(1.0f, glm::abs(cpu.animScale)));
+        }
+
+        const auto gpuChildren = std::ranges::count_if(gpuParticles, [](const GPUParticle& p) {
+            return p.isAlive() && p.isChild();
+        });
+
+        if ((size_t)gpuChildren != cpuEmitter->m_childParticles.size()) {
+            mismatch = true;
+        }
+
+        report.aliveMismatches += mismatch;
+    }
+
+    report.passed = report.aliveMismatches == 0 && (!report.deterministic || (
+        report.maxPositionError <= tolerance
+        && report.maxVelocityError <= tolerance
+        && report.maxColorError <= tolerance
+        && report.maxAlphaError <= tolerance
+        && report.maxScaleError <= tolerance
+    ));
+
+    return report;
+}
+
+s32 GPUParticleSimulator::acquireSlot(const std::shared_ptr<SPLEmitter>& emitter) {
+    s32 freeSlot = -1;
+    for (u32 i = 0; i < MAX_EMITTERS; i++) {
+        if (m_slots[i].emitter == emitter) {
+            return (s32)i;
+        }
+
+        if (!m_slots[i].emitter && freeSlot < 0) {
+            freeSlot = (s32)i;
+        }
+    }
+
+    if (freeSlot >= 0) {
+        m_slots[freeSlot] = {
+            .emitter = emitter,
+            .drainTime = 0.0f,
+            .randomTimer = 0.0f,
+            .updated = false,
+            .finished = false
+        };
+    }
+
+    return freeSlot;
+}
+
+void GPUParticleSimulator::uploadEmitter(u32 index, f32 deltaTime) {
+    auto& slot = m_slots[index];
+    const auto& emitter = *slot.emitter;
+    const auto& resource = *emitter.m_resource;
+    const auto& header = resource.header;
+
+    GPUEmitter data{};
+    data.position = glm::vec4(emitter.m_position, 0);
+    data.velocity = glm::vec4(emitter.m_velocity, 0);
+    data.initVelocity = glm::vec4(emitter.m_particleInitVelocity, 0);
+    data.axis = glm::vec4(emitter.m_axis, 0);
+    data.crossAxis1 = glm::vec4(emitter.m_crossAxis1, 0);
+    data.crossAxis2 = glm::vec4(emitter.m_crossAxis2, 0);
+    data.basePos = glm::vec4(header.emitterBasePos, 0);
+    data.color = glm::vec4(header.color, header.misc.baseAlpha);
+    data.emission = { header.radius, header.length, header.initVelPosAmplifier, header.initVelAxisAmplifier };
+    data.scale = { header.baseScale, header.aspectRatio, header.misc.dbbScale, header.misc.airResistance };
+    data.variance = { header.variance.baseScale, header.variance.lifeTime, header.variance.initVel, header.particleLifeTime };
+    data.rotation = { header.initAngle, header.minRotation, header.maxRotation, header.misc.loopTime };
+    data.texCoords = { emitter.m_texCoords, emitter.m_childTexCoords };
+    data.emissionType = (u32)header.flags.emissionType;
+    data.drawType = (u32)header.flags.drawType;
+    data.scaleAnimDir = (u32)header.misc.scaleAnimDir;
+    data.textureIndex = header.misc.textureIndex;
+    data.childEmission = { 0, 0, header.polygonX, header.polygonY };
+
+    u32 flags = 0;
+    if (header.flags.hasScaleAnim && resource.scaleAnim) {
+        const auto& anim = resource.scaleAnim.value();
+        flags |= s_flagScaleAnim | (anim.flags.loop ? s_flagScaleLoop : 0);
+        data.scaleAnim = { anim.start, anim.mid, anim.end, 0 };
+        data.curves.x = anim.curve.getIn();
+        data.curves.y = anim.curve.getOut();
+    }
+
+    if (header.flags.hasColorAnim && resource.colorAnim) {
+        const auto& anim = resource.colorAnim.value();
+        flags |= anim.flags.randomStartColor ? s_flagColorRandomStart : s_flagColorAnim;
+        flags |= (anim.flags.loop ? s_flagColorLoop : 0) | (anim.flags.interpolate ? s_flagColorInterpolate : 0);
+        data.colorAnimStart = glm::vec4(anim.start, 0);
+        data.colorAnimEnd = glm::vec4(anim.end, 0);
+        data.colorCurve.x = anim.curve.getIn();
+        data.colorCurve.y = anim.curve.getPeak();
+        data.colorCurve.z = anim.curve.getOut();
+    }
+
+    if (header.flags.hasAlphaAnim && resource.alphaAnim) {
+        const auto& anim = resource.alphaAnim.value();
+        flags |= s_flagAlphaAnim | (anim.flags.loop ? s_flagAlphaLoop : 0);
+        data.alphaAnim = { anim.alpha.start, anim.alpha.mid, anim.alpha.end, anim.flags.randomRange };
+        data.curves.z = anim.curve.getIn();
+        data.curves.w = anim.curve.getOut();
+    }
+
+    if (header.flags.hasTexAnim && resource.texAnim) {
+        const auto& anim = resource.texAnim.value();
+        flags |= s_flagHasTexAnim | (anim.param.loop ? s_flagTexLoop : 0);
+        flags |= anim.param.randomizeInit ? s_flagTexRandomInit : s_flagTexAnim;
+        std::ranges::copy(anim.textures, data.texAnimTextures);
+        data.texAnimCount = std::min<u32>(anim.param.textureCount, 8);
+        data.colorCurve.w = anim.param.step;
+    }
+
+    flags |= header.flags.followEmitter ? s_flagFollowEmitter : 0;
+    flags |= header.flags.randomInitAngle ? s_flagRandomInitAngle : 0;
+    flags |= header.flags.hasRotation ? s_flagHasRotation : 0;
+    flags |= header.flags.randomizeLoopedAnim ? s_flagRandomizeLoopedAnim : 0;
+    flags |= header.flags.polygonRotAxis == SPLPolygonRotAxis::XYZ ? s_flagPolygonRotXYZ : 0;
+    flags |= header.flags.polygonReferencePlane != 0 ? s_flagPolygonPlaneXZ : 0;
+    flags |= header.misc.dpolFaceEmitter ? s_flagDpolFaceEmitter : 0;
+
+    if (header.flags.hasChildResource && resource.childResource) {
+        const auto& child = resource.childResource.value();
+        flags |= s_flagChildResource;
+
+        u32 childFlags = 0;
+        childFlags |= child.flags.usesBehaviors ? s_childFlagUsesBehaviors : 0;
+        childFlags |= child.flags.hasScaleAnim ? s_childFlagScaleAnim : 0;
+        childFlags |= child.flags.hasAlphaAnim ? s_childFlagAlphaAnim : 0;
+        childFlags |= child.flags.followEmitter ? s_childFlagFollowEmitter : 0;
+        childFlags |= child.flags.useChildColor ? s_childFlagUseChildColor : 0;
+
+        data.childFlags = childFlags;
+        data.childColor = glm::vec4(child.color, child.randomInitVelMag);
+        data.childParams = { child.endScale, child.lifeTime, child.velocityRatio, child.scaleRatio };
+        data.childEmission.x = child.misc.emissionDelay;
+        data.childEmission.y = child.misc.emissionInterval;
+        data.childTexture = child.misc.texture;
+        data.childEmissionCount = child.misc.emissionCount;
+        data.childRotationType = (u32)child.flags.rotationType;
+    }
+
+    data.flags = flags;
+
+    for (const auto& behavior : resource.behaviors) {
+        if (data.behaviorCount >= s_maxBehaviors) {
+            break;
+        }
+
+        auto& out = data.behaviors[data.behaviorCount++];
+        out.type = (u32)behavior->type;
+
+        switch (behavior->type) {
+        case SPLBehaviorType::Gravity: {
+            const auto gravity = std::static_pointer_cast<SPLGravityBehavior>(behavior);
+            out.params = glm::vec4(gravity->magnitude, 0);
+        } break;
+        case SPLBehaviorType::Random: {
+            // Tracked per emitter in simulation time rather than wall clock time
+            const auto random = std::static_pointer_cast<SPLRandomBehavior>(behavior);
+            out.params = glm::vec4(random->magnitude, 0);
+            out.apply = slot.randomTimer >= random->applyInterval;
+        } break;
+        case SPLBehaviorType::Magnet: {
+            const auto magnet = std::static_pointer_cast<SPLMagnetBehavior>(behavior);
+            out.params = glm::vec4(magnet->target, magnet->force);
+        } break;
+        case SPLBehaviorType::Spin: {
+            const auto spin = std::static_pointer_cast<SPLSpinBehavior>(behavior);
+            out.params = { spin->angle, 0, 0, 0 };
+            out.mode = (u32)spin->axis;
+        } break;
+        case SPLBehaviorType::CollisionPlane: {
+            const auto plane = std::static_pointer_cast<SPLCollisionPlaneBehavior>(behavior);
+            const f32 y = emitter.m_collisionPlaneHeight > std::numeric_limits<f32>::min()
+                ? emitter.m_collisionPlaneHeight
+                : plane->y;
+            out.params = { y, plane->elasticity, 0, 0 };
+            out.mode = (u32)plane->collisionType;
+        } break;
+        case SPLBehaviorType::Convergence: {
+            const auto convergence = std::static_pointer_cast<SPLConvergenceBehavior>(behavior);
+            out.params = glm::vec4(convergence->target, convergence->force);
+        } break;
+        }
+    }
+
+    const bool randomApplied = std::ranges::any_of(data.behaviors, [](const GPUBehavior& b) {
+        return b.type == (u32)SPLBehaviorType::Random && b.apply;
+    });
+
+    slot.randomTimer = randomApplied ? 0.0f : slot.randomTimer + deltaTime;
+
+    data.state = s_stateActive | (emitter.m_state.renderingDisabled ? 0 : s_stateVisible);
+
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_emitterBuffer));
+    glCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, index * sizeof(GPUEmitter), sizeof(GPUEmitter), &data));
+    glCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+u32 GPUParticleSimulator::createProgram(const char* source) const {
+    const u64 key = g_programCache ? g_programCache->makeKey({ s_commonShader, source }) : 0;
+    if (const u32 program = g_programCache ? g_programCache->load(key) : 0) {
+        return program;
+    }
+
+    const char* sources[] = { s_commonShader, source };
+
+    const u32 shader = glCreateShader(GL_COMPUTE_SHADER);
+    glCall(glShaderSource(shader, 2, sources, nullptr));
+    glCall(glCompileShader(shader));
+
+    s32 success;
+    char info[1024];
+    glCall(glGetShaderiv(shader, GL_COMPILE_STATUS, &success));
+    if (!success) {
+        glCall(glGetShaderInfoLog(shader, sizeof(info), nullptr, info));
+        spdlog::error("Failed to compile compute shader: {}", info);
+        glCall(glDeleteShader(shader));
+        return 0;
+    }
+
+    const u32 program = glCreateProgram();
+    glCall(glAttachShader(program, shader));
+    glCall(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    glCall(glLinkProgram(program));
+    glCall(glDeleteShader(shader));
+
+    glCall(glGetProgramiv(program, GL_LINK_STATUS, &success));
+    if (!success) {
+        glCall(glGetProgramInfoLog(program, sizeof(info), nullptr, info));
+        spdlog::error("Failed to link compute program: {}", info);
+        glCall(glDeleteProgram(program));
+        return 0;
+    }
+
+    if (g_programCache) {
+        g_programCache->store(key, program);
+    }
+
+    return program;
+}
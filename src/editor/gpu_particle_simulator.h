@@ -0,0 +1,121 @@
+#pragma once
+
+#include "types.h"
+#include "memory_tracker.h"
+#include "spl/spl_emitter.h"
+#include "spl/spl_resource.h"
+
+#include <array>
+#include <memory>
+#include <span>
+#include <vector>
+
+
+class ParticleRenderer;
+
+// Mirrors the std430 layout of the Particle struct in the compute shaders
+struct GPUParticle {
+    glm::vec3 position;
+    f32 age;
+    glm::vec3 velocity;
+    f32 lifeTime;
+    glm::vec3 color;
+    f32 baseAlpha;
+    glm::vec3 emitterPos;
+    f32 animAlpha;
+    f32 rotation;
+    f32 angularVelocity;
+    f32 baseScale;
+    f32 animScale;
+    f32 emissionTimer;
+    f32 lifeRateOffset;
+    u32 texture;
+    u32 info; // bit 0 = alive, bit 1 = child, bits 16-23 = emitter slot
+
+    bool isAlive() const { return info & 1; }
+    bool isChild() const { return info & 2; }
+};
+
+struct GPUValidationReport {
+    u32 frames = 0;
+    u32 particles = 0; // Number of parent particles compared
+    u32 aliveMismatches = 0; // Frames where the number of live particles differed
+    f32 maxPositionError = 0;
+    f32 maxVelocityError = 0;
+    f32 maxColorError = 0;
+    f32 maxAlphaError = 0;
+    f32 maxScaleError = 0;
+    bool deterministic = true; // False if the resource uses randomness after emission
+    bool passed = false;
+};
+
+// Simulates and renders particles entirely on the GPU using compute shaders.
+// Emitters still live on the CPU, only the per-emitter parameters are uploaded each frame.
+class GPUParticleSimulator {
+public:
+    static constexpr u32 MAX_EMITTERS = 256;
+    static constexpr u32 MAX_TEXTURES = 256;
+
+    explicit GPUParticleSimulator(u32 maxParticles);
+    ~GPUParticleSimulator();
+
+    GPUParticleSimulator(const GPUParticleSimulator&) = delete;
+    GPUParticleSimulator& operator=(const GPUParticleSimulator&) = delete;
+
+    // Schedules emission for the emitter and advances its timers.
+    // Returns false once the emitter is finished and all of its particles are guaranteed to be dead.
+    bool updateEmitter(const std::shared_ptr<SPLEmitter>& emitter, f32 deltaTime);
+    void simulate(f32 deltaTime);
+    void render(ParticleRenderer& renderer);
+    void reset();
+
+    // Copies existing CPU particles into the simulation, attached to the given emitter
+    void inject(const std::shared_ptr<SPLEmitter>& emitter, std::span<SPLParticle* const> particles);
+    std::vector<GPUParticle> readParticles() const;
+
+    u32 getMaxParticles() const { return m_maxParticles; }
+
+    // Size of all buffers
+    u64 getMemoryUsage() const { return m_memory.get(); }
+
+    // Runs the resource through both the CPU and GPU paths and compares the results.
+    // Requires a current GL 4.5 context.
+    static GPUValidationReport validate(const SPLResource& resource, std::span<const SPLTexture> textures, u32 frames, f32 deltaTime);
+
+private:
+    struct Slot {
+        std::shared_ptr<SPLEmitter> emitter;
+        f32 drainTime; // Time left until all particles of a finished emitter are dead
+        f32 randomTimer; // Time since the random behavior was last applied
+        bool updated; // Whether the emitter was updated since the last simulation step
+        bool finished;
+    };
+
+    s32 acquireSlot(const std::shared_ptr<SPLEmitter>& emitter);
+    void uploadEmitter(u32 slot, f32 deltaTime);
+    u32 createProgram(const char* source) const;
+
+private:
+    u32 m_maxParticles;
+    u32 m_frame = 0;
+
+    u32 m_particleBuffer;
+    u32 m_emitterBuffer;
+    u32 m_freeListBuffer;
+    u32 m_counterBuffer;
+    u32 m_childRequestBuffer;
+    u32 m_instanceBuffer;
+    u32 m_commandBuffer;
+    u32 m_emissionBuffer;
+
+    u32 m_emitProgram;
+    u32 m_updateProgram;
+    u32 m_emitChildrenProgram;
+    u32 m_countProgram;
+    u32 m_prefixProgram;
+    u32 m_scatterProgram;
+    memory::TrackedSize m_memory = memory::TrackedSize(memory::Category::GLBuffers);
+
+    std::array<Slot, MAX_EMITTERS> m_slots;
+    std::vector<std::array<u32, 4>> m_emissionRequests;
+};
@@ -1,13 +1,21 @@
 #include "particle_renderer.h"
 #include "gl_util.h"
+#include "ds_budget.h"
+#include "gl_program_cache.h"
 
 #include <algorithm>
+#include <bit>
 #include <gl/glew.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <numeric>
 #include <ranges>
 #include <spdlog/spdlog.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NITROEFX_SSE2
+#endif
+
 namespace {
 
 constexpr f32 s_quadVertices[12] = {
@@ -63,109 +71,287 @@ void main() {
 }
 )";
 
+// Weighted blended order independent transparency (McGuire & Bavoil 2013)
+// Writes into the accumulation (additive) and revealage (multiplicative) targets of GLViewport
+constexpr auto s_oitFragmentShader = R"(
+#version 450 core
+
+layout(location = 0) out vec4 accum;
+layout(location = 1) out float revealage;
+
+in vec4 fragColor;
+in vec2 texCoord;
+
+uniform sampler2D tex;
+
+void main() {
+    vec4 color = fragColor * texture(tex, texCoord);
+    if (color.a < 0.1) {
+        discard;
+    }
+
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    accum = vec4(color.rgb * color.a, color.a) * weight;
+    revealage = color.a;
 }
+)";
 
-ParticleRenderer::ParticleRenderer(u32 maxInstances, std::span<const SPLTexture> textures)
-    : m_maxInstances(maxInstances), m_textures(textures), m_view(1.0f), m_proj(1.0f) {
+// Every fragment that survives the alpha test adds 1 to the overdraw target of GLViewport
+constexpr auto s_overdrawFragmentShader = R"(
+#version 450 core
 
-    for (u32 i = 0; i < textures.size(); i++) {
-        m_particles.emplace_back();
-        m_particles.back().reserve(maxInstances / textures.size()); // Rough distribution for fewer reallocations
+layout(location = 0) out float overdraw;
+
+in vec4 fragColor;
+in vec2 texCoord;
+
+uniform sampler2D tex;
+
+void main() {
+    vec4 color = fragColor * texture(tex, texCoord);
+    if (color.a < 0.1) {
+        discard;
+    }
+
+    overdraw = 1.0;
+}
+)";
+
+// Sort keys are laid out as [view depth:32][texture:8][instance index:24]
+constexpr u32 s_keyIndexBits = 24;
+constexpr u32 s_keyIndexMask = (1u << s_keyIndexBits) - 1;
+
+// Maps a float to a u32 that sorts in the same order
+u32 toSortable(f32 value) {
+    const u32 bits = std::bit_cast<u32>(value);
+    return bits ^ ((u32)((s32)bits >> 31) | 0x80000000u);
+}
+
+// Builds back-to-front sort keys. View space looks down -Z, so ascending depth is farthest first
+void buildDepthKeys(std::span<const ParticleInstance> instances, std::span<const u32> textures, const glm::mat4& view, u64* keys) {
+    const auto makeKey = [&](u32 depth, size_t i) {
+        return (u64)depth << 32 | (u64)(textures[i] & 0xFF) << s_keyIndexBits | (u64)i;
+    };
+
+    size_t i = 0;
+
+#ifdef NITROEFX_SSE2
+    const __m128 m02 = _mm_set1_ps(view[0][2]);
+    const __m128 m12 = _mm_set1_ps(view[1][2]);
+    const __m128 m22 = _mm_set1_ps(view[2][2]);
+    const __m128 m32 = _mm_set1_ps(view[3][2]);
+    const __m128i signBit = _mm_set1_epi32((s32)0x80000000);
+
+    alignas(16) u32 depths[4];
+    for (; i + 4 <= instances.size(); i += 4) {
+        const auto& t0 = instances[i + 0].transform[3];
+        const auto& t1 = instances[i + 1].transform[3];
+        const auto& t2 = instances[i + 2].transform[3];
+        const auto& t3 = instances[i + 3].transform[3];
+
+        const __m128 x = _mm_set_ps(t3.x, t2.x, t1.x, t0.x);
+        const __m128 y = _mm_set_ps(t3.y, t2.y, t1.y, t0.y);
+        const __m128 z = _mm_set_ps(t3.z, t2.z, t1.z, t0.z);
+
+        const __m128 depth = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)),
+            _mm_add_ps(_mm_mul_ps(m22, z), m32)
+        );
+
+        const __m128i bits = _mm_castps_si128(depth);
+        const __m128i mask = _mm_or_si128(_mm_srai_epi32(bits, 31), signBit);
+        _mm_store_si128((__m128i*)depths, _mm_xor_si128(bits, mask));
+
+        keys[i + 0] = makeKey(depths[0], i + 0);
+        keys[i + 1] = makeKey(depths[1], i + 1);
+        keys[i + 2] = makeKey(depths[2], i + 2);
+        keys[i + 3] = makeKey(depths[3], i + 3);
     }
+#endif
 
+    for (; i < instances.size(); i++) {
+        const auto& t = instances[i].transform[3];
+        const f32 depth = view[0][2] * t.x + view[1][2] * t.y + view[2][2] * t.z + view[3][2];
+        keys[i] = makeKey(toSortable(depth), i);
+    }
+}
+
+// LSD radix sort over the depth and texture bytes. The index bytes are already
+// in order, and bytes that are identical across all keys are skipped.
+void radixSort(std::vector<u64>& keys, std::vector<u64>& scratch) {
+    constexpr u32 firstByte = s_keyIndexBits / 8;
+    constexpr u32 passes = 8 - firstByte;
+
+    u32 counts[passes][256] = {};
+    for (const u64 key : keys) {
+        for (u32 pass = 0; pass < passes; pass++) {
+            ++counts[pass][(key >> ((firstByte + pass) * 8)) & 0xFF];
+        }
+    }
+
+    scratch.resize(keys.size());
+    for (u32 pass = 0; pass < passes; pass++) {
+        const u32 shift = (firstByte + pass) * 8;
+        auto& count = counts[pass];
+        if (count[(keys[0] >> shift) & 0xFF] == keys.size()) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32& c : count) {
+            const u32 n = c;
+            c = offset;
+            offset += n;
+        }
+
+        for (const u64 key : keys) {
+            scratch[count[(key >> shift) & 0xFF]++] = key;
+        }
+
+        keys.swap(scratch);
+    }
+}
+
+}
+
+struct ParticleRenderer::SharedResources {
+    u32 vao = 0;
+    u32 vbo = 0;
+    u32 ibo = 0;
+    u32 instanceBuffer = 0;
+    u32 instanceCapacity = 0;
+    Shader shader{};
+    Shader oitShader{};
+    Shader overdrawShader{};
+    memory::TrackedSize trackedMemory = memory::TrackedSize(memory::Category::GLBuffers);
+
+    SharedResources();
+    ~SharedResources();
+
+    SharedResources(const SharedResources&) = delete;
+    SharedResources& operator=(const SharedResources&) = delete;
+
+    void reserve(u32 instances);
+};
+
+ParticleRenderer::SharedResources::SharedResources() {
     // Create VAO
-    glCall(glGenVertexArrays(1, &m_vao));
-    glCall(glBindVertexArray(m_vao));
+    // Vertex data and instance data live in separate binding points so that
+    // the instance stream can be swapped out (see renderIndirect)
+    glCall(glGenVertexArrays(1, &vao));
+    glCall(glBindVertexArray(vao));
 
-    glCall(glGenBuffers(1, &m_vbo));
-    glCall(glBindBuffer(GL_ARRAY_BUFFER, m_vbo));
+    glCall(glGenBuffers(1, &vbo));
+    glCall(glBindBuffer(GL_ARRAY_BUFFER, vbo));
     glCall(glBufferData(GL_ARRAY_BUFFER, sizeof(s_quadVertices), s_quadVertices, GL_STATIC_DRAW));
 
+    glCall(glBindVertexBuffer(0, vbo, 0, 3 * sizeof(f32)));
     glCall(glEnableVertexAttribArray(0));
-    glCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(f32), nullptr));
+    glCall(glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0));
+    glCall(glVertexAttribBinding(0, 0));
 
-    glCall(glGenBuffers(1, &m_ibo));
-    glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo));
+    glCall(glGenBuffers(1, &ibo));
+    glCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
     glCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(s_quadIndices), s_quadIndices, GL_STATIC_DRAW));
 
-    glCall(glGenBuffers(1, &m_transformVbo));
-    glCall(glBindBuffer(GL_ARRAY_BUFFER, m_transformVbo));
-    glCall(glBufferData(GL_ARRAY_BUFFER, m_maxInstances * sizeof(ParticleInstance), nullptr, GL_DYNAMIC_DRAW));
+    // Storage is allocated by reserve()
+    glCall(glGenBuffers(1, &instanceBuffer));
+    glCall(glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer));
+
+    glCall(glBindVertexBuffer(1, instanceBuffer, 0, sizeof(ParticleInstance)));
+    glCall(glVertexBindingDivisor(1, 1));
 
     // Color
     glCall(glEnableVertexAttribArray(1));
-    glCall(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), nullptr));
-    glCall(glVertexAttribDivisor(1, 1));
+    glCall(glVertexAttribFormat(1, 4, GL_FLOAT, GL_FALSE, offsetof(ParticleInstance, color)));
+    glCall(glVertexAttribBinding(1, 1));
 
     // Transform
     for (u32 i = 0; i < 4; i++) {
-        const size_t offset = offsetof(ParticleInstance, transform) + sizeof(glm::vec4) * i;
+        const u32 offset = offsetof(ParticleInstance, transform) + sizeof(glm::vec4) * i;
         glCall(glEnableVertexAttribArray(2 + i));
-        glCall(glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offset));
-        glCall(glVertexAttribDivisor(2 + i, 1));
+        glCall(glVertexAttribFormat(2 + i, 4, GL_FLOAT, GL_FALSE, offset));
+        glCall(glVertexAttribBinding(2 + i, 1));
     }
 
     // Tex Coords
     for (u32 i = 0; i < 4; i++) {
-        const size_t offset = offsetof(ParticleInstance, texCoords) + sizeof(glm::vec2) * i;
+        const u32 offset = offsetof(ParticleInstance, texCoords) + sizeof(glm::vec2) * i;
         glCall(glEnableVertexAttribArray(6 + i));
-        glCall(glVertexAttribPointer(6 + i, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offset));
-        glCall(glVertexAttribDivisor(6 + i, 1));
+        glCall(glVertexAttribFormat(6 + i, 2, GL_FLOAT, GL_FALSE, offset));
+        glCall(glVertexAttribBinding(6 + i, 1));
     }
 
     glCall(glBindVertexArray(0));
 
     // Create Shaders
-    const u32 vs = glCreateShader(GL_VERTEX_SHADER);
-    glCall(glShaderSource(vs, 1, &s_vertexShader, nullptr));
-    glCall(glCompileShader(vs));
-
-    const u32 fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glCall(glShaderSource(fs, 1, &s_fragmentShader, nullptr));
-    glCall(glCompileShader(fs));
-
-    s32 success;
-    char info[512];
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vs, sizeof(info), nullptr, info);
-        spdlog::error("Failed to compile vertex shader: {}", info);
-        return;
-    }
+    shader = createShader(s_fragmentShader);
+    oitShader = createShader(s_oitFragmentShader);
+    overdrawShader = createShader(s_overdrawFragmentShader);
+}
 
-    glCall(glGetShaderiv(fs, GL_COMPILE_STATUS, &success));
-    if (!success) {
-        glCall(glGetShaderInfoLog(fs, sizeof(info), nullptr, info));
-        spdlog::error("Failed to compile fragment shader: {}", info);
+ParticleRenderer::SharedResources::~SharedResources() {
+    glCall(glDeleteProgram(shader.program));
+    glCall(glDeleteProgram(oitShader.program));
+    glCall(glDeleteProgram(overdrawShader.program));
+    glCall(glDeleteBuffers(1, &instanceBuffer));
+    glCall(glDeleteBuffers(1, &ibo));
+    glCall(glDeleteBuffers(1, &vbo));
+    glCall(glDeleteVertexArrays(1, &vao));
+}
+
+void ParticleRenderer::SharedResources::reserve(u32 instances) {
+    if (instances <= instanceCapacity) {
         return;
     }
 
-    m_shader = glCreateProgram();
-    if (m_shader == 0) {
-        spdlog::error("Failed to create shader program: {}", glGetError());
-        return;
+    // The vertex array refers to the buffer by name, so it keeps working with the new storage
+    glCall(glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer));
+    glCall(glBufferData(GL_ARRAY_BUFFER, instances * sizeof(ParticleInstance), nullptr, GL_DYNAMIC_DRAW));
+    glCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    instanceCapacity = instances;
+    trackedMemory.set(sizeof(s_quadVertices) + sizeof(s_quadIndices) + (u64)instances * sizeof(ParticleInstance));
+}
+
+ParticleRenderer::ParticleRenderer(u32 maxInstances, std::span<const SPLTexture> textures, bool headless)
+    : m_maxInstances(maxInstances)
+    , m_headless(headless)
+    , m_shared(headless ? nullptr : acquireSharedResources(maxInstances))
+    , m_textures(textures)
+    , m_view(1.0f)
+    , m_proj(1.0f) {
+
+    for (u32 i = 0; i < textures.size(); i++) {
+        m_particles.emplace_back();
+        m_particles.back().reserve(maxInstances / textures.size()); // Rough distribution for fewer reallocations
     }
+}
 
-    glCall(glAttachShader(m_shader, vs));
-    glCall(glAttachShader(m_shader, fs));
-    glCall(glLinkProgram(m_shader));
+ParticleRenderer::~ParticleRenderer() {
+    releaseCountReadback();
+}
 
-    glCall(glGetProgramiv(m_shader, GL_LINK_STATUS, &success));
-    if (!success) {
-        glCall(glGetProgramInfoLog(m_shader, sizeof(info), nullptr, info));
-        spdlog::error("Failed to link shader program: {}", info);
-        return;
+void ParticleRenderer::setBudgetTracker(DSBudgetTracker* tracker) {
+    if (!tracker) {
+        releaseCountReadback();
     }
 
-    glCall(glDeleteShader(vs));
-    glCall(glDeleteShader(fs));
+    m_budgetTracker = tracker;
+}
 
-    // Get uniform locations
-    glCall(glUseProgram(m_shader));
-    m_viewLocation = glGetUniformLocation(m_shader, "view");
-    m_projLocation = glGetUniformLocation(m_shader, "proj");
-    m_textureLocation = glGetUniformLocation(m_shader, "tex");
-    glCall(glUseProgram(0));
+void ParticleRenderer::setTextures(std::span<const SPLTexture> textures) {
+    m_textures = textures;
+    m_particles.resize(textures.size());
+}
+
+void ParticleRenderer::getMemoryUsage(memory::Usage& usage) const {
+    auto& bytes = usage[memory::Category::InstanceData];
+    for (const auto& particles : m_particles) {
+        bytes += memory::getSize(particles);
+    }
+
+    bytes += memory::getSize(m_instances);
+    bytes += memory::getSize(m_sortedInstances);
 }
 
 void ParticleRenderer::begin(const glm::mat4& view, const glm::mat4& proj) {
@@ -173,19 +359,33 @@ void ParticleRenderer::begin(const glm::mat4& view, const glm::mat4& proj) {
         particles.clear();
     }
 
+    m_instances.clear();
+    m_instanceTextures.clear();
+
     m_particleCount = 0;
     m_view = view;
     m_proj = proj;
+
+    if (m_budgetTracker) {
+        m_budgetTracker->beginFrame(view, proj);
+    }
 }
 
 void ParticleRenderer::end() {
+    if (m_budgetTracker) {
+        m_budgetTracker->endFrame(m_textures);
+    }
 
-    glCall(glUseProgram(m_shader));
-    glCall(glActiveTexture(GL_TEXTURE0));
-    glCall(glUniformMatrix4fv(m_viewLocation, 1, GL_FALSE, glm::value_ptr(m_view)));
-    glCall(glUniformMatrix4fv(m_projLocation, 1, GL_FALSE, glm::value_ptr(m_proj)));
-    glCall(glUniform1i(m_textureLocation, 0));
-    glCall(glBindVertexArray(m_vao));
+    if (m_headless) {
+        return;
+    }
+
+    if (m_renderMode == ParticleRenderMode::DepthSorted) {
+        renderSorted();
+        return;
+    }
+
+    bindShader();
 
     for (u32 i = 0; i < m_particles.size(); i++) {
         if (m_particles[i].empty()) {
@@ -193,13 +393,98 @@ void ParticleRenderer::end() {
         }
 
         glCall(glBindTexture(GL_TEXTURE_2D, m_textures[i].glTexture->getHandle()));
-        glCall(glBindBuffer(GL_ARRAY_BUFFER, m_transformVbo));
+        glCall(glBindBuffer(GL_ARRAY_BUFFER, m_shared->instanceBuffer));
         glCall(glBufferSubData(GL_ARRAY_BUFFER, 0, m_particles[i].size() * sizeof(ParticleInstance), m_particles[i].data()));
         glCall(glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (s32)m_particles[i].size()));
     }
 
-    glCall(glBindVertexArray(0));
-    glCall(glUseProgram(0));
+    unbindShader();
+}
+
+void ParticleRenderer::renderIndirect(u32 instanceBuffer, u32 commandBuffer, u32 commandCount) {
+    if (m_budgetTracker) {
+        readBackCounts(commandBuffer, commandCount);
+
+        for (u32 i = 0; i < m_indirectCounts.size(); i++) {
+            m_budgetTracker->addQuads(i, m_indirectCounts[i]);
+        }
+
+        m_budgetTracker->endFrame(m_textures);
+    }
+
+    if (m_headless) {
+        return;
+    }
+
+    bindShader();
+
+    // The command buffer holds one DrawElementsIndirectCommand per texture,
+    // each pointing at its own range of the instance buffer via baseInstance
+    glCall(glBindVertexBuffer(1, instanceBuffer, 0, sizeof(ParticleInstance)));
+    glCall(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer));
+
+    for (u32 i = 0; i < std::min<size_t>(commandCount, m_textures.size()); i++) {
+        const size_t offset = i * sizeof(DrawElementsIndirectCommand);
+        glCall(glBindTexture(GL_TEXTURE_2D, m_textures[i].glTexture->getHandle()));
+        glCall(glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset));
+    }
+
+    glCall(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+    glCall(glBindVertexBuffer(1, m_shared->instanceBuffer, 0, sizeof(ParticleInstance)));
+    unbindShader();
+}
+
+void ParticleRenderer::readBackCounts(u32 commandBuffer, u32 commandCount) {
+    // Picks up the copy made by an earlier frame without waiting, the tracker keeps the previous counts until then
+    if (m_countFence) {
+        const GLenum status = glClientWaitSync((GLsync)m_countFence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            return;
+        }
+
+        glCall(glDeleteSync((GLsync)m_countFence));
+        m_countFence = nullptr;
+
+        m_indirectCounts.resize(m_pendingCount);
+        for (u32 i = 0; i < m_pendingCount; i++) {
+            m_indirectCounts[i] = m_mappedCounts[i].instanceCount;
+        }
+    }
+
+    if (commandCount > m_countCapacity) {
+        releaseCountReadback();
+
+        constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const auto size = (GLsizeiptr)(commandCount * sizeof(DrawElementsIndirectCommand));
+        glCall(glCreateBuffers(1, &m_countBuffer));
+        glCall(glNamedBufferStorage(m_countBuffer, size, nullptr, flags));
+        m_mappedCounts = (const DrawElementsIndirectCommand*)glMapNamedBufferRange(m_countBuffer, 0, size, flags);
+        m_countCapacity = commandCount;
+    }
+
+    // The commands were written by the scatter pass, the copy has to see them
+    glCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    glCall(glCopyNamedBufferSubData(commandBuffer, m_countBuffer, 0, 0, commandCount * sizeof(DrawElementsIndirectCommand)));
+    m_countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_pendingCount = commandCount;
+}
+
+void ParticleRenderer::releaseCountReadback() {
+    if (m_countFence) {
+        glCall(glDeleteSync((GLsync)m_countFence));
+        m_countFence = nullptr;
+    }
+
+    if (m_countBuffer) {
+        glCall(glUnmapNamedBuffer(m_countBuffer));
+        glCall(glDeleteBuffers(1, &m_countBuffer));
+        m_countBuffer = 0;
+    }
+
+    m_mappedCounts = nullptr;
+    m_countCapacity = 0;
+    m_pendingCount = 0;
+    m_indirectCounts.clear();
 }
 
 void ParticleRenderer::submit(u32 texture, const ParticleInstance& instance) {
@@ -212,6 +497,175 @@ void ParticleRenderer::submit(u32 texture, const ParticleInstance& instance) {
         texture = 0;
     }
 
-    m_particles[texture].push_back(instance);
+    if (m_budgetTracker) {
+        m_budgetTracker->addQuad(texture, instance.transform);
+    }
+
+    if (m_renderMode == ParticleRenderMode::DepthSorted) {
+        m_instances.push_back(instance);
+        m_instanceTextures.push_back(texture);
+    } else {
+        m_particles[texture].push_back(instance);
+    }
+
     ++m_particleCount;
 }
+
+void ParticleRenderer::renderSorted() {
+    if (m_instances.empty()) {
+        return;
+    }
+
+    m_sortKeys.resize(m_instances.size());
+    buildDepthKeys(m_instances, m_instanceTextures, m_view, m_sortKeys.data());
+    radixSort(m_sortKeys, m_sortScratch);
+
+    m_sortedInstances.resize(m_instances.size());
+    for (size_t i = 0; i < m_sortKeys.size(); i++) {
+        m_sortedInstances[i] = m_instances[m_sortKeys[i] & s_keyIndexMask];
+    }
+
+    bindShader();
+
+    // Upload everything at once, then draw each run of same-texture instances
+    glCall(glBindBuffer(GL_ARRAY_BUFFER, m_shared->instanceBuffer));
+    glCall(glBufferSubData(GL_ARRAY_BUFFER, 0, m_sortedInstances.size() * sizeof(ParticleInstance), m_sortedInstances.data()));
+
+    size_t runStart = 0;
+    while (runStart < m_sortKeys.size()) {
+        const u32 texture = m_instanceTextures[m_sortKeys[runStart] & s_keyIndexMask];
+
+        size_t runEnd = runStart + 1;
+        while (runEnd < m_sortKeys.size() && m_instanceTextures[m_sortKeys[runEnd] & s_keyIndexMask] == texture) {
+            ++runEnd;
+        }
+
+        glCall(glBindTexture(GL_TEXTURE_2D, m_textures[texture].glTexture->getHandle()));
+        glCall(glDrawElementsInstancedBaseInstance(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (s32)(runEnd - runStart), (u32)runStart));
+
+        runStart = runEnd;
+    }
+
+    unbindShader();
+}
+
+void ParticleRenderer::bindShader() const {
+    const Shader* shader = &m_shared->shader;
+    switch (m_renderMode) {
+    case ParticleRenderMode::WeightedOIT: shader = &m_shared->oitShader; break;
+    case ParticleRenderMode::Overdraw: shader = &m_shared->overdrawShader; break;
+    default: break;
+    }
+
+    glCall(glUseProgram(shader->program));
+    glCall(glActiveTexture(GL_TEXTURE0));
+    glCall(glUniformMatrix4fv(shader->viewLocation, 1, GL_FALSE, glm::value_ptr(m_view)));
+    glCall(glUniformMatrix4fv(shader->projLocation, 1, GL_FALSE, glm::value_ptr(m_proj)));
+    glCall(glUniform1i(shader->textureLocation, 0));
+    glCall(glBindVertexArray(m_shared->vao));
+
+    if (m_renderMode == ParticleRenderMode::WeightedOIT) {
+        // Accumulation is additive, revealage is multiplied by (1 - alpha).
+        // Depth writes are disabled so particles never occlude each other.
+        glCall(glDepthMask(GL_FALSE));
+        glCall(glBlendFunci(0, GL_ONE, GL_ONE));
+        glCall(glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR));
+    } else if (m_renderMode == ParticleRenderMode::Overdraw) {
+        // Count every layer, including the ones that would normally fail the depth test
+        glCall(glDisable(GL_DEPTH_TEST));
+        glCall(glDepthMask(GL_FALSE));
+        glCall(glBlendFunc(GL_ONE, GL_ONE));
+    }
+}
+
+void ParticleRenderer::unbindShader() const {
+    if (m_renderMode == ParticleRenderMode::WeightedOIT || m_renderMode == ParticleRenderMode::Overdraw) {
+        glCall(glEnable(GL_DEPTH_TEST));
+        glCall(glDepthMask(GL_TRUE));
+        glCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    }
+
+    glCall(glBindVertexArray(0));
+    glCall(glUseProgram(0));
+}
+
+std::shared_ptr<ParticleRenderer::SharedResources> ParticleRenderer::acquireSharedResources(u32 maxInstances) {
+    // Released with the last renderer, which happens before the GL context goes away
+    static std::weak_ptr<SharedResources> s_shared;
+
+    auto shared = s_shared.lock();
+    if (!shared) {
+        shared = std::make_shared<SharedResources>();
+        s_shared = shared;
+    }
+
+    shared->reserve(maxInstances);
+    return shared;
+}
+
+ParticleRenderer::Shader ParticleRenderer::createShader(const char* fragmentSource) {
+    Shader shader{};
+
+    const u64 key = g_programCache ? g_programCache->makeKey({ s_vertexShader, fragmentSource }) : 0;
+    shader.program = g_programCache ? g_programCache->load(key) : 0;
+
+    if (shader.program == 0) {
+        const u32 vs = glCreateShader(GL_VERTEX_SHADER);
+        glCall(glShaderSource(vs, 1, &s_vertexShader, nullptr));
+        glCall(glCompileShader(vs));
+
+        const u32 fs = glCreateShader(GL_FRAGMENT_SHADER);
+        glCall(glShaderSource(fs, 1, &fragmentSource, nullptr));
+        glCall(glCompileShader(fs));
+
+        s32 success;
+        char info[512];
+        glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(vs, sizeof(info), nullptr, info);
+            spdlog::error("Failed to compile vertex shader: {}", info);
+            return {};
+        }
+
+        glCall(glGetShaderiv(fs, GL_COMPILE_STATUS, &success));
+        if (!success) {
+            glCall(glGetShaderInfoLog(fs, sizeof(info), nullptr, info));
+            spdlog::error("Failed to compile fragment shader: {}", info);
+            return {};
+        }
+
+        shader.program = glCreateProgram();
+        if (shader.program == 0) {
+            spdlog::error("Failed to create shader program: {}", glGetError());
+            return {};
+        }
+
+        glCall(glAttachShader(shader.program, vs));
+        glCall(glAttachShader(shader.program, fs));
+        glCall(glProgramParameteri(shader.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+        glCall(glLinkProgram(shader.program));
+
+        glCall(glGetProgramiv(shader.program, GL_LINK_STATUS, &success));
+        if (!success) {
+            glCall(glGetProgramInfoLog(shader.program, sizeof(info), nullptr, info));
+            spdlog::error("Failed to link shader program: {}", info);
+            return {};
+        }
+
+        glCall(glDeleteShader(vs));
+        glCall(glDeleteShader(fs));
+
+        if (g_programCache) {
+            g_programCache->store(key, shader.program);
+        }
+    }
+
+    // Get uniform locations
+    glCall(glUseProgram(shader.program));
+    shader.viewLocation = glGetUniformLocation(shader.program, "view");
+    shader.projLocation = glGetUniformLocation(shader.program, "proj");
+    shader.textureLocation = glGetUniformLocation(shader.program, "tex");
+    glCall(glUseProgram(0));
+
+    return shader;
+}
@@ -1,14 +1,17 @@
 #pragma once
 
 #include "types.h"
+#include "memory_tracker.h"
 #include "spl/spl_particle.h"
 
+#include <memory>
 #include <span>
 #include <unordered_map>
 #include <vector>
 
 #include "spl/spl_resource.h"
 
+class DSBudgetTracker;
 
 struct ParticleInstance {
     glm::vec4 color;
@@ -16,32 +19,111 @@ struct ParticleInstance {
     glm::vec2 texCoords[4];
 };
 
+// Matches the layout expected by glDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    u32 count;
+    u32 instanceCount;
+    u32 firstIndex;
+    s32 baseVertex;
+    u32 baseInstance;
+};
+
+enum class ParticleRenderMode {
+    Unsorted, // Grouped by texture, fastest but blends incorrectly when particles overlap
+    DepthSorted, // Sorted back to front by view depth
+    WeightedOIT, // Weighted blended OIT, requires the transparency targets of GLViewport to be bound
+    Overdraw, // Counts fragments per pixel, requires the overdraw target of GLViewport to be bound
+};
+
+// The quad geometry, instance buffer and shaders are shared by every renderer (one per open editor),
+// each renderer only owns its textures, matrices and CPU side instance lists.
+// All renderers draw on the main thread, one after the other, so sharing the instance buffer is fine.
 class ParticleRenderer {
 public:
-    explicit ParticleRenderer(u32 maxInstances, std::span<const SPLTexture> textures);
+    // Headless renderers only report to the budget tracker and never draw. They don't touch the
+    // shared GL resources, and the textures don't need GL objects.
+    explicit ParticleRenderer(u32 maxInstances, std::span<const SPLTexture> textures, bool headless = false);
+    ~ParticleRenderer();
+
+    ParticleRenderer(const ParticleRenderer&) = delete;
+    ParticleRenderer& operator=(const ParticleRenderer&) = delete;
 
     void begin(const glm::mat4& view, const glm::mat4& proj);
     void end();
 
     void submit(u32 texture, const ParticleInstance& instance);
 
+    // Draws instances that are already resident on the GPU. commandBuffer must contain
+    // one DrawElementsIndirectCommand per texture, in texture order.
+    void renderIndirect(u32 instanceBuffer, u32 commandBuffer, u32 commandCount);
+
+    bool isHeadless() const { return m_headless; }
+
+    void setRenderMode(ParticleRenderMode mode) { m_renderMode = mode; }
+    ParticleRenderMode getRenderMode() const { return m_renderMode; }
+
+    // Every submitted or indirectly drawn particle is reported to the tracker, if set.
+    // Indirect draw counts are read back asynchronously and reach the tracker a frame or two late.
+    void setBudgetTracker(DSBudgetTracker* tracker);
+    DSBudgetTracker* getBudgetTracker() const { return m_budgetTracker; }
+
     const glm::mat4& getView() const { return m_view; }
+    size_t getTextureCount() const { return m_textures.size(); }
+
+    // For when the texture list was replaced, e.g. by reloading the archive
+    void setTextures(std::span<const SPLTexture> textures);
+
+    // The instance lists of this renderer, the shared GL objects are tracked on their own
+    void getMemoryUsage(memory::Usage& usage) const;
+
+private:
+    using InstanceList = memory::TrackedVector<ParticleInstance, memory::Category::InstanceData>;
+
+    struct Shader {
+        u32 program;
+        s32 viewLocation;
+        s32 projLocation;
+        s32 textureLocation;
+    };
+
+    struct SharedResources;
+
+    void bindShader() const;
+    void unbindShader() const;
+    void renderSorted();
+    void readBackCounts(u32 commandBuffer, u32 commandCount);
+    void releaseCountReadback();
+    static Shader createShader(const char* fragmentSource);
+    static std::shared_ptr<SharedResources> acquireSharedResources(u32 maxInstances);
 
 private:
     u32 m_maxInstances;
-    u32 m_vao;
-    u32 m_vbo;
-    u32 m_ibo;
-    u32 m_shader;
-    u32 m_transformVbo;
+    bool m_headless;
+    std::shared_ptr<SharedResources> m_shared; // Null for headless renderers
 
     std::span<const SPLTexture> m_textures;
     glm::mat4 m_view;
     glm::mat4 m_proj;
-    s32 m_viewLocation;
-    s32 m_projLocation;
-    s32 m_textureLocation;
+
+    DSBudgetTracker* m_budgetTracker = nullptr;
+
+    // Copy of the indirect commands for the budget tracker, persistently mapped and guarded by a fence
+    u32 m_countBuffer = 0;
+    u32 m_countCapacity = 0; // Commands
+    u32 m_pendingCount = 0; // Commands in the copy the fence guards
+    const DrawElementsIndirectCommand* m_mappedCounts = nullptr;
+    void* m_countFence = nullptr; // GLsync
+    std::vector<u32> m_indirectCounts; // Latest counts that arrived, by texture
 
     size_t m_particleCount = 0;
-    std::vector<std::vector<ParticleInstance>> m_particles;
+    std::vector<InstanceList> m_particles;
+
+    ParticleRenderMode m_renderMode = ParticleRenderMode::Unsorted;
+
+    // Only used in DepthSorted mode
+    InstanceList m_instances;
+    std::vector<u32> m_instanceTextures;
+    InstanceList m_sortedInstances;
+    std::vector<u64> m_sortKeys;
+    std::vector<u64> m_sortScratch;
 };
@@ -1,13 +1,11 @@
 #include "particle_system.h"
 
 
-ParticleSystem::ParticleSystem(u32 maxParticles, std::span<const SPLTexture> textures)
-    : m_renderer(maxParticles, textures) {
+ParticleSystem::ParticleSystem(u32 maxParticles, std::span<const SPLTexture> textures, bool headless)
+    : m_maxParticles(maxParticles), m_renderer(maxParticles, textures, headless) {
     m_particles = new SPLParticle[maxParticles];
-
-    for (u32 i = 0; i < maxParticles; i++) {
-        m_availableParticles.push(&m_particles[i]);
-    }
+    m_poolMemory.set((u64)maxParticles * sizeof(SPLParticle));
+    resetPool();
 }
 
 ParticleSystem::~ParticleSystem() {
@@ -15,7 +13,8 @@ ParticleSystem::~ParticleSystem() {
 }
 
 void ParticleSystem::update(float deltaTime) {
-    
+    restoreGPUResources();
+
     for (auto it = m_emitters.begin(); it != m_emitters.end();) {
         const auto& emitter = *it;
         const auto& header = emitter->m_resource->header;
@@ -25,25 +24,44 @@ void ParticleSystem::update(float deltaTime) {
             emitter->m_age = 0;
         }
 
+        bool alive = true;
         if (!emitter->m_state.paused) {
             if (emitter->m_updateCycle == 0 || (u8)m_cycle == emitter->m_updateCycle - 1) {
-                emitter->update(deltaTime);
+                if (m_backend == SimulationBackend::GPU) {
+                    alive = m_gpuSimulator->updateEmitter(emitter, deltaTime);
+                } else {
+                    emitter->update(deltaTime);
+                }
             }
         }
 
-        if (emitter->shouldTerminate()) {
+        if (m_backend == SimulationBackend::CPU) {
+            alive = !emitter->shouldTerminate();
+        }
+
+        if (!alive) {
             it = m_emitters.erase(it);
         } else {
             ++it;
         }
     }
 
+    if (m_backend == SimulationBackend::GPU) {
+        m_gpuSimulator->simulate(deltaTime);
+    }
+
     m_cycle = !m_cycle;
 }
 
 void ParticleSystem::render(const glm::mat4& view, const glm::mat4& proj, const glm::vec3& cameraPos) {
+    restoreGPUResources();
     m_renderer.begin(view, proj);
 
+    if (m_backend == SimulationBackend::GPU) {
+        m_gpuSimulator->render(m_renderer);
+        return;
+    }
+
     for (auto& emitter : m_emitters) {
         if (!emitter->m_state.renderingDisabled) {
             emitter->render(cameraPos);
@@ -70,6 +88,57 @@ void ParticleSystem::killAllEmitters() const {
     }
 }
 
+void ParticleSystem::reattachEmitters(std::span<const SPLResource> previous, std::span<const SPLResource> current, size_t textureCount) {
+    bool removed = false;
+
+    // The renderer would otherwise warn about every one of these particles, every frame
+    const auto remapTextures = [textureCount](std::span<SPLParticle* const> particles, u8 fallback) {
+        for (const auto particle : particles) {
+            if (particle->texture >= textureCount) {
+                particle->texture = fallback;
+            }
+        }
+    };
+
+    for (auto it = m_emitters.begin(); it != m_emitters.end();) {
+        const auto& emitter = *it;
+        const auto resource = emitter->m_resource;
+
+        const bool inPrevious = resource >= previous.data() && resource < previous.data() + previous.size();
+        const size_t index = inPrevious ? (size_t)(resource - previous.data()) : current.size();
+        if (index < current.size()) {
+            const auto& misc = current[index].header.misc;
+            const u8 texture = misc.textureIndex < textureCount ? misc.textureIndex : 0;
+            const u8 childTexture = current[index].childResource && current[index].childResource->misc.texture < textureCount
+                ? current[index].childResource->misc.texture
+                : texture;
+
+            emitter->setResource(&current[index]);
+            remapTextures(emitter->m_particles, texture);
+            remapTextures(emitter->m_childParticles, childTexture);
+            ++it;
+            continue;
+        }
+
+        for (const auto particle : emitter->m_particles) {
+            freeParticle(particle);
+        }
+
+        for (const auto particle : emitter->m_childParticles) {
+            freeParticle(particle);
+        }
+
+        it = m_emitters.erase(it);
+        removed = true;
+    }
+
+    // The slots of removed emitters would keep their particles frozen on screen,
+    // the remaining emitters pick up new slots on their next update
+    if (removed && m_gpuSimulator) {
+        m_gpuSimulator->reset();
+    }
+}
+
 SPLParticle* ParticleSystem::allocateParticle() {
     if (m_availableParticles.empty()) {
         return nullptr;
@@ -84,3 +153,52 @@ SPLParticle* ParticleSystem::allocateParticle() {
 void ParticleSystem::freeParticle(SPLParticle* particle) {
     m_availableParticles.push(particle);
 }
+
+void ParticleSystem::setBackend(SimulationBackend backend) {
+    if (backend == m_backend) {
+        return;
+    }
+
+    // Particles can't be moved between backends, so start from a clean slate
+    m_emitters.clear();
+    resetPool();
+
+    m_backend = backend;
+    if (backend == SimulationBackend::GPU) {
+        m_gpuSimulator = std::make_unique<GPUParticleSimulator>(GPU_MAX_PARTICLES);
+    } else {
+        m_gpuSimulator.reset();
+    }
+}
+
+void ParticleSystem::releaseGPUResources() {
+    if (!m_gpuSimulator) {
+        return;
+    }
+
+    // The particles only exist on the GPU, so their emitters can't continue either
+    m_emitters.clear();
+    m_gpuSimulator.reset();
+}
+
+void ParticleSystem::getMemoryUsage(memory::Usage& usage) const {
+    usage[memory::Category::ParticlePool] += m_poolMemory.get();
+    m_renderer.getMemoryUsage(usage);
+
+    if (m_gpuSimulator) {
+        usage[memory::Category::GLBuffers] += m_gpuSimulator->getMemoryUsage();
+    }
+}
+
+void ParticleSystem::restoreGPUResources() {
+    if (m_backend == SimulationBackend::GPU && !m_gpuSimulator) {
+        m_gpuSimulator = std::make_unique<GPUParticleSimulator>(GPU_MAX_PARTICLES);
+    }
+}
+
+void ParticleSystem::resetPool() {
+    m_availableParticles = {};
+    for (u32 i = 0; i < m_maxParticles; i++) {
+        m_availableParticles.push(&m_particles[i]);
+    }
+}
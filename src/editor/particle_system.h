@@ -3,13 +3,21 @@
 #include "spl/spl_particle.h"
 #include "spl/spl_emitter.h"
 #include "particle_renderer.h"
+#include "gpu_particle_simulator.h"
+#include "memory_tracker.h"
 
+#include <memory>
 #include <queue>
 #include <vector>
 
+enum class SimulationBackend {
+    CPU,
+    GPU
+};
+
 class ParticleSystem {
 public:
-    explicit ParticleSystem(u32 maxParticles, std::span<const SPLTexture> textures);
+    explicit ParticleSystem(u32 maxParticles, std::span<const SPLTexture> textures, bool headless = false);
     ~ParticleSystem();
 
     void update(float deltaTime);
@@ -19,16 +27,47 @@ public:
     void killEmitter(const std::weak_ptr<SPLEmitter>& emitter) const;
     void killAllEmitters() const;
 
+    // Moves the emitters from one resource list to another, matched by index, e.g. after the archive
+    // was reloaded. Emitters whose resource doesn't exist anymore are removed along with their particles,
+    // particles of the remaining ones that use a texture past textureCount switch to their resource's texture.
+    void reattachEmitters(std::span<const SPLResource> previous, std::span<const SPLResource> current, size_t textureCount);
+
     SPLParticle* allocateParticle();
     void freeParticle(SPLParticle* particle);
 
     ParticleRenderer* getRenderer() { return &m_renderer; }
 
+    // Live CPU particles, children included
+    size_t getParticleCount() const { return m_maxParticles - m_availableParticles.size(); }
+    size_t getEmitterCount() const { return m_emitters.size(); }
+    u32 getMaxParticles() const { return m_maxParticles; }
+
+    // Switching backends kills all emitters
+    void setBackend(SimulationBackend backend);
+    SimulationBackend getBackend() const { return m_backend; }
+    GPUParticleSimulator* getGPUSimulator() { return m_gpuSimulator.get(); }
+
+    // Deletes the GPU simulator, which kills its emitters. It is created again on the next update or render.
+    void releaseGPUResources();
+
+    // Particle pool, instance lists and GPU simulator buffers
+    void getMemoryUsage(memory::Usage& usage) const;
+
 private:
+    void restoreGPUResources();
+    void resetPool();
+
+private:
+    static constexpr u32 GPU_MAX_PARTICLES = 1 << 16;
+
+    u32 m_maxParticles;
     ParticleRenderer m_renderer;
+    SimulationBackend m_backend = SimulationBackend::CPU;
+    std::unique_ptr<GPUParticleSimulator> m_gpuSimulator;
     std::queue<SPLParticle*> m_availableParticles;
     std::vector<std::shared_ptr<SPLEmitter>> m_emitters;
     bool m_cycle =false;
 
     SPLParticle* m_particles;
+    memory::TrackedSize m_poolMemory = memory::TrackedSize(memory::Category::ParticlePool);
 };
@@ -0,0 +1,366 @@
+#include "project_indexer.h"
+#include "spl/spl_container_scanner.h"
+
+#include <spdlog/spdlog.h>
+#include <unordered_set>
+
+
+namespace {
+
+s64 getLastWrite(const std::filesystem::path& file) {
+    std::error_code ec;
+    return std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+}
+
+bool isSplFile(const std::filesystem::path& file) {
+    return file.extension() == ".spa";
+}
+
+bool isIndexedFile(const std::filesystem::path& file) {
+    return isSplFile(file) || SPLContainerScanner::isContainer(file);
+}
+
+}
+
+
+ProjectIndexer::ProjectIndexer() {
+    m_worker = std::jthread([this](std::stop_token stop) { workerMain(stop); });
+}
+
+ProjectIndexer::~ProjectIndexer() {
+    close();
+    m_worker.request_stop();
+    m_worker.join();
+}
+
+void ProjectIndexer::open(const std::filesystem::path& root) {
+    close();
+
+    m_root = root;
+    m_lastSave = std::chrono::steady_clock::now();
+    submit({ .type = Job::Type::Open, .root = root, .path = {}, .catalog = {}, .generation = m_generation });
+}
+
+void ProjectIndexer::close() {
+    if (m_root.empty()) {
+        return;
+    }
+
+    bool unsaved;
+    {
+        std::scoped_lock lock(m_mutex);
+
+        // Pending saves only hold older snapshots of m_catalog, so saving it here covers them.
+        // Read before bumping the generation, which makes a save the worker already took drop its snapshot.
+        unsaved = m_dirty || m_pendingSaves > 0;
+
+        m_pendingSaves -= std::erase_if(m_jobs, [](const Job& job) { return job.type == Job::Type::Save; });
+        m_jobs.clear();
+        m_results.clear();
+
+        // Also stops a running walk
+        ++m_generation;
+    }
+
+    if (unsaved) {
+        save(m_root, m_catalog);
+    }
+
+    m_root.clear();
+    m_catalog.clear();
+    m_dirty = false;
+    ++m_version;
+    m_outstanding = 0;
+}
+
+void ProjectIndexer::invalidate(const std::filesystem::path& file) {
+    if (m_root.empty() || !isIndexedFile(file)) {
+        return;
+    }
+
+    submit({ .type = Job::Type::File, .root = m_root, .path = file, .catalog = {}, .generation = m_generation });
+}
+
+void ProjectIndexer::update() {
+    if (m_root.empty()) {
+        return;
+    }
+
+    std::vector<Result> results;
+    {
+        std::scoped_lock lock(m_mutex);
+        results = std::move(m_results);
+        m_results.clear();
+    }
+
+    for (auto& result : results) {
+        if (result.generation != m_generation) {
+            continue;
+        }
+
+        if (result.catalog) {
+            m_catalog = std::move(*result.catalog);
+        }
+
+        if (!result.replaced.empty()) {
+            m_catalog.erasePrefix(result.replaced);
+        }
+
+        for (const auto& key : result.removed) {
+            m_catalog.erase(key);
+        }
+
+        for (auto& entry : result.indexed) {
+            m_catalog.insert(std::move(entry));
+        }
+
+        const bool changed = !result.indexed.empty() || !result.removed.empty() || !result.replaced.empty();
+        m_dirty |= changed;
+        m_version += changed || result.catalog;
+        if (result.done) {
+            --m_outstanding;
+        }
+    }
+
+    // Batch up changes instead of rewriting the catalog for every saved file
+    const auto now = std::chrono::steady_clock::now();
+    if (m_dirty && m_outstanding == 0 && now - m_lastSave >= SAVE_INTERVAL) {
+        submit({ .type = Job::Type::Save, .root = m_root, .path = {}, .catalog = m_catalog, .generation = m_generation });
+        m_dirty = false;
+        m_lastSave = now;
+    }
+}
+
+const SPLCatalogEntry* ProjectIndexer::find(const std::filesystem::path& file) const {
+    return m_root.empty() ? nullptr : m_catalog.find(getKey(m_root, file));
+}
+
+std::string ProjectIndexer::getKey(const std::filesystem::path& root, const std::filesystem::path& file) {
+    return file.lexically_relative(root).generic_string();
+}
+
+std::optional<SPLCatalogEntry> ProjectIndexer::indexFile(const std::filesystem::path& root, const std::filesystem::path& file) {
+    auto entry = SPLCatalog::index(file);
+    if (!entry) {
+        return std::nullopt;
+    }
+
+    entry->path = getKey(root, file);
+    entry->lastWrite = getLastWrite(file);
+
+    return entry;
+}
+
+std::optional<std::vector<SPLCatalogEntry>> ProjectIndexer::indexContainer(const std::filesystem::path& root, const std::filesystem::path& file, std::stop_token stop) {
+    auto entries = SPLContainerScanner::scan(file, stop);
+    if (!entries) {
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    const auto key = getKey(root, file);
+    const u64 fileSize = std::filesystem::file_size(file, ec);
+    const s64 lastWrite = getLastWrite(file);
+
+    for (auto& entry : *entries) {
+        entry.path = key + '/' + entry.path;
+        entry.fileSize = fileSize;
+        entry.lastWrite = lastWrite;
+    }
+
+    SPLCatalogEntry container{};
+    container.path = key;
+    container.fileSize = fileSize;
+    container.lastWrite = lastWrite;
+    entries->push_back(std::move(container));
+
+    return entries;
+}
+
+void ProjectIndexer::submit(Job job) {
+    if (job.type != Job::Type::Save) {
+        ++m_outstanding;
+    } else {
+        ++m_pendingSaves;
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+
+    m_condition.notify_one();
+}
+
+void ProjectIndexer::post(Result result) {
+    std::scoped_lock lock(m_mutex);
+    m_results.push_back(std::move(result));
+}
+
+void ProjectIndexer::save(const std::filesystem::path& root, const SPLCatalog& catalog) {
+    std::scoped_lock lock(m_saveMutex);
+    catalog.save(getCatalogPath(root));
+}
+
+void ProjectIndexer::workerMain(std::stop_token stop) {
+    while (true) {
+        Job job;
+
+        {
+            std::unique_lock lock(m_mutex);
+            if (!m_condition.wait(lock, stop, [this] { return !m_jobs.empty(); })) {
+                return;
+            }
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        switch (job.type) {
+        case Job::Type::Open:
+            runOpen(job, stop);
+            break;
+        case Job::Type::File:
+            runFile(job, stop);
+            break;
+        case Job::Type::Save:
+            runSave(job);
+            break;
+        }
+    }
+}
+
+void ProjectIndexer::runOpen(const Job& job, std::stop_token stop) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // Publish the stored catalog right away, checking it against the disk takes a while on big projects
+    SPLCatalog stored;
+    stored.load(getCatalogPath(job.root));
+    if (isCancelled(job, stop)) {
+        return;
+    }
+
+    post({ .catalog = stored, .indexed = {}, .removed = {}, .replaced = {}, .generation = job.generation, .done = false });
+
+    Result result = { .catalog = std::nullopt, .indexed = {}, .removed = {}, .replaced = {}, .generation = job.generation, .done = true };
+    std::unordered_set<std::string> seen;
+    size_t fileCount = 0;
+
+    std::error_code ec;
+    auto it = std::filesystem::recursive_directory_iterator(job.root, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (isCancelled(job, stop)) {
+            return;
+        }
+
+        const auto& path = it->path();
+        std::error_code entryError;
+        if (it->is_directory(entryError)) {
+            // Also skips our own .nitroefx directory
+            if (path.filename().string().starts_with('.')) {
+                it.disable_recursion_pending();
+            }
+
+            continue;
+        }
+
+        if (!isIndexedFile(path)) {
+            continue;
+        }
+
+        ++fileCount;
+        auto key = getKey(job.root, path);
+        const auto* previous = stored.find(key);
+        seen.insert(key);
+
+        const bool unchanged = previous && previous->fileSize == it->file_size(entryError) && previous->lastWrite == getLastWrite(path);
+
+        if (SPLContainerScanner::isContainer(path)) {
+            const auto prefix = key + '/';
+            if (unchanged) {
+                for (const auto& [storedKey, entry] : stored.getEntries()) {
+                    if (storedKey.starts_with(prefix)) {
+                        seen.insert(storedKey);
+                    }
+                }
+            } else if (auto entries = indexContainer(job.root, path, stop)) {
+                // Members that are gone aren't seen and get removed below
+                for (auto& entry : *entries) {
+                    seen.insert(entry.path);
+                    result.indexed.push_back(std::move(entry));
+                }
+            }
+
+            continue;
+        }
+
+        if (unchanged) {
+            continue;
+        }
+
+        if (auto entry = indexFile(job.root, path)) {
+            result.indexed.push_back(std::move(*entry));
+        } else if (previous) {
+            result.removed.push_back(std::move(key));
+        }
+    }
+
+    for (const auto& [key, entry] : stored.getEntries()) {
+        if (!seen.contains(key)) {
+            result.removed.push_back(key);
+        }
+    }
+
+    spdlog::info("Indexed {}: {} files, {} updated, {} removed in {:.1f} ms",
+        job.root.string(),
+        fileCount,
+        result.indexed.size(),
+        result.removed.size(),
+        std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count()
+    );
+
+    post(std::move(result));
+}
+
+void ProjectIndexer::runFile(const Job& job, std::stop_token stop) {
+    if (isCancelled(job, stop)) {
+        return;
+    }
+
+    Result result = { .catalog = std::nullopt, .indexed = {}, .removed = {}, .replaced = {}, .generation = job.generation, .done = true };
+
+    if (SPLContainerScanner::isContainer(job.path)) {
+        // Everything found in the container last time is replaced, or dropped if it can't be read anymore
+        const auto key = getKey(job.root, job.path);
+        result.replaced = key + '/';
+        result.removed.push_back(key);
+
+        if (auto entries = indexContainer(job.root, job.path, stop)) {
+            result.indexed = std::move(*entries);
+        }
+
+        post(std::move(result));
+        return;
+    }
+
+    if (auto entry = indexFile(job.root, job.path)) {
+        result.indexed.push_back(std::move(*entry));
+    } else {
+        // Deleted, renamed away or not an SPL file (anymore)
+        result.removed.push_back(getKey(job.root, job.path));
+    }
+
+    post(std::move(result));
+}
+
+void ProjectIndexer::runSave(const Job& job) {
+    {
+        // Checked under the lock, close() bumps the generation before it saves
+        std::scoped_lock lock(m_saveMutex);
+        if (job.generation == m_generation) {
+            job.catalog.save(getCatalogPath(job.root));
+        }
+    }
+
+    --m_pendingSaves;
+}
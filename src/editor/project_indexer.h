@@ -0,0 +1,107 @@
+#pragma once
+
+#include "spl/spl_catalog.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+// Keeps <project>/.nitroefx/catalog.bin in sync with the .spa files in the project.
+// The catalog is loaded and checked on a background thread, only files whose size or
+// modification time changed are read again.
+// SPL archives inside .nds and .narc files are indexed as "<container>/<path inside>". The container
+// itself gets an entry without resources that records the size and write time it was scanned at.
+class ProjectIndexer {
+public:
+    ProjectIndexer();
+    ~ProjectIndexer();
+
+    void open(const std::filesystem::path& root);
+    void close();
+
+    // Queues a file that was added, removed or modified
+    void invalidate(const std::filesystem::path& file);
+
+    // Applies finished work and saves the catalog when it changed, call once per frame on the main thread
+    void update();
+
+    const SPLCatalogEntry* find(const std::filesystem::path& file) const;
+    const SPLCatalog& getCatalog() const { return m_catalog; }
+    const std::filesystem::path& getRoot() const { return m_root; }
+    bool isIndexing() const { return m_outstanding > 0; }
+
+    // Changes whenever the catalog does
+    u64 getVersion() const { return m_version; }
+
+    static std::filesystem::path getCatalogPath(const std::filesystem::path& root) {
+        return root / ".nitroefx" / "catalog.bin";
+    }
+
+private:
+    struct Job {
+        enum class Type {
+            Open, // Load the catalog and check the whole project against it
+            File,
+            Save
+        };
+
+        Type type;
+        std::filesystem::path root;
+        std::filesystem::path path;
+        SPLCatalog catalog; // Save only
+        u64 generation;
+    };
+
+    struct Result {
+        std::optional<SPLCatalog> catalog; // Replaces the whole catalog
+        std::vector<SPLCatalogEntry> indexed;
+        std::vector<std::string> removed;
+        std::string replaced; // Entries starting with this are dropped before adding the indexed ones
+        u64 generation;
+        bool done; // Last result of its job
+    };
+
+    static std::string getKey(const std::filesystem::path& root, const std::filesystem::path& file);
+    static std::optional<SPLCatalogEntry> indexFile(const std::filesystem::path& root, const std::filesystem::path& file);
+    static std::optional<std::vector<SPLCatalogEntry>> indexContainer(const std::filesystem::path& root, const std::filesystem::path& file, std::stop_token stop);
+
+    void submit(Job job);
+    void post(Result result);
+    void save(const std::filesystem::path& root, const SPLCatalog& catalog);
+
+    // Jobs of a project that was closed in the meantime stop early
+    bool isCancelled(const Job& job, std::stop_token stop) const {
+        return stop.stop_requested() || job.generation != m_generation;
+    }
+
+    void workerMain(std::stop_token stop);
+    void runOpen(const Job& job, std::stop_token stop);
+    void runFile(const Job& job, std::stop_token stop);
+    void runSave(const Job& job);
+
+private:
+    static constexpr auto SAVE_INTERVAL = std::chrono::seconds(2);
+
+    std::filesystem::path m_root;
+    SPLCatalog m_catalog;
+    bool m_dirty = false;
+    std::chrono::steady_clock::time_point m_lastSave;
+    size_t m_outstanding = 0;
+    std::atomic<u64> m_generation = 0; // Bumped by close(), read by the worker
+    u64 m_version = 0;
+
+    std::mutex m_mutex;
+    std::mutex m_saveMutex; // Saves can come from the worker and from close()
+    std::atomic<size_t> m_pendingSaves = 0; // Save jobs queued or running
+    std::condition_variable_any m_condition;
+    std::deque<Job> m_jobs;
+    std::vector<Result> m_results;
+    std::jthread m_worker;
+};
@@ -1,10 +1,53 @@
 #include "project_manager.h"
 
+#include <algorithm>
 #include <imgui.h>
 
 #include "SDL_messagebox.h"
 #include "fonts/IconsFontAwesome6.h"
 #include "spdlog/spdlog.h"
+#include "spl/enum_names.h"
+#include "spl/spl_container_scanner.h"
+
+
+namespace {
+
+constexpr u32 s_textureFormatCount = 8;
+constexpr u32 s_behaviorTypeCount = 6;
+
+std::string describe(const SPLCatalogEntry& entry) {
+    std::string formats;
+    for (u32 i = 1; i < s_textureFormatCount; i++) {
+        if (entry.hasTextureFormat((TextureFormat)i)) {
+            formats += fmt::format("{}{}", formats.empty() ? "" : ", ", getTextureFormat((TextureFormat)i));
+        }
+    }
+
+    std::string behaviors;
+    for (u32 i = 0; i < s_behaviorTypeCount; i++) {
+        if (entry.behaviors & (1 << i)) {
+            behaviors += fmt::format("{}{}", behaviors.empty() ? "" : ", ", getBehaviorType((SPLBehaviorType)i));
+        }
+    }
+
+    return fmt::format(
+        "{} resources, {} textures ({:.1f} KB)\n"
+        "Formats: {}\n"
+        "Largest texture: {}x{}\n"
+        "Behaviors: {}\n"
+        "Child resources: {}",
+        entry.resourceCount,
+        entry.textureCount,
+        entry.textureBytes / 1024.0f,
+        formats.empty() ? "-" : formats,
+        entry.maxTextureWidth,
+        entry.maxTextureHeight,
+        behaviors.empty() ? "-" : behaviors,
+        entry.features & SPLCatalogEntry::ChildResource ? "Yes" : "No"
+    );
+}
+
+}
 
 
 void ProjectManager::openProject(const std::filesystem::path& path) {
@@ -33,6 +76,8 @@ void ProjectManager::openProject(const std::filesystem::path& path) {
     }
 
     m_projectPath = path;
+    m_tree.open(path);
+    m_indexer.open(path);
 }
 
 void ProjectManager::closeProject(bool force) {
@@ -45,11 +90,37 @@ void ProjectManager::closeProject(bool force) {
         m_activeEditor.reset();
         m_projectPath.clear();
         m_openEditors.clear();
+        m_tree.close();
+        m_indexer.close();
+        m_containers.clear();
     }
 }
 
-void ProjectManager::openEditor(const std::filesystem::path& path) {
-    const auto editor = std::make_shared<EditorInstance>(path);
+void ProjectManager::openEditor(const std::filesystem::path& path, int resource) {
+    // Opening an archive a second time shares the first one's data (and with it its GL textures),
+    // or waits for its parse if that is still running
+    std::shared_ptr<EditorInstance> editor;
+    for (const auto& open : m_openEditors) {
+        if (open->getPath().lexically_normal() != path.lexically_normal()) {
+            continue;
+        }
+
+        if (open->isLoaded()) {
+            editor = std::make_shared<EditorInstance>(path, open->getSharedArchive());
+            break;
+        }
+
+        if (const auto& load = open->getPendingLoad()) {
+            editor = std::make_shared<EditorInstance>(path, load);
+            break;
+        }
+    }
+
+    if (!editor) {
+        editor = std::make_shared<EditorInstance>(path);
+    }
+
+    editor->setInitialSelection(resource);
     m_activeEditor = editor;
     m_openEditors.push_back(editor);
 }
@@ -72,11 +143,48 @@ void ProjectManager::closeAllEditors() {
     m_activeEditor.reset();
 }
 
+void ProjectManager::saveEditor(const std::shared_ptr<EditorInstance>& editor) {
+    if (!editor->save()) {
+        return;
+    }
+
+    for (const auto& other : m_openEditors) {
+        if (other != editor && other->isLoaded() && other->getSharedArchive() == editor->getSharedArchive()) {
+            other->markSaved();
+        }
+    }
+}
+
+void ProjectManager::saveAllEditors() {
+    std::vector<std::shared_ptr<SPLArchive>> saved;
+    for (const auto& editor : m_openEditors) {
+        if (!editor->isLoaded() || !editor->isModified()) {
+            continue;
+        }
+
+        if (std::ranges::find(saved, editor->getSharedArchive()) == saved.end()) {
+            saved.push_back(editor->getSharedArchive());
+            saveEditor(editor);
+        }
+    }
+}
+
 void ProjectManager::open() {
     m_open = true;
 }
 
 void ProjectManager::render() {
+    // Keep the tree and catalog up to date even while the window is hidden
+    m_tree.update();
+    for (const auto& event : m_tree.getEvents()) {
+        m_indexer.invalidate(event.path);
+        if (SPLContainerScanner::isContainer(event.path)) {
+            m_containers.erase(event.path.string());
+        }
+    }
+
+    m_indexer.update();
+
     if (!m_open) {
         return;
     }
@@ -86,12 +194,33 @@ void ProjectManager::render() {
             ImGui::Text("No project open");
         } else {
             ImGui::Checkbox("Hide non SPL files", &m_hideOtherFiles);
+            if (m_tree.isScanning()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("Scanning... (%zu files)", m_tree.getFileCount());
+            } else if (m_indexer.isIndexing()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("Indexing...");
+            }
+
+            ImGui::SetNextItemWidth(-1);
+            ImGui::InputTextWithHint("##Search", "format:comp4x4 behavior:magnet", m_searchQuery.data(), m_searchQuery.size());
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Search resources across the project\nKeys: %s\nPrefix a term with - to exclude it", SPLResourceIndex::QUERY_KEYS);
+            }
+
+            renderFilters();
 
-            for (const auto& entry : std::filesystem::directory_iterator(m_projectPath)) {
-                if (entry.is_directory()) {
-                    renderDirectory(entry.path());
-                } else {
-                    renderFile(entry.path());
+            if (m_searchQuery[0] != '\0') {
+                renderSearchResults();
+            } else if (hasFilters()) {
+                renderFilteredFiles();
+            } else {
+                for (const auto& child : m_tree.getRoot().children) {
+                    if (child.isDirectory) {
+                        renderDirectory(child);
+                    } else {
+                        renderFile(child);
+                    }
                 }
             }
         }
@@ -115,8 +244,8 @@ void ProjectManager::handleEvent(const SDL_Event& event) {
     }
 }
 
-void ProjectManager::renderDirectory(const std::filesystem::path& path) {
-    const auto text = fmt::format(ICON_FA_FOLDER " {}", path.filename().string());
+void ProjectManager::renderDirectory(const ProjectTreeNode& node) {
+    const auto text = fmt::format(ICON_FA_FOLDER " {}", node.name);
     const bool open = ImGui::TreeNodeEx(text.c_str(), ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth);
 
     if (ImGui::BeginPopupContextItem(nullptr, ImGuiPopupFlags_MouseButtonRight)) {
@@ -134,11 +263,15 @@ void ProjectManager::renderDirectory(const std::filesystem::path& path) {
     }
 
     if (open) {
-        for (const auto& entry : std::filesystem::directory_iterator(path)) {
-            if (entry.is_directory()) {
-                renderDirectory(entry.path());
+        if (!node.listed) {
+            ImGui::TextDisabled("Loading...");
+        }
+
+        for (const auto& child : node.children) {
+            if (child.isDirectory) {
+                renderDirectory(child);
             } else {
-                renderFile(entry.path());
+                renderFile(child);
             }
         }
 
@@ -146,8 +279,14 @@ void ProjectManager::renderDirectory(const std::filesystem::path& path) {
     }
 }
 
-void ProjectManager::renderFile(const std::filesystem::path& path) {
-    const auto text = fmt::format(ICON_FA_FILE " {}", path.filename().string());
+void ProjectManager::renderFile(const ProjectTreeNode& node) {
+    if (SPLContainerScanner::isContainer(node.path)) {
+        renderContainer(node);
+        return;
+    }
+
+    const auto& path = node.path;
+    const auto text = fmt::format(ICON_FA_FILE " {}", node.name);
     const bool isSplFile = path.extension().string() == ".spa";
     if (!isSplFile) {
         if (m_hideOtherFiles) {
@@ -164,6 +303,12 @@ void ProjectManager::renderFile(const std::filesystem::path& path) {
         }
     }
 
+    if (isSplFile && ImGui::IsItemHovered()) {
+        if (const auto entry = m_indexer.find(path)) {
+            ImGui::SetTooltip("%s", describe(*entry).c_str());
+        }
+    }
+
     ImGui::Unindent(40.0f);
 
     if (!isSplFile) {
@@ -184,3 +329,187 @@ void ProjectManager::renderFile(const std::filesystem::path& path) {
         ImGui::EndPopup();
     }
 }
+
+void ProjectManager::renderContainer(const ProjectTreeNode& node) {
+    const auto text = fmt::format(ICON_FA_FILE_ZIPPER " {}", node.name);
+    if (!ImGui::TreeNodeEx(text.c_str(), ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth)) {
+        return;
+    }
+
+    if (const auto fs = getContainer(node.path)) {
+        renderContainerDirectory(*fs, 0);
+    } else {
+        ImGui::TextDisabled("Couldn't read %s", node.name.c_str());
+    }
+
+    ImGui::TreePop();
+}
+
+void ProjectManager::renderContainerDirectory(const NitroFS& fs, size_t index) {
+    const auto& directory = fs.getDirectories()[index];
+    const auto& members = fs.getFiles();
+
+    for (const u16 child : directory.directories) {
+        const auto text = fmt::format(ICON_FA_FOLDER " {}", fs.getDirectories()[child].name);
+        if (ImGui::TreeNodeEx(text.c_str(), ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth)) {
+            renderContainerDirectory(fs, child);
+            ImGui::TreePop();
+        }
+    }
+
+    // Game archives and ROMs can hold thousands of files, only lay out the visible ones
+    std::vector<u16> files;
+    files.reserve(directory.files.size());
+    for (const u16 file : directory.files) {
+        if (!m_hideOtherFiles || members[file].name.ends_with(".spa")) {
+            files.push_back(file);
+        }
+    }
+
+    ImGui::Indent(40.0f);
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)files.size());
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            const auto& member = members[files[i]];
+            const bool isSplFile = member.name.ends_with(".spa");
+            const auto text = fmt::format(ICON_FA_FILE " {} ({:.1f} KB)", member.name, member.size / 1024.0f);
+
+            if (!isSplFile) {
+                ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+            }
+
+            if (ImGui::Selectable(text.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick)
+                && isSplFile && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+                openEditor(fs.getPath() / member.path);
+            }
+
+            if (!isSplFile) {
+                ImGui::PopStyleColor();
+            } else if (ImGui::BeginPopupContextItem(nullptr, ImGuiPopupFlags_MouseButtonRight)) {
+                if (ImGui::MenuItem("Open")) {
+                    openEditor(fs.getPath() / member.path);
+                }
+
+                ImGui::EndPopup();
+            }
+        }
+    }
+
+    ImGui::Unindent(40.0f);
+}
+
+const NitroFS* ProjectManager::getContainer(const std::filesystem::path& path) {
+    auto [it, inserted] = m_containers.try_emplace(path.string());
+    if (inserted) {
+        it->second = NitroFS::load(path);
+        if (it->second) {
+            spdlog::info("Opened {}: {} files", path.string(), it->second->getFiles().size());
+        }
+    }
+
+    return it->second.get();
+}
+
+void ProjectManager::renderFilters() {
+    if (!ImGui::CollapsingHeader("Filters")) {
+        return;
+    }
+
+    const auto filterCombo = [](const char* label, int& value, u32 first, u32 count, auto getName) {
+        if (ImGui::BeginCombo(label, value < 0 ? "Any" : getName(value))) {
+            if (ImGui::Selectable("Any", value < 0)) {
+                value = -1;
+            }
+
+            for (u32 i = first; i < count; i++) {
+                if (ImGui::Selectable(getName(i), value == (int)i)) {
+                    value = (int)i;
+                }
+            }
+
+            ImGui::EndCombo();
+        }
+    };
+
+    filterCombo("Texture format", m_formatFilter, 1, s_textureFormatCount, [](u32 i) {
+        return getTextureFormat((TextureFormat)i);
+    });
+
+    filterCombo("Behavior", m_behaviorFilter, 0, s_behaviorTypeCount, [](u32 i) {
+        return getBehaviorType((SPLBehaviorType)i);
+    });
+
+    ImGui::Checkbox("Has child resources", &m_childFilter);
+}
+
+void ProjectManager::renderFilteredFiles() {
+    std::vector<const SPLCatalogEntry*> matches;
+    for (const auto& [key, entry] : m_indexer.getCatalog().getEntries()) {
+        if (matchesFilters(entry)) {
+            matches.push_back(&entry);
+        }
+    }
+
+    std::ranges::sort(matches, {}, &SPLCatalogEntry::path);
+
+    ImGui::TextDisabled("%zu matching files", matches.size());
+    for (const auto entry : matches) {
+        ProjectTreeNode node;
+        node.path = m_projectPath / entry->path;
+        node.name = entry->path;
+        renderFile(node);
+    }
+}
+
+bool ProjectManager::matchesFilters(const SPLCatalogEntry& entry) const {
+    if (m_formatFilter >= 0 && !entry.hasTextureFormat((TextureFormat)m_formatFilter)) {
+        return false;
+    }
+
+    if (m_behaviorFilter >= 0 && !(entry.behaviors & (1 << m_behaviorFilter))) {
+        return false;
+    }
+
+    return !m_childFilter || entry.features & SPLCatalogEntry::ChildResource;
+}
+
+void ProjectManager::renderSearchResults() {
+    const std::string_view query = m_searchQuery.data();
+    if (m_searchVersion != m_indexer.getVersion()) {
+        m_resourceIndex.build(m_indexer.getCatalog());
+        m_searchResult = m_resourceIndex.query(query);
+        m_searchVersion = m_indexer.getVersion();
+        m_lastQuery = query;
+    } else if (m_lastQuery != query) {
+        m_searchResult = m_resourceIndex.query(query);
+        m_lastQuery = query;
+    }
+
+    if (!m_searchResult.error.empty()) {
+        ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "%s", m_searchResult.error.c_str());
+        return;
+    }
+
+    ImGui::TextDisabled("%zu of %zu resources (%.2f ms)",
+        m_searchResult.matches.size(),
+        m_resourceIndex.getResourceCount(),
+        m_searchResult.milliseconds
+    );
+
+    const auto& files = m_resourceIndex.getFiles();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)m_searchResult.matches.size());
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            const auto& match = m_searchResult.matches[i];
+            const auto text = fmt::format(ICON_FA_FILE " {} #{}##{}", files[match.file], match.resource, i);
+
+            if (ImGui::Selectable(text.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick)
+                && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+                openEditor(m_projectPath / files[match.file], match.resource);
+            }
+        }
+    }
+}
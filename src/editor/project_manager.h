@@ -1,11 +1,18 @@
 #pragma once
 
 #include "editor_instance.h"
+#include "nitro_fs.h"
+#include "project_indexer.h"
+#include "project_tree.h"
+#include "spl/spl_resource_index.h"
 
 #include <SDL_events.h>
+#include <array>
 #include <filesystem>
 #include <memory>
 #include <span>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -14,10 +21,15 @@ class ProjectManager {
 public:
     void openProject(const std::filesystem::path& path);
     void closeProject(bool force = false);
-    void openEditor(const std::filesystem::path& path);
+    // resource is selected once the archive is loaded, -1 selects nothing
+    void openEditor(const std::filesystem::path& path, int resource = -1);
     void closeEditor(const std::shared_ptr<EditorInstance>& editor);
     void closeAllEditors();
 
+    // Tabs sharing the archive are saved along with the editor
+    void saveEditor(const std::shared_ptr<EditorInstance>& editor);
+    void saveAllEditors();
+
     void open();
     void render();
 
@@ -52,17 +64,45 @@ public:
     void handleEvent(const SDL_Event& event);
 
 private:
-    void renderDirectory(const std::filesystem::path& path);
-    void renderFile(const std::filesystem::path& path);
+    void renderDirectory(const ProjectTreeNode& node);
+    void renderFile(const ProjectTreeNode& node);
+    void renderContainer(const ProjectTreeNode& node);
+    void renderContainerDirectory(const NitroFS& fs, size_t index);
+    void renderFilters();
+    void renderFilteredFiles();
+    void renderSearchResults();
+
+    bool hasFilters() const {
+        return m_formatFilter >= 0 || m_behaviorFilter >= 0 || m_childFilter;
+    }
+
+    bool matchesFilters(const SPLCatalogEntry& entry) const;
+
+    // .narc and .nds files, opened the first time they are expanded, null if they couldn't be read
+    const NitroFS* getContainer(const std::filesystem::path& path);
 
 private:
     std::filesystem::path m_projectPath;
+    ProjectTree m_tree;
+    ProjectIndexer m_indexer;
+    std::unordered_map<std::string, std::unique_ptr<NitroFS>> m_containers;
 
     std::vector<std::shared_ptr<EditorInstance>> m_openEditors;
     std::shared_ptr<EditorInstance> m_activeEditor;
 
     bool m_open = true;
     bool m_hideOtherFiles = false;
+
+    // Catalog filters, -1 = any
+    int m_formatFilter = -1; // TextureFormat
+    int m_behaviorFilter = -1; // SPLBehaviorType
+    bool m_childFilter = false;
+
+    std::array<char, 256> m_searchQuery = {};
+    std::string m_lastQuery;
+    u64 m_searchVersion = ~0ull; // Catalog version the index and results were built from
+    SPLResourceIndex m_resourceIndex;
+    SPLResourceIndex::QueryResult m_searchResult;
     std::filesystem::path m_contextMenuPath;
 };
 
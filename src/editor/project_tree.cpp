@@ -0,0 +1,238 @@
+#include "project_tree.h"
+
+#include <algorithm>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
+
+namespace {
+
+// Skips things like .git, which can easily contain more directories than the rest of the project
+bool isHidden(const std::string& name) {
+    return name.starts_with('.');
+}
+
+}
+
+
+ProjectTree::ProjectTree() {
+    m_scanner = std::jthread([this](std::stop_token stop) { scannerMain(stop); });
+}
+
+ProjectTree::~ProjectTree() {
+    m_scanner.request_stop();
+    m_scanner.join();
+}
+
+void ProjectTree::open(const std::filesystem::path& root) {
+    close();
+
+    m_root.path = root;
+    m_root.name = root.filename().string();
+    m_root.isDirectory = true;
+
+    m_watcher.watch(root);
+    requestListing(root);
+}
+
+void ProjectTree::close() {
+    m_watcher.unwatchAll();
+    m_root = {};
+    m_outstanding = 0;
+    m_fileCount = 0;
+    m_scanned = false;
+    m_events.clear();
+
+    std::scoped_lock lock(m_mutex);
+    ++m_generation;
+    m_requests.clear();
+    m_listings.clear();
+}
+
+void ProjectTree::update() {
+    m_events.clear();
+    if (!isOpen()) {
+        return;
+    }
+
+    std::vector<Listing> listings;
+    {
+        std::scoped_lock lock(m_mutex);
+        listings = std::move(m_listings);
+        m_listings.clear();
+    }
+
+    for (auto& listing : listings) {
+        if (listing.generation != m_generation) {
+            continue;
+        }
+
+        --m_outstanding;
+        applyListing(listing);
+    }
+
+    if (m_outstanding == 0) {
+        m_scanned = true;
+    }
+
+    // Changes come in bursts (extracting an archive, checking out a branch), relist each directory once
+    std::set<std::filesystem::path> dirty;
+    const auto events = m_watcher.poll();
+    m_events.insert(m_events.end(), events.begin(), events.end());
+    for (const auto& event : events) {
+        dirty.insert(event.path.parent_path());
+
+        const auto node = findNode(event.path);
+        if (event.type == FileWatchEvent::Type::Modified && node && node->isDirectory) {
+            dirty.insert(event.path);
+        }
+    }
+
+    for (const auto& directory : dirty) {
+        const auto node = findNode(directory);
+        if (node && node->isDirectory) {
+            requestListing(directory);
+        }
+    }
+}
+
+void ProjectTree::requestListing(const std::filesystem::path& directory) {
+    ++m_outstanding;
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_requests.emplace_back(directory, m_generation);
+    }
+
+    m_condition.notify_one();
+}
+
+void ProjectTree::applyListing(Listing& listing) {
+    const auto node = findNode(listing.directory);
+    if (!node || !node->isDirectory) {
+        return;
+    }
+
+    std::unordered_map<std::string, size_t> previous;
+    for (size_t i = 0; i < node->children.size(); i++) {
+        previous[node->children[i].name] = i;
+    }
+
+    // Files in directories that appeared after the initial scan don't get their own watcher events
+    const bool reportNewFiles = m_scanned && !node->listed;
+
+    std::vector<bool> kept(node->children.size(), false);
+    std::vector<ProjectTreeNode> children;
+    children.reserve(listing.entries.size());
+
+    for (auto& entry : listing.entries) {
+        const auto it = previous.find(entry.name);
+        if (it != previous.end() && node->children[it->second].isDirectory == entry.isDirectory) {
+            kept[it->second] = true;
+            children.push_back(std::move(node->children[it->second]));
+            continue;
+        }
+
+        auto& child = children.emplace_back();
+        child.path = listing.directory / entry.name;
+        child.name = std::move(entry.name);
+        child.isDirectory = entry.isDirectory;
+
+        if (child.isDirectory) {
+            m_watcher.watch(child.path);
+            requestListing(child.path);
+        } else {
+            ++m_fileCount;
+            if (reportNewFiles) {
+                m_events.push_back({ FileWatchEvent::Type::Added, child.path });
+            }
+        }
+    }
+
+    for (size_t i = 0; i < node->children.size(); i++) {
+        if (!kept[i]) {
+            unwatchRecursive(node->children[i]);
+        }
+    }
+
+    std::ranges::sort(children, [](const ProjectTreeNode& a, const ProjectTreeNode& b) {
+        if (a.isDirectory != b.isDirectory) {
+            return a.isDirectory;
+        }
+
+        return a.name < b.name;
+    });
+
+    node->children = std::move(children);
+    node->listed = true;
+}
+
+void ProjectTree::unwatchRecursive(const ProjectTreeNode& node) {
+    if (!node.isDirectory) {
+        --m_fileCount;
+        return;
+    }
+
+    m_watcher.unwatch(node.path);
+    for (const auto& child : node.children) {
+        unwatchRecursive(child);
+    }
+}
+
+ProjectTreeNode* ProjectTree::findNode(const std::filesystem::path& path) {
+    const auto relative = path.lexically_relative(m_root.path);
+    if (relative.empty() || *relative.begin() == "..") {
+        return nullptr;
+    }
+
+    ProjectTreeNode* node = &m_root;
+    for (const auto& component : relative) {
+        if (component == ".") {
+            continue;
+        }
+
+        const auto it = std::ranges::find(node->children, component.string(), &ProjectTreeNode::name);
+        if (it == node->children.end()) {
+            return nullptr;
+        }
+
+        node = &*it;
+    }
+
+    return node;
+}
+
+void ProjectTree::scannerMain(std::stop_token stop) {
+    while (true) {
+        std::filesystem::path directory;
+        u64 generation;
+
+        {
+            std::unique_lock lock(m_mutex);
+            if (!m_condition.wait(lock, stop, [this] { return !m_requests.empty(); })) {
+                return;
+            }
+
+            std::tie(directory, generation) = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        Listing listing = { .directory = directory, .entries = {}, .generation = generation };
+
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            auto name = entry.path().filename().string();
+            std::error_code typeError;
+            const bool isDirectory = entry.is_directory(typeError);
+            if (isDirectory && isHidden(name)) {
+                continue;
+            }
+
+            listing.entries.push_back({ std::move(name), isDirectory });
+        }
+
+        std::scoped_lock lock(m_mutex);
+        m_listings.push_back(std::move(listing));
+    }
+}
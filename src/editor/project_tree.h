@@ -0,0 +1,78 @@
+#pragma once
+
+#include "file_watcher.h"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct ProjectTreeNode {
+    std::filesystem::path path;
+    std::string name;
+    bool isDirectory = false;
+    bool listed = false; // Directories only, false until the scanner got to it
+    std::vector<ProjectTreeNode> children; // Directories first, then by name
+};
+
+// In-memory copy of the project directory so the UI never touches the file system.
+// Directories are listed on a background thread and relisted when the watcher reports changes.
+class ProjectTree {
+public:
+    ProjectTree();
+    ~ProjectTree();
+
+    void open(const std::filesystem::path& root);
+    void close();
+
+    // Applies finished listings and file system changes, call once per frame on the main thread
+    void update();
+
+    const ProjectTreeNode& getRoot() const { return m_root; }
+    bool isOpen() const { return !m_root.path.empty(); }
+    bool isScanning() const { return m_outstanding > 0; }
+    size_t getFileCount() const { return m_fileCount; }
+
+    // File system changes picked up by the last update()
+    const std::vector<FileWatchEvent>& getEvents() const { return m_events; }
+
+private:
+    struct Entry {
+        std::string name;
+        bool isDirectory;
+    };
+
+    struct Listing {
+        std::filesystem::path directory;
+        std::vector<Entry> entries;
+        u64 generation;
+    };
+
+    void requestListing(const std::filesystem::path& directory);
+    void applyListing(Listing& listing);
+    void unwatchRecursive(const ProjectTreeNode& node);
+    ProjectTreeNode* findNode(const std::filesystem::path& path);
+
+    void scannerMain(std::stop_token stop);
+
+private:
+    ProjectTreeNode m_root;
+    FileWatcher m_watcher;
+    size_t m_outstanding = 0;
+    size_t m_fileCount = 0;
+    bool m_scanned = false; // The initial scan is done
+    std::vector<FileWatchEvent> m_events;
+
+    // Bumped when a project is opened or closed so stale listings get dropped
+    u64 m_generation = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<std::pair<std::filesystem::path, u64>> m_requests;
+    std::vector<Listing> m_listings;
+    std::jthread m_scanner;
+};
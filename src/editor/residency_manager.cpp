@@ -0,0 +1,68 @@
+#include "residency_manager.h"
+#include "editor_instance.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+
+void ResidencyManager::update(std::span<const std::shared_ptr<EditorInstance>> editors, const std::shared_ptr<EditorInstance>& active) {
+    const auto now = Clock::now();
+
+    std::unordered_set<u64> open;
+    for (const auto& editor : editors) {
+        const u64 id = editor->getUniqueID();
+        open.insert(id);
+
+        // Newly opened tabs count as just shown
+        if (editor == active || !m_lastShown.contains(id)) {
+            m_lastShown[id] = now;
+        }
+    }
+
+    std::erase_if(m_lastShown, [&open](const auto& entry) { return !open.contains(entry.first); });
+
+    struct Candidate {
+        EditorInstance* editor;
+        Clock::time_point lastShown;
+        u64 size;
+    };
+
+    std::vector<Candidate> candidates;
+    u64 total = 0;
+    size_t evicted = 0;
+
+    for (const auto& editor : editors) {
+        if (!editor->isLoaded()) {
+            continue;
+        }
+
+        if (!editor->isResident()) {
+            ++evicted;
+            continue;
+        }
+
+        const u64 size = editor->getMemoryUsage().getGPUTotal();
+        total += size;
+
+        if (editor != active) {
+            candidates.push_back({ editor.get(), m_lastShown[editor->getUniqueID()], size });
+        }
+    }
+
+    // Least recently shown first, so going over budget evicts the tabs least likely to come back
+    std::ranges::sort(candidates, {}, &Candidate::lastShown);
+
+    for (const auto& candidate : candidates) {
+        if (now - candidate.lastShown < m_idleTimeout && total <= m_budget) {
+            continue;
+        }
+
+        candidate.editor->evict();
+        total -= candidate.size;
+        ++evicted;
+    }
+
+    m_residentMemory = total;
+    m_evictedCount = evicted;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "types.h"
+
+#include <chrono>
+#include <memory>
+#include <span>
+#include <unordered_map>
+
+
+class EditorInstance;
+
+// Releases the GPU resources of editor tabs that haven't been shown for a while, and of the least recently
+// shown ones while all tabs together need more than the budget. The active tab is never evicted,
+// evicted tabs restore themselves once they are shown again (see EditorInstance::makeResident).
+class ResidencyManager {
+public:
+    // Call once per frame, after the tabs have been rendered
+    void update(std::span<const std::shared_ptr<EditorInstance>> editors, const std::shared_ptr<EditorInstance>& active);
+
+    void setIdleTimeout(std::chrono::seconds timeout) { m_idleTimeout = timeout; }
+    void setBudget(u64 bytes) { m_budget = bytes; }
+    u64 getBudget() const { return m_budget; }
+
+    u64 getResidentMemory() const { return m_residentMemory; }
+    size_t getEvictedCount() const { return m_evictedCount; }
+
+    static constexpr std::chrono::seconds DEFAULT_IDLE_TIMEOUT = std::chrono::minutes(2);
+    static constexpr u64 DEFAULT_BUDGET = 512ull * 1024 * 1024;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::chrono::seconds m_idleTimeout = DEFAULT_IDLE_TIMEOUT;
+    u64 m_budget = DEFAULT_BUDGET;
+
+    std::unordered_map<u64, Clock::time_point> m_lastShown; // By EditorInstance::getUniqueID
+    u64 m_residentMemory = 0;
+    size_t m_evictedCount = 0;
+};
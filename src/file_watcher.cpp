@@ -0,0 +1,247 @@
+#include "file_watcher.h"
+
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) {
+        spdlog::warn("inotify unavailable, falling back to polling");
+    }
+#endif
+
+    m_poller = std::jthread([this](std::stop_token stop) { pollerMain(stop); });
+}
+
+FileWatcher::~FileWatcher() {
+    m_poller.request_stop();
+    m_poller.join();
+
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        close(m_inotify);
+    }
+#endif
+}
+
+void FileWatcher::watch(const std::filesystem::path& directory) {
+#ifdef __linux__
+    if (m_watchedPaths.contains(directory.string())) {
+        return;
+    }
+
+    if (m_inotify >= 0) {
+        const int wd = inotify_add_watch(
+            m_inotify,
+            directory.c_str(),
+            IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR
+        );
+
+        if (wd >= 0) {
+            m_watchDescriptors[wd] = directory;
+            m_watchedPaths[directory.string()] = wd;
+            return;
+        }
+
+        static bool warned = false;
+        if (errno == ENOSPC && !warned) {
+            spdlog::warn("inotify watch limit reached, polling the remaining directories (see fs.inotify.max_user_watches)");
+            warned = true;
+        }
+    }
+#endif
+
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_polled.contains(directory)) {
+            return;
+        }
+
+        m_pendingSnapshots.insert(directory);
+    }
+
+    m_condition.notify_one();
+}
+
+void FileWatcher::unwatch(const std::filesystem::path& directory) {
+#ifdef __linux__
+    const auto it = m_watchedPaths.find(directory.string());
+    if (it != m_watchedPaths.end()) {
+        inotify_rm_watch(m_inotify, it->second);
+        m_watchDescriptors.erase(it->second);
+        m_watchedPaths.erase(it);
+        return;
+    }
+#endif
+
+    std::scoped_lock lock(m_mutex);
+    m_polled.erase(directory);
+    m_pendingSnapshots.erase(directory);
+}
+
+void FileWatcher::unwatchAll() {
+#ifdef __linux__
+    for (const auto& [wd, path] : m_watchDescriptors) {
+        inotify_rm_watch(m_inotify, wd);
+    }
+#endif
+
+    m_watchDescriptors.clear();
+    m_watchedPaths.clear();
+
+    std::scoped_lock lock(m_mutex);
+    m_polled.clear();
+    m_pendingSnapshots.clear();
+    m_polledEvents.clear();
+}
+
+std::vector<FileWatchEvent> FileWatcher::poll() {
+    std::vector<FileWatchEvent> events;
+
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        alignas(inotify_event) char buffer[16 * 1024];
+
+        while (true) {
+            const ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+
+            for (ssize_t offset = 0; offset < length;) {
+                const auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += (ssize_t)(sizeof(inotify_event) + event->len);
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Events were dropped, report every directory as changed so they all get relisted
+                    spdlog::warn("inotify queue overflowed, rescanning watched directories");
+                    for (const auto& [wd, path] : m_watchDescriptors) {
+                        events.push_back({ FileWatchEvent::Type::Modified, path });
+                    }
+
+                    continue;
+                }
+
+                // The directory was deleted or unwatched, the kernel already dropped the watch
+                if (event->mask & IN_IGNORED) {
+                    const auto it = m_watchDescriptors.find(event->wd);
+                    if (it != m_watchDescriptors.end()) {
+                        m_watchedPaths.erase(it->second.string());
+                        m_watchDescriptors.erase(it);
+                    }
+
+                    continue;
+                }
+
+                const auto it = m_watchDescriptors.find(event->wd);
+                if (it == m_watchDescriptors.end() || event->len == 0) {
+                    continue;
+                }
+
+                FileWatchEvent::Type type = FileWatchEvent::Type::Modified;
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    type = FileWatchEvent::Type::Added;
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    type = FileWatchEvent::Type::Removed;
+                }
+
+                events.push_back({ type, it->second / event->name });
+            }
+        }
+    }
+#endif
+
+    std::scoped_lock lock(m_mutex);
+    events.insert(events.end(), m_polledEvents.begin(), m_polledEvents.end());
+    m_polledEvents.clear();
+
+    return events;
+}
+
+FileWatcher::Snapshot FileWatcher::takeSnapshot(const std::filesystem::path& directory) {
+    Snapshot snapshot;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        std::error_code entryError;
+        snapshot[entry.path().filename().string()] = {
+            .lastWrite = entry.last_write_time(entryError),
+            .isDirectory = entry.is_directory(entryError)
+        };
+    }
+
+    return snapshot;
+}
+
+void FileWatcher::pollerMain(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+        std::vector<std::filesystem::path> directories;
+        std::set<std::filesystem::path> baselines;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait_for(lock, stop, POLL_INTERVAL, [this] { return !m_pendingSnapshots.empty(); });
+            if (stop.stop_requested()) {
+                break;
+            }
+
+            for (const auto& [directory, snapshot] : m_polled) {
+                directories.push_back(directory);
+            }
+
+            baselines = m_pendingSnapshots;
+            directories.insert(directories.end(), baselines.begin(), baselines.end());
+        }
+
+        // Listing is the slow part, so it happens without holding the lock
+        std::vector<Snapshot> snapshots;
+        snapshots.reserve(directories.size());
+        for (const auto& directory : directories) {
+            snapshots.push_back(takeSnapshot(directory));
+        }
+
+        std::scoped_lock lock(m_mutex);
+        for (size_t i = 0; i < directories.size(); i++) {
+            const auto& directory = directories[i];
+            auto& current = snapshots[i];
+
+            if (baselines.contains(directory)) {
+                if (m_pendingSnapshots.erase(directory)) {
+                    m_polled[directory] = std::move(current);
+                }
+
+                continue;
+            }
+
+            const auto it = m_polled.find(directory);
+            if (it == m_polled.end()) { // Unwatched in the meantime
+                continue;
+            }
+
+            const auto& previous = it->second;
+            for (const auto& [name, entry] : current) {
+                const auto old = previous.find(name);
+                if (old == previous.end()) {
+                    m_polledEvents.push_back({ FileWatchEvent::Type::Added, directory / name });
+                } else if (!entry.isDirectory && old->second.lastWrite != entry.lastWrite) {
+                    m_polledEvents.push_back({ FileWatchEvent::Type::Modified, directory / name });
+                }
+            }
+
+            for (const auto& [name, entry] : previous) {
+                if (!current.contains(name)) {
+                    m_polledEvents.push_back({ FileWatchEvent::Type::Removed, directory / name });
+                }
+            }
+
+            it->second = std::move(current);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "types.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+struct FileWatchEvent {
+    enum class Type {
+        Added,
+        Removed,
+        Modified
+    };
+
+    Type type;
+    std::filesystem::path path;
+};
+
+// Watches individual directories (not recursively) for changes to their entries.
+// Uses inotify where available. Directories that can't be watched that way (other platforms,
+// exhausted watch limits) are polled on a background thread instead.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void watch(const std::filesystem::path& directory);
+    void unwatch(const std::filesystem::path& directory);
+    void unwatchAll();
+
+    // Returns the events since the last call, never blocks
+    std::vector<FileWatchEvent> poll();
+
+private:
+    struct PolledEntry {
+        std::filesystem::file_time_type lastWrite;
+        bool isDirectory;
+    };
+
+    using Snapshot = std::map<std::string, PolledEntry>;
+
+    static Snapshot takeSnapshot(const std::filesystem::path& directory);
+    void pollerMain(std::stop_token stop);
+
+private:
+    static constexpr auto POLL_INTERVAL = std::chrono::seconds(1);
+
+    int m_inotify = -1;
+    std::unordered_map<int, std::filesystem::path> m_watchDescriptors;
+    std::unordered_map<std::string, int> m_watchedPaths;
+
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::map<std::filesystem::path, Snapshot> m_polled;
+    std::set<std::filesystem::path> m_pendingSnapshots; // Added since the last poll, need a baseline
+    std::vector<FileWatchEvent> m_polledEvents;
+    std::jthread m_poller;
+};
@@ -0,0 +1,159 @@
+#include "gl_program_cache.h"
+#include "gl_util.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+struct BlobHeader {
+    u32 magic;
+    u32 version;
+    u32 format;
+    u32 size;
+};
+
+u64 hashString(const GLubyte* string, u64 seed) {
+    return string ? hash::xxh64(string, std::strlen((const char*)string), seed) : seed;
+}
+
+}
+
+
+GLProgramCache::GLProgramCache(std::filesystem::path directory) : m_directory(std::move(directory)) {
+    s32 formats = 0;
+    glCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+    m_supported = formats > 0;
+    if (!m_supported) {
+        spdlog::info("Program binaries are not supported by the driver, shaders are always compiled");
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    if (ec) {
+        spdlog::warn("Failed to create program cache {}: {}", m_directory.string(), ec.message());
+    }
+
+    m_driverHash = hashString(glGetString(GL_VENDOR), CACHE_VERSION);
+    m_driverHash = hashString(glGetString(GL_RENDERER), m_driverHash);
+    m_driverHash = hashString(glGetString(GL_VERSION), m_driverHash);
+}
+
+GLProgramCache::~GLProgramCache() {
+    if (m_supported) {
+        spdlog::info("Program cache: {} hits, {} misses", m_hits, m_misses);
+    }
+}
+
+u64 GLProgramCache::makeKey(std::initializer_list<std::string_view> sources) const {
+    u64 key = m_driverHash;
+    for (const auto source : sources) {
+        key = hash::xxh64(source.data(), source.size(), key);
+    }
+
+    return key;
+}
+
+u32 GLProgramCache::load(u64 key) {
+    if (!m_supported) {
+        return 0;
+    }
+
+    const auto path = getBlobPath(key);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        ++m_misses;
+        return 0;
+    }
+
+    u32 program = 0;
+
+    {
+        const MappedFile file(path);
+        const auto data = file.getData();
+
+        BlobHeader header;
+        if (data.size() >= sizeof(header)) {
+            std::memcpy(&header, data.data(), sizeof(header));
+        }
+
+        if (data.size() >= sizeof(header)
+            && header.magic == BLOB_MAGIC
+            && header.version == CACHE_VERSION
+            && header.size == data.size() - sizeof(header)) {
+            program = glCreateProgram();
+            glCall(glProgramBinary(program, header.format, data.data() + sizeof(header), (s32)header.size));
+
+            s32 success = 0;
+            glCall(glGetProgramiv(program, GL_LINK_STATUS, &success));
+            if (!success) {
+                glCall(glDeleteProgram(program));
+                program = 0;
+            }
+        }
+    }
+
+    if (program == 0) {
+        // Damaged or from a driver that changed without reporting a new version, it gets stored again
+        std::filesystem::remove(path, ec);
+        ++m_misses;
+        return 0;
+    }
+
+    ++m_hits;
+    return program;
+}
+
+void GLProgramCache::store(u64 key, u32 program) {
+    if (!m_supported || program == 0) {
+        return;
+    }
+
+    s32 length = 0;
+    glCall(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<u8> binary(length);
+    u32 format = 0;
+    glCall(glGetProgramBinary(program, length, &length, &format, binary.data()));
+    if (length <= 0) {
+        return;
+    }
+
+    const auto path = getBlobPath(key);
+    const auto temp = m_directory / fmt::format("{:016x}.{:08x}.tmp", key, std::random_device{}());
+
+    {
+        const BlobHeader header = { BLOB_MAGIC, CACHE_VERSION, format, (u32)length };
+
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        stream.write((const char*)&header, sizeof(header));
+        stream.write((const char*)binary.data(), length);
+
+        if (!stream) {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+    }
+}
+
+std::filesystem::path GLProgramCache::getBlobPath(u64 key) const {
+    return m_directory / fmt::format("{:016x}.bin", key);
+}
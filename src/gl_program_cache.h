@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <initializer_list>
+#include <string_view>
+
+
+// On-disk cache of linked program binaries, so shaders only get compiled the first time the driver sees them.
+// Keys cover the shader sources and the driver. Binaries the driver refuses anyway (e.g. after an update)
+// are deleted and the program is compiled again.
+//
+// Programs that should be stored have to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+// Requires a current GL context for every call.
+class GLProgramCache {
+public:
+    explicit GLProgramCache(std::filesystem::path directory);
+    ~GLProgramCache();
+
+    u64 makeKey(std::initializer_list<std::string_view> sources) const;
+
+    // Creates a linked program from the cached binary, 0 if there is none or the driver refused it
+    u32 load(u64 key);
+    void store(u64 key, u32 program);
+
+private:
+    // Bump when the blob layout changes
+    static constexpr u32 CACHE_VERSION = 1;
+    static constexpr u32 BLOB_MAGIC = 0x42504C47; // 'GLPB'
+
+    std::filesystem::path getBlobPath(u64 key) const;
+
+private:
+    std::filesystem::path m_directory;
+    u64 m_driverHash = 0;
+    bool m_supported = false; // Drivers may not offer any binary formats at all
+
+    u32 m_hits = 0;
+    u32 m_misses = 0;
+};
+
+inline GLProgramCache* g_programCache = nullptr;
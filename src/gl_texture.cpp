@@ -1,6 +1,8 @@
 #include "gl_texture.h"
 #include "spl/spl_resource.h"
 #include "gl_util.h"
+#include "gl_texture_uploader.h"
+#include "texture_cache.h"
 
 #include <gl/glew.h>
 
@@ -24,7 +26,8 @@ struct PixelA5I3 {
 };
 
 
-GLTexture::GLTexture(const SPLTexture& texture) : m_width(texture.width), m_height(texture.height) {
+GLTexture::GLTexture(const SPLTexture& texture)
+    : m_width(texture.width), m_height(texture.height), m_state(std::make_shared<GLUploadState>()) {
     createTexture(texture);
 }
 
@@ -34,6 +37,8 @@ GLTexture::GLTexture(GLTexture&& other) noexcept {
         m_width = other.m_width;
         m_height = other.m_height;
         m_format = other.m_format;
+        m_state = std::move(other.m_state);
+        m_memory = std::move(other.m_memory);
 
         other.m_texture = 0;
         other.m_width = 0;
@@ -48,6 +53,8 @@ GLTexture& GLTexture::operator=(GLTexture&& other) noexcept {
         m_width = other.m_width;
         m_height = other.m_height;
         m_format = other.m_format;
+        m_state = std::move(other.m_state);
+        m_memory = std::move(other.m_memory);
 
         other.m_texture = 0;
         other.m_width = 0;
@@ -63,9 +70,19 @@ GLTexture::~GLTexture() {
         return;
     }
 
+    // Deleting the texture now could hand its name to a new texture before the upload lands
+    if (!m_state->ready && g_textureUploader) {
+        m_state->orphaned = true;
+        return;
+    }
+
     glCall(glDeleteTextures(1, &m_texture));
 }
 
+bool GLTexture::isReady() const {
+    return m_state && m_state->ready;
+}
+
 void GLTexture::bind() const {
     glCall(glBindTexture(GL_TEXTURE_2D, m_texture));
 }
@@ -78,81 +95,10 @@ void GLTexture::createTexture(const SPLTexture& texture) {
 
     // Texture creation is a 2 step process. First the texture/palette data must be converted
     // to a format that OpenGL can understand (RGBA32). Then the texture will be uploaded to the GPU.
-
-    // Step 1: Conversion
-    std::vector<u8> textureData;
-    switch ((TextureFormat)texture.param.format) {
-    case TextureFormat::None:
-        break;
-    case TextureFormat::A3I5:
-        textureData = convertA3I5(
-            texture.textureData.data(),
-            (const GXRgba*)texture.paletteData.data(),
-            texture.width,
-            texture.height,
-            texture.paletteData.size()
-        );
-        break;
-    case TextureFormat::Palette4:
-        textureData = convertPalette4(
-            texture.textureData.data(),
-            (const GXRgba*)texture.paletteData.data(),
-            texture.width,
-            texture.height,
-            texture.paletteData.size(),
-            texture.param.palColor0Transparent
-        );
-        break;
-    case TextureFormat::Palette16:
-        textureData = convertPalette16(
-            texture.textureData.data(),
-            (const GXRgba*)texture.paletteData.data(),
-            texture.width,
-            texture.height,
-            texture.paletteData.size(),
-            texture.param.palColor0Transparent
-        );
-        break;
-    case TextureFormat::Palette256:
-        textureData = convertPalette256(
-            texture.textureData.data(),
-            (const GXRgba*)texture.paletteData.data(),
-            texture.width,
-            texture.height,
-            texture.paletteData.size(),
-            texture.param.palColor0Transparent
-        );
-        break;
-    case TextureFormat::Comp4x4:
-        textureData = convertComp4x4(
-            texture.textureData.data(),
-            (const GXRgba*)texture.paletteData.data(),
-            texture.width,
-            texture.height,
-            texture.paletteData.size()
-        );
-        break;
-    case TextureFormat::A5I3:
-        textureData = convertA5I3(
-            texture.textureData.data(),
-            (const GXRgba*)texture.paletteData.data(),
-            texture.width,
-            texture.height,
-            texture.paletteData.size()
-        );
-        break;
-    case TextureFormat::Direct:
-        textureData = convertDirect(
-            (const GXRgba*)texture.textureData.data(),
-            texture.width,
-            texture.height
-        );
-        break;
-    }
+    // Storage is always allocated here, the conversion and upload can be handed to g_textureUploader.
 
     const auto repeat = (TextureRepeat)texture.param.repeat;
 
-    // Step 2: Upload to GPU
     glCall(glGenTextures(1, &m_texture));
     glCall(glBindTexture(GL_TEXTURE_2D, m_texture));
 
@@ -178,24 +124,90 @@ void GLTexture::createTexture(const SPLTexture& texture) {
         (s32)m_height
     ));
 
-    glCall(glTexSubImage2D(
-        GL_TEXTURE_2D,
-        0,
-        0,
-        0,
-        (s32)m_width,
-        (s32)m_height,
-        GL_RGBA,
-        GL_UNSIGNED_BYTE,
-        textureData.data()
-    ));
-
     glCall(glBindTexture(GL_TEXTURE_2D, 0));
+    m_memory.set((u64)m_width * m_height * 4);
+
+    if (g_textureUploader) {
+        // The spans point into the archive, which may be gone by the time the worker gets to this
+        g_textureUploader->enqueue({
+            .texture = m_texture,
+            .width = (u32)m_width,
+            .height = (u32)m_height,
+            .convert = [
+                param = texture.param,
+                width = texture.width,
+                height = texture.height,
+                textureData = TextureBuffer(texture.textureData.begin(), texture.textureData.end()),
+                paletteData = TextureBuffer(texture.paletteData.begin(), texture.paletteData.end())
+            ] {
+                return decode(param, width, height, textureData, paletteData);
+            },
+            .state = m_state
+        });
+
+        return;
+    }
+
+    const auto textureData = decode(texture.param, texture.width, texture.height, texture.textureData, texture.paletteData);
+    if (!textureData.empty()) {
+        glCall(glTextureSubImage2D(
+            m_texture,
+            0,
+            0,
+            0,
+            (s32)m_width,
+            (s32)m_height,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            textureData.data()
+        ));
+    }
+
+    m_state->ready = true;
+}
+
+PixelBuffer GLTexture::decode(const SPLTextureParam& param, size_t width, size_t height, std::span<const u8> tex, std::span<const u8> pal) {
+    if (!g_textureCache || (TextureFormat)param.format == TextureFormat::None) {
+        return convert(param, width, height, tex, pal);
+    }
+
+    const u64 key = TextureCache::makeKey(param, width, height, tex, pal);
+    if (const auto blob = g_textureCache->find(key, width, height)) {
+        const auto pixels = blob->getData().subspan(TextureCache::HEADER_SIZE);
+        return { pixels.begin(), pixels.end() };
+    }
+
+    auto pixels = convert(param, width, height, tex, pal);
+    g_textureCache->store(key, width, height, pixels);
+    return pixels;
+}
+
+PixelBuffer GLTexture::convert(const SPLTextureParam& param, size_t width, size_t height, std::span<const u8> tex, std::span<const u8> pal) {
+    switch ((TextureFormat)param.format) {
+    case TextureFormat::None:
+        return {};
+    case TextureFormat::A3I5:
+        return convertA3I5(tex.data(), (const GXRgba*)pal.data(), width, height, pal.size());
+    case TextureFormat::Palette4:
+        return convertPalette4(tex.data(), (const GXRgba*)pal.data(), width, height, pal.size(), param.palColor0Transparent);
+    case TextureFormat::Palette16:
+        return convertPalette16(tex.data(), (const GXRgba*)pal.data(), width, height, pal.size(), param.palColor0Transparent);
+    case TextureFormat::Palette256:
+        return convertPalette256(tex.data(), (const GXRgba*)pal.data(), width, height, pal.size(), param.palColor0Transparent);
+    case TextureFormat::Comp4x4:
+        return convertComp4x4(tex.data(), (const GXRgba*)pal.data(), width, height, pal.size());
+    case TextureFormat::A5I3:
+        return convertA5I3(tex.data(), (const GXRgba*)pal.data(), width, height, pal.size());
+    case TextureFormat::Direct:
+        return convertDirect((const GXRgba*)tex.data(), width, height);
+    }
+
+    return {};
 }
 
 
-std::vector<u8> GLTexture::convertA3I5(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize) {
-    std::vector<u8> texture(width * height * 4);
+PixelBuffer GLTexture::convertA3I5(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize) {
+    PixelBuffer texture(width * height * 4);
     const auto pixels = reinterpret_cast<const PixelA3I5*>(tex);
 
     for (size_t i = 0; i < width * height; i++) {
@@ -210,8 +222,8 @@ std::vector<u8> GLTexture::convertA3I5(const u8* tex, const GXRgba* pal, size_t
     return texture;
 }
 
-std::vector<u8> GLTexture::convertPalette4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent) {
-    std::vector<u8> texture(width * height * 4);
+PixelBuffer GLTexture::convertPalette4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent) {
+    PixelBuffer texture(width * height * 4);
     const auto pixels = tex;
     const u8 alpha0 = color0Transparent ? 0 : 0xFF;
 
@@ -246,8 +258,8 @@ std::vector<u8> GLTexture::convertPalette4(const u8* tex, const GXRgba* pal, siz
     return texture;
 }
 
-std::vector<u8> GLTexture::convertPalette16(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent) {
-    std::vector<u8> texture(width * height * 4);
+PixelBuffer GLTexture::convertPalette16(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent) {
+    PixelBuffer texture(width * height * 4);
     const auto pixels = tex;
     const u8 alpha0 = color0Transparent ? 0 : 0xFF;
 
@@ -270,8 +282,8 @@ std::vector<u8> GLTexture::convertPalette16(const u8* tex, const GXRgba* pal, si
     return texture;
 }
 
-std::vector<u8> GLTexture::convertPalette256(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent) {
-    std::vector<u8> texture(width * height * 4);
+PixelBuffer GLTexture::convertPalette256(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent) {
+    PixelBuffer texture(width * height * 4);
     const auto pixels = tex;
     const u8 alpha0 = color0Transparent ? 0 : 0xFF;
 
@@ -287,13 +299,13 @@ std::vector<u8> GLTexture::convertPalette256(const u8* tex, const GXRgba* pal, s
     return texture;
 }
 
-std::vector<u8> GLTexture::convertComp4x4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize) {
+PixelBuffer GLTexture::convertComp4x4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize) {
     spdlog::warn("GLTexture::convertComp4x4 not implemented");
     return {};
 }
 
-std::vector<u8> GLTexture::convertA5I3(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize) {
-    std::vector<u8> texture(width * height * 4);
+PixelBuffer GLTexture::convertA5I3(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize) {
+    PixelBuffer texture(width * height * 4);
     const auto pixels = reinterpret_cast<const PixelA5I3*>(tex);
 
     for (size_t i = 0; i < width * height; i++) {
@@ -308,8 +320,8 @@ std::vector<u8> GLTexture::convertA5I3(const u8* tex, const GXRgba* pal, size_t
     return texture;
 }
 
-std::vector<u8> GLTexture::convertDirect(const GXRgba* tex, size_t width, size_t height) {
-    std::vector<u8> texture(width * height * 4);
+PixelBuffer GLTexture::convertDirect(const GXRgba* tex, size_t width, size_t height) {
+    PixelBuffer texture(width * height * 4);
 
     for (size_t i = 0; i < width * height; i++) {
         texture[i * 4 + 0] = tex[i].r8();
@@ -1,10 +1,21 @@
 #pragma once
 #include "types.h"
+#include "memory_tracker.h"
 
+#include <memory>
+#include <span>
 #include <vector>
 
 
 struct SPLTexture;
+struct SPLTextureParam;
+struct GLUploadState;
+
+// DS texture or palette data
+using TextureBuffer = memory::TrackedVector<u8, memory::Category::TextureData>;
+
+// RGBA8 pixels produced by GLTexture::convert
+using PixelBuffer = memory::TrackedVector<u8, memory::Category::DecodedPixels>;
 
 class GLTexture {
 public:
@@ -24,22 +35,34 @@ public:
     size_t getWidth() const { return m_width; }
     size_t getHeight() const { return m_height; }
     TextureFormat getFormat() const { return m_format; }
+    u64 getMemoryUsage() const { return m_memory.get(); }
+
+    // False while the pixel data is still being uploaded in the background
+    bool isReady() const;
+
+    // Same as convert, but goes through g_textureCache when there is one
+    static PixelBuffer decode(const SPLTextureParam& param, size_t width, size_t height, std::span<const u8> tex, std::span<const u8> pal);
+
+    // Converts DS texture data to RGBA8, safe to call from any thread
+    static PixelBuffer convert(const SPLTextureParam& param, size_t width, size_t height, std::span<const u8> tex, std::span<const u8> pal);
 
 private:
     void createTexture(const SPLTexture& texture);
 
-    static std::vector<u8> convertA3I5(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize);
-    static std::vector<u8> convertPalette4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent);
-    static std::vector<u8> convertPalette16(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent);
-    static std::vector<u8> convertPalette256(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent);
-    static std::vector<u8> convertComp4x4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize);
-    static std::vector<u8> convertA5I3(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize);
-    static std::vector<u8> convertDirect(const GXRgba* tex, size_t width, size_t height);
+    static PixelBuffer convertA3I5(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize);
+    static PixelBuffer convertPalette4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent);
+    static PixelBuffer convertPalette16(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent);
+    static PixelBuffer convertPalette256(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize, bool color0Transparent);
+    static PixelBuffer convertComp4x4(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize);
+    static PixelBuffer convertA5I3(const u8* tex, const GXRgba* pal, size_t width, size_t height, size_t palSize);
+    static PixelBuffer convertDirect(const GXRgba* tex, size_t width, size_t height);
 
 private:
     u32 m_texture;
     size_t m_width;
     size_t m_height;
     TextureFormat m_format;
+    std::shared_ptr<GLUploadState> m_state;
+    memory::TrackedSize m_memory = memory::TrackedSize(memory::Category::GLTextures);
 };
 
@@ -0,0 +1,43 @@
+#include "gl_texture_pool.h"
+#include "gl_texture.h"
+#include "hash.h"
+#include "spl/spl_resource.h"
+
+#include <algorithm>
+
+
+std::shared_ptr<GLTexture> GLTexturePool::acquire(const SPLTexture& texture, u64 contentHash) {
+    const u64 key = makeKey(texture, contentHash);
+
+    auto& slot = m_textures[key];
+    if (auto existing = slot.lock()) {
+        ++m_reused;
+        return existing;
+    }
+
+    auto created = std::make_shared<GLTexture>(texture);
+    slot = created;
+
+    // Entries of released textures pile up as archives are closed, sweep them now and then
+    if (m_textures.size() >= m_pruneThreshold) {
+        std::erase_if(m_textures, [](const auto& pair) { return pair.second.expired(); });
+        m_pruneThreshold = std::max<size_t>(64, m_textures.size() * 2);
+    }
+
+    return created;
+}
+
+size_t GLTexturePool::getLiveCount() const {
+    return std::ranges::count_if(m_textures, [](const auto& pair) { return !pair.second.expired(); });
+}
+
+u64 GLTexturePool::makeKey(const SPLTexture& texture, u64 contentHash) {
+    // Everything GLTexture bakes into the texture besides the data itself
+    const u64 settings = (u64)texture.param.format << 40
+        | (u64)texture.param.palColor0Transparent << 36
+        | (u64)texture.param.repeat << 32
+        | (u64)texture.width << 16
+        | (u64)texture.height;
+
+    return hash::xxh64(&settings, sizeof(settings), contentHash);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "types.h"
+
+#include <memory>
+#include <unordered_map>
+
+
+class GLTexture;
+struct SPLTexture;
+
+// Process wide pool of GL textures keyed by their contents, so textures that show up in several
+// archives (effect sets reuse the same few sparkles and smoke puffs a lot) are decoded and uploaded once.
+// The pool only holds weak references, a texture is deleted once the last archive using it lets go.
+class GLTexturePool {
+public:
+    // contentHash is SPLArchive::getTextureHash, anything else that affects the GL texture is added here
+    std::shared_ptr<GLTexture> acquire(const SPLTexture& texture, u64 contentHash);
+
+    size_t getLiveCount() const;
+    u64 getReuseCount() const { return m_reused; }
+
+private:
+    static u64 makeKey(const SPLTexture& texture, u64 contentHash);
+
+private:
+    std::unordered_map<u64, std::weak_ptr<GLTexture>> m_textures;
+    size_t m_pruneThreshold = 64;
+    u64 m_reused = 0;
+};
+
+// Main thread only, like everything else that creates GL objects.
+// Created by Application::run, batch mode creates its textures without sharing them.
+inline GLTexturePool* g_texturePool = nullptr;
@@ -0,0 +1,197 @@
+#include "gl_texture_uploader.h"
+#include "gl_util.h"
+
+#include <cstring>
+#include <gl/glew.h>
+#include <SDL2/SDL.h>
+#include <spdlog/spdlog.h>
+
+
+GLTextureUploader::GLTextureUploader(SDL_Window* window, void* mainContext) : m_window(window) {
+    // SDL_GL_CreateContext makes the new context current, so switch back right after
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    m_workerContext = SDL_GL_CreateContext(window);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(window, (SDL_GLContext)mainContext);
+
+    if (!m_workerContext) {
+        spdlog::warn("Failed to create a shared GL context, textures will be uploaded on the main thread: {}", SDL_GetError());
+    }
+
+    glCall(glGenBuffers(1, &m_pbo));
+    m_worker = std::thread(&GLTextureUploader::workerMain, this);
+}
+
+GLTextureUploader::~GLTextureUploader() {
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_condition.notify_all();
+    m_worker.join();
+
+    for (const auto& job : m_jobs) {
+        if (job.created) {
+            glCall(glDeleteSync((GLsync)job.created));
+        }
+    }
+
+    for (const auto& upload : m_inFlight) {
+        if (upload.fence) {
+            glCall(glDeleteSync((GLsync)upload.fence));
+        }
+    }
+
+    if (m_workerContext) {
+        SDL_GL_DeleteContext((SDL_GLContext)m_workerContext);
+    }
+
+    glCall(glDeleteBuffers(1, &m_pbo));
+}
+
+void GLTextureUploader::enqueue(Job job) {
+    ++m_pending;
+
+    // The texture and its storage were created on the main context. The worker context is only
+    // guaranteed to see them once it waited on a fence issued after them, and the fence has to be flushed.
+    if (m_workerContext) {
+        job.created = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glCall(glFlush());
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+
+    m_condition.notify_one();
+}
+
+void GLTextureUploader::update() {
+    std::vector<InFlight> inFlight;
+    std::vector<Converted> converted;
+
+    {
+        std::scoped_lock lock(m_mutex);
+        inFlight = std::move(m_inFlight);
+        m_inFlight.clear();
+
+        // Without a worker context the uploads happen here, limited per frame
+        size_t bytes = 0;
+        size_t count = 0;
+        while (count < m_converted.size() && (count == 0 || bytes + m_converted[count].pixels.size() <= MAIN_THREAD_BYTES_PER_FRAME)) {
+            bytes += m_converted[count].pixels.size();
+            ++count;
+        }
+
+        converted.assign(std::make_move_iterator(m_converted.begin()), std::make_move_iterator(m_converted.begin() + count));
+        m_converted.erase(m_converted.begin(), m_converted.begin() + count);
+    }
+
+    for (const auto& [job, pixels] : converted) {
+        void* fence = job.state->orphaned ? nullptr : upload(m_pbo, job, pixels);
+        inFlight.push_back({ job.texture, job.state, fence });
+    }
+
+    std::vector<InFlight> remaining;
+    for (const auto& upload : inFlight) {
+        if (upload.fence) {
+            const GLenum status = glClientWaitSync((GLsync)upload.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                remaining.push_back(upload);
+                continue;
+            }
+
+            glCall(glDeleteSync((GLsync)upload.fence));
+        }
+
+        if (upload.state->orphaned) {
+            glCall(glDeleteTextures(1, &upload.texture));
+        }
+
+        upload.state->ready = true;
+        --m_pending;
+    }
+
+    if (!remaining.empty()) {
+        std::scoped_lock lock(m_mutex);
+        m_inFlight.insert(m_inFlight.end(), remaining.begin(), remaining.end());
+    }
+}
+
+void GLTextureUploader::workerMain() {
+    u32 pbo = 0;
+    if (m_workerContext) {
+        SDL_GL_MakeCurrent(m_window, (SDL_GLContext)m_workerContext);
+        glCall(glGenBuffers(1, &pbo));
+    }
+
+    while (true) {
+        Job job;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_stop) {
+                break;
+            }
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        // Nobody is going to look at an orphaned texture, skip straight to deleting it
+        PixelBuffer pixels;
+        if (!job.state->orphaned) {
+            pixels = job.convert();
+        }
+
+        if (m_workerContext) {
+            if (job.created) {
+                glCall(glWaitSync((GLsync)job.created, 0, GL_TIMEOUT_IGNORED));
+                glCall(glDeleteSync((GLsync)job.created));
+            }
+
+            void* fence = job.state->orphaned ? nullptr : upload(pbo, job, pixels);
+
+            std::scoped_lock lock(m_mutex);
+            m_inFlight.push_back({ job.texture, job.state, fence });
+        } else {
+            std::scoped_lock lock(m_mutex);
+            m_converted.push_back({ std::move(job), std::move(pixels) });
+        }
+    }
+
+    if (m_workerContext) {
+        glCall(glDeleteBuffers(1, &pbo));
+        SDL_GL_MakeCurrent(m_window, nullptr);
+    }
+}
+
+void* GLTextureUploader::upload(u32 pbo, const Job& job, const PixelBuffer& pixels) {
+    if (pixels.empty()) {
+        return nullptr;
+    }
+
+    // Orphan the previous contents so the driver doesn't have to wait for the last upload
+    glCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo));
+    glCall(glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)pixels.size(), nullptr, GL_STREAM_DRAW));
+
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)pixels.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst) {
+        std::memcpy(dst, pixels.data(), pixels.size());
+        glCall(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+        glCall(glTextureSubImage2D(job.texture, 0, 0, 0, (s32)job.width, (s32)job.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    } else {
+        spdlog::error("Failed to map texture upload buffer");
+    }
+
+    glCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+    // The fence has to reach the GPU before another context can wait on it
+    const GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glCall(glFlush());
+
+    return fence;
+}
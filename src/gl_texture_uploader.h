@@ -0,0 +1,88 @@
+#pragma once
+
+#include "gl_texture.h"
+#include "types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct SDL_Window;
+
+// Shared between a GLTexture and its pending upload
+struct GLUploadState {
+    std::atomic<bool> ready = false;
+    std::atomic<bool> orphaned = false; // The GLTexture is gone, delete the texture once the upload is done
+};
+
+// Converts and uploads texture data off the UI thread.
+// With a shared GL context the whole upload happens on a worker thread, otherwise conversion
+// still happens on the worker and the main thread streams the results through PBOs in update().
+class GLTextureUploader {
+public:
+    struct Job {
+        u32 texture; // Storage must already be allocated (glTexStorage2D)
+        u32 width;
+        u32 height;
+        std::function<PixelBuffer()> convert; // Produces RGBA8 pixels, runs on the worker
+        std::shared_ptr<GLUploadState> state;
+        void* created = nullptr; // GLsync set by enqueue, the worker waits on it before touching the texture
+    };
+
+    // Must be called with the main context current, which the worker context will share objects with
+    GLTextureUploader(SDL_Window* window, void* mainContext);
+    ~GLTextureUploader();
+
+    GLTextureUploader(const GLTextureUploader&) = delete;
+    GLTextureUploader& operator=(const GLTextureUploader&) = delete;
+
+    // Call on the main thread right after creating the texture
+    void enqueue(Job job);
+
+    // Publishes finished uploads. Call once per frame on the main thread.
+    void update();
+
+    size_t getPendingCount() const { return m_pending; }
+    bool hasWorkerContext() const { return m_workerContext != nullptr; }
+
+private:
+    struct Converted {
+        Job job;
+        PixelBuffer pixels;
+    };
+
+    struct InFlight {
+        u32 texture;
+        std::shared_ptr<GLUploadState> state;
+        void* fence; // GLsync, null if nothing was uploaded
+    };
+
+    void workerMain();
+    static void* upload(u32 pbo, const Job& job, const PixelBuffer& pixels);
+
+private:
+    // Upper limit for PBO streaming on the main thread, so a big archive is spread over a few frames
+    static constexpr size_t MAIN_THREAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+
+    SDL_Window* m_window;
+    void* m_workerContext = nullptr; // SDL_GLContext
+    std::thread m_worker;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Job> m_jobs;
+    std::vector<Converted> m_converted; // Only used without a worker context
+    std::vector<InFlight> m_inFlight;
+    std::atomic<size_t> m_pending = 0;
+    bool m_stop = false;
+
+    u32 m_pbo = 0; // Main thread PBO
+};
+
+inline GLTextureUploader* g_textureUploader = nullptr;
@@ -1,16 +1,203 @@
 #include "gl_viewport.h"
 
+#include <algorithm>
 #include <gl/glew.h>
+#include <iterator>
 
 #include "spdlog/spdlog.h"
 
 
+namespace {
+
+// Fullscreen triangle, no vertex buffer needed
+constexpr auto s_resolveVertexShader = R"(
+#version 450 core
+
+void main() {
+    const vec2 positions[3] = vec2[](vec2(-1.0, -1.0), vec2(3.0, -1.0), vec2(-1.0, 3.0));
+    gl_Position = vec4(positions[gl_VertexID], 0.0, 1.0);
+}
+)";
+
+constexpr auto s_resolveFragmentShader = R"(
+#version 450 core
+
+layout(location = 0) out vec4 color;
+
+layout(binding = 0) uniform sampler2D accumTexture;
+layout(binding = 1) uniform sampler2D revealageTexture;
+
+void main() {
+    const ivec2 coord = ivec2(gl_FragCoord.xy);
+    const float revealage = texelFetch(revealageTexture, coord, 0).r;
+    if (revealage == 1.0) {
+        discard; // Nothing was drawn here
+    }
+
+    const vec4 accum = texelFetch(accumTexture, coord, 0);
+    color = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - revealage);
+}
+)";
+
+// Maps the per-pixel fragment count to a blue -> green -> yellow -> red -> white ramp
+constexpr auto s_heatmapFragmentShader = R"(
+#version 450 core
+
+layout(location = 0) out vec4 color;
+
+layout(binding = 0) uniform sampler2D overdrawTexture;
+
+const float MAX_OVERDRAW = 32.0;
+const vec3 RAMP[5] = vec3[](
+    vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(1.0, 1.0, 0.0),
+    vec3(1.0, 0.0, 0.0),
+    vec3(1.0, 1.0, 1.0)
+);
+
+void main() {
+    const float overdraw = texelFetch(overdrawTexture, ivec2(gl_FragCoord.xy), 0).r;
+    if (overdraw == 0.0) {
+        color = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    const float t = clamp(log2(overdraw) / log2(MAX_OVERDRAW), 0.0, 1.0) * 4.0;
+    const int i = min(int(t), 3);
+    color = vec4(mix(RAMP[i], RAMP[i + 1], t - float(i)), 1.0);
+}
+)";
+
+// Sums up the overdraw target so only a few integers have to be read back.
+// Every fragment adds exactly 1, so the counts are whole numbers.
+constexpr auto s_overdrawReduceShader = R"(
+#version 450 core
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(binding = 0) uniform sampler2D overdrawTexture;
+layout(location = 0) uniform ivec2 size;
+
+layout(std430, binding = 0) buffer Stats {
+    uint maxOverdraw;
+    uint coveredPixels;
+    uint fragments;
+};
+
+shared uint groupMax;
+shared uint groupCovered;
+shared uint groupFragments;
+
+void main() {
+    if (gl_LocalInvocationIndex == 0) {
+        groupMax = 0;
+        groupCovered = 0;
+        groupFragments = 0;
+    }
+
+    barrier();
+
+    const ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(coord, size))) {
+        const uint overdraw = uint(texelFetch(overdrawTexture, coord, 0).r);
+        if (overdraw > 0) {
+            atomicMax(groupMax, overdraw);
+            atomicAdd(groupCovered, 1);
+            atomicAdd(groupFragments, overdraw);
+        }
+    }
+
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0 && groupCovered > 0) {
+        atomicMax(maxOverdraw, groupMax);
+        atomicAdd(coveredPixels, groupCovered);
+        atomicAdd(fragments, groupFragments);
+    }
+}
+)";
+
+constexpr u32 s_reduceGroupSize = 16;
+constexpr GLsizeiptr s_statsSize = 3 * sizeof(u32);
+
+glm::ivec2 getBucketSize(const glm::vec2& size) {
+    constexpr s32 bucket = GLViewport::BUCKET_SIZE;
+    const glm::ivec2 pixels = glm::max(glm::ivec2(size), glm::ivec2(1));
+    return (pixels + bucket - 1) / bucket * bucket;
+}
+
+u32 createProgram(const char* vertexSource, const char* fragmentSource) {
+    const u32 vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vertexSource, nullptr);
+    glCompileShader(vs);
+
+    const u32 fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &fragmentSource, nullptr);
+    glCompileShader(fs);
+
+    const u32 program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+
+    s32 success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetProgramInfoLog(program, sizeof(info), nullptr, info);
+        spdlog::error("Failed to link viewport shader: {}", info);
+    }
+
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    return program;
+}
+
+u32 createComputeProgram(const char* source) {
+    const u32 cs = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(cs, 1, &source, nullptr);
+    glCompileShader(cs);
+
+    const u32 program = glCreateProgram();
+    glAttachShader(program, cs);
+    glLinkProgram(program);
+
+    s32 success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[512];
+        glGetProgramInfoLog(program, sizeof(info), nullptr, info);
+        spdlog::error("Failed to link viewport shader: {}", info);
+    }
+
+    glDeleteShader(cs);
+
+    return program;
+}
+
+}
+
+
 GLViewport::GLViewport(const glm::vec2& size) {
     m_size = size;
     createFramebuffer();
 }
 
+GLViewport::~GLViewport() {
+    release();
+}
+
 void GLViewport::bind() {
+    if (m_fbo == 0) {
+        createFramebuffer();
+    } else if (m_shrinkPending && std::chrono::steady_clock::now() - m_shrinkRequested >= SHRINK_DELAY) {
+        // The size settled in a smaller bucket, give the memory back
+        m_shrinkPending = false;
+        allocateTargets(getBucketSize(m_size));
+    }
+
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
     glViewport(0, 0, (int)m_size.s, (int)m_size.t);
 }
@@ -23,61 +210,175 @@ void GLViewport::unbind() {
 void GLViewport::resize(const glm::vec2& size) {
     m_size = size;
 
+    if (m_fbo == 0) {
+        createFramebuffer();
+        return;
+    }
+
+    const auto bucket = getBucketSize(m_size);
+    if (bucket.x > m_allocatedSize.x || bucket.y > m_allocatedSize.y) {
+        m_shrinkPending = false;
+        allocateTargets(bucket);
+    } else if (bucket != m_allocatedSize) {
+        // Dragging a splitter back and forth shouldn't reallocate, only shrink once the size stays put
+        if (!m_shrinkPending) {
+            m_shrinkPending = true;
+            m_shrinkRequested = std::chrono::steady_clock::now();
+        }
+    } else {
+        m_shrinkPending = false;
+    }
+}
+
+glm::vec2 GLViewport::getUVScale() const {
+    if (m_allocatedSize.x == 0 || m_allocatedSize.y == 0) {
+        return { 1.0f, 1.0f };
+    }
+
+    return m_size / glm::vec2(m_allocatedSize);
+}
+
+void GLViewport::beginTransparency() {
+    if (m_oitFbo == 0) {
+        createTransparencyTargets();
+    }
+
+    constexpr f32 accumClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    constexpr f32 revealageClear[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_oitFbo);
+    glViewport(0, 0, (int)m_size.s, (int)m_size.t);
+    glClearBufferfv(GL_COLOR, 0, accumClear);
+    glClearBufferfv(GL_COLOR, 1, revealageClear);
+}
+
+void GLViewport::resolveTransparency() {
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
-    glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(
-        GL_TEXTURE_2D, 
-        0, 
-        GL_RGB, 
-        (int)m_size.s, 
-        (int)m_size.t, 
-        0, 
-        GL_RGB, 
-        GL_UNSIGNED_BYTE, 
-        nullptr
-    );
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(
-        GL_FRAMEBUFFER, 
-        GL_COLOR_ATTACHMENT0, 
-        GL_TEXTURE_2D, 
-        m_texture, 
-        0
-    );
+    glBindTextureUnit(0, m_accumTexture);
+    glBindTextureUnit(1, m_revealageTexture);
+    drawFullscreen(m_resolveShader);
+    glBindTextureUnit(0, 0);
+    glBindTextureUnit(1, 0);
+}
 
-    glBindRenderbuffer(GL_RENDERBUFFER, m_rbo);
-    glRenderbufferStorage(
-        GL_RENDERBUFFER, 
-        GL_DEPTH24_STENCIL8, 
-        (int)m_size.s, 
-        (int)m_size.t
-    );
-    glFramebufferRenderbuffer(
-        GL_FRAMEBUFFER, 
-        GL_DEPTH_STENCIL_ATTACHMENT, 
-        GL_RENDERBUFFER, 
-        m_rbo
-    );
+void GLViewport::beginOverdraw() {
+    if (m_overdrawFbo == 0) {
+        createOverdrawTarget();
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    constexpr f32 clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_overdrawFbo);
+    glViewport(0, 0, (int)m_size.s, (int)m_size.t);
+    glClearBufferfv(GL_COLOR, 0, clear);
+}
+
+OverdrawStats GLViewport::resolveOverdraw() {
+    // Picks up the last reduction once the GPU is done with it, the stats keep their previous values until then
+    if (m_statsFence) {
+        const GLenum status = glClientWaitSync((GLsync)m_statsFence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glDeleteSync((GLsync)m_statsFence);
+            m_statsFence = nullptr;
+
+            m_overdrawStats.maxOverdraw = (f32)m_mappedStats[0];
+            m_overdrawStats.coveredPixels = m_mappedStats[1];
+            m_overdrawStats.fragments = m_mappedStats[2];
+            m_overdrawStats.averageOverdraw = m_overdrawStats.coveredPixels > 0
+                ? (f32)((f64)m_overdrawStats.fragments / m_overdrawStats.coveredPixels)
+                : 0.0f;
+        }
+    }
+
+    glBindTextureUnit(0, m_overdrawTexture);
+
+    // Only the part covered by the viewport, the rest of the bucket holds stale counts
+    if (!m_statsFence) {
+        const s32 width = std::max(std::min((s32)m_size.s, m_allocatedSize.x), 0);
+        const s32 height = std::max(std::min((s32)m_size.t, m_allocatedSize.y), 0);
+
+        constexpr u32 zero = 0;
+        glClearNamedBufferData(m_statsBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+        glUseProgram(m_reduceShader);
+        glUniform2i(0, width, height);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_statsBuffer);
+        glDispatchCompute((width + s_reduceGroupSize - 1) / s_reduceGroupSize, (height + s_reduceGroupSize - 1) / s_reduceGroupSize, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glUseProgram(0);
+
+        glCopyNamedBufferSubData(m_statsBuffer, m_statsReadback, 0, 0, s_statsSize);
+        m_statsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    drawFullscreen(m_heatmapShader);
+    glBindTextureUnit(0, 0);
+
+    return m_overdrawStats;
+}
+
+void GLViewport::release() {
+    const u32 framebuffers[] = { m_fbo, m_oitFbo, m_overdrawFbo };
+    const u32 textures[] = { m_texture, m_accumTexture, m_revealageTexture, m_overdrawTexture };
+
+    // Zero names are silently ignored
+    glDeleteFramebuffers((s32)std::size(framebuffers), framebuffers);
+    glDeleteTextures((s32)std::size(textures), textures);
+    glDeleteRenderbuffers(1, &m_rbo);
+    glDeleteProgram(m_resolveShader);
+    glDeleteProgram(m_heatmapShader);
+    glDeleteProgram(m_reduceShader);
+    glDeleteVertexArrays(1, &m_fullscreenVao);
+
+    if (m_statsFence) {
+        glDeleteSync((GLsync)m_statsFence);
+    }
+
+    if (m_statsReadback) {
+        glUnmapNamedBuffer(m_statsReadback);
+    }
+
+    const u32 buffers[] = { m_statsBuffer, m_statsReadback };
+    glDeleteBuffers((s32)std::size(buffers), buffers);
+
+    m_fbo = m_texture = m_rbo = 0;
+    m_allocatedSize = { 0, 0 };
+    m_shrinkPending = false;
+    m_oitFbo = m_accumTexture = m_revealageTexture = m_resolveShader = 0;
+    m_overdrawFbo = m_overdrawTexture = m_heatmapShader = 0;
+    m_fullscreenVao = 0;
+
+    m_reduceShader = m_statsBuffer = m_statsReadback = 0;
+    m_mappedStats = nullptr;
+    m_statsFence = nullptr;
+    m_overdrawStats = {};
+    m_memory.set(0);
 }
 
 void GLViewport::createFramebuffer() {
     glGenFramebuffers(1, &m_fbo);
+    glGenTextures(1, &m_texture);
+    glGenRenderbuffers(1, &m_rbo);
+
+    m_shrinkPending = false;
+    allocateTargets(getBucketSize(m_size));
+}
+
+void GLViewport::allocateTargets(const glm::ivec2& size) {
+    m_allocatedSize = size;
+
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
-    glGenTextures(1, &m_texture);
     glBindTexture(GL_TEXTURE_2D, m_texture);
     glTexImage2D(
         GL_TEXTURE_2D, 
         0, 
         GL_RGB, 
-        (int)m_size.s, 
-        (int)m_size.t, 
+        m_allocatedSize.x, 
+        m_allocatedSize.y, 
         0, 
         GL_RGB, 
         GL_UNSIGNED_BYTE, 
@@ -93,13 +394,12 @@ void GLViewport::createFramebuffer() {
         0
     );
 
-    glGenRenderbuffers(1, &m_rbo);
     glBindRenderbuffer(GL_RENDERBUFFER, m_rbo);
     glRenderbufferStorage(
         GL_RENDERBUFFER, 
         GL_DEPTH24_STENCIL8, 
-        (int)m_size.s, 
-        (int)m_size.t
+        m_allocatedSize.x, 
+        m_allocatedSize.y
     );
     glFramebufferRenderbuffer(
         GL_FRAMEBUFFER, 
@@ -110,10 +410,129 @@ void GLViewport::createFramebuffer() {
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         spdlog::error("Framebuffer incomplete");
-        return;
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (m_oitFbo != 0) {
+        resizeTransparencyTargets();
+    }
+
+    if (m_overdrawFbo != 0) {
+        resizeOverdrawTarget();
+    }
+
+    updateMemoryUsage();
+}
+
+void GLViewport::createTransparencyTargets() {
+    glGenFramebuffers(1, &m_oitFbo);
+    glGenTextures(1, &m_accumTexture);
+    glGenTextures(1, &m_revealageTexture);
+    resizeTransparencyTargets();
+    updateMemoryUsage();
+
+    m_resolveShader = createProgram(s_resolveVertexShader, s_resolveFragmentShader);
+}
+
+void GLViewport::resizeTransparencyTargets() {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_oitFbo);
+
+    // Accumulation needs the range of a float target, the weights go up to 3000
+    glBindTexture(GL_TEXTURE_2D, m_accumTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_allocatedSize.x, m_allocatedSize.y, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumTexture, 0);
+
+    glBindTexture(GL_TEXTURE_2D, m_revealageTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, m_allocatedSize.x, m_allocatedSize.y, 0, GL_RED, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_revealageTexture, 0);
+
+    // Shares the depth buffer with the main framebuffer so opaque geometry still occludes
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo);
+
+    constexpr GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        spdlog::error("Transparency framebuffer incomplete");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLViewport::createOverdrawTarget() {
+    glGenFramebuffers(1, &m_overdrawFbo);
+    glGenTextures(1, &m_overdrawTexture);
+    resizeOverdrawTarget();
+    updateMemoryUsage();
+
+    m_heatmapShader = createProgram(s_resolveVertexShader, s_heatmapFragmentShader);
+    m_reduceShader = createComputeProgram(s_overdrawReduceShader);
+
+    constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &m_statsBuffer);
+    glNamedBufferStorage(m_statsBuffer, s_statsSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &m_statsReadback);
+    glNamedBufferStorage(m_statsReadback, s_statsSize, nullptr, flags);
+    m_mappedStats = (const u32*)glMapNamedBufferRange(m_statsReadback, 0, s_statsSize, flags);
+}
+
+void GLViewport::resizeOverdrawTarget() {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_overdrawFbo);
+
+    // Float target so the count can't saturate, each fragment adds exactly 1
+    glBindTexture(GL_TEXTURE_2D, m_overdrawTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_allocatedSize.x, m_allocatedSize.y, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_overdrawTexture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        spdlog::error("Overdraw framebuffer incomplete");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLViewport::drawFullscreen(u32 program) {
+    // Core profile requires a VAO to be bound even when no attributes are used
+    if (m_fullscreenVao == 0) {
+        glGenVertexArrays(1, &m_fullscreenVao);
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(program);
+    glBindVertexArray(m_fullscreenVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void GLViewport::updateMemoryUsage() {
+    if (m_fbo == 0) {
+        m_memory.set(0);
+        return;
+    }
+
+    // RGB8 color is stored as RGBA8, plus DEPTH24_STENCIL8
+    u64 bytesPerPixel = 4 + 4;
+    if (m_oitFbo != 0) {
+        bytesPerPixel += 8 + 2; // RGBA16F accumulation, R16F revealage
+    }
+
+    if (m_overdrawFbo != 0) {
+        bytesPerPixel += 4; // R32F
+    }
+
+    m_memory.set((u64)m_allocatedSize.x * (u64)m_allocatedSize.y * bytesPerPixel);
 }
@@ -1,19 +1,46 @@
 #pragma once
 
+#include "memory_tracker.h"
 #include "types.h"
 
+#include <chrono>
 #include <glm/glm.hpp>
 
 
+struct OverdrawStats {
+    f32 maxOverdraw; // Highest number of fragments written to a single pixel
+    f32 averageOverdraw; // Average over all pixels that were written at least once
+    u64 coveredPixels;
+    u64 fragments;
+};
+
 class GLViewport {
 public:
     GLViewport(const glm::vec2& size);
+    ~GLViewport();
+
+    GLViewport(const GLViewport&) = delete;
+    GLViewport& operator=(const GLViewport&) = delete;
 
     void bind();
     void unbind();
 
+    // The render targets are allocated in steps of BUCKET_SIZE pixels and only reallocated when the size
+    // outgrows the bucket, or after it stayed in a smaller bucket for a while. Rendering covers the bottom left
+    // getSize() pixels of the targets, display the texture with getUVScale().
     void resize(const glm::vec2& size);
 
+    // Weighted blended order independent transparency.
+    // beginTransparency redirects rendering into the accumulation and revealage targets,
+    // resolveTransparency composites them back onto the viewport texture.
+    void beginTransparency();
+    void resolveTransparency();
+
+    // Counts fragments per pixel, resolveOverdraw displays them as a heatmap.
+    // The stats are summed up on the GPU and arrive a frame or two late, so the pipeline never stalls.
+    void beginOverdraw();
+    OverdrawStats resolveOverdraw();
+
     glm::vec2 getSize() const {
         return m_size;
     }
@@ -22,12 +49,61 @@ public:
         return m_texture;
     }
 
+    // Part of the texture covered by the viewport, as uv1 for ImGui::Image
+    glm::vec2 getUVScale() const;
+
+    glm::ivec2 getAllocatedSize() const {
+        return m_allocatedSize;
+    }
+
+    // Deletes every GL object, the framebuffer is created again by the next bind or resize
+    void release();
+    bool isAllocated() const { return m_fbo != 0; }
+
+    // Size of the render targets as allocated, drivers are free to pad them
+    u64 getMemoryUsage() const { return m_memory.get(); }
+
+    static constexpr s32 BUCKET_SIZE = 256;
+    static constexpr std::chrono::milliseconds SHRINK_DELAY = std::chrono::seconds(2);
+
 private:
     void createFramebuffer();
+    void allocateTargets(const glm::ivec2& size);
+    void createTransparencyTargets();
+    void resizeTransparencyTargets();
+    void createOverdrawTarget();
+    void resizeOverdrawTarget();
+    void drawFullscreen(u32 program);
+    void updateMemoryUsage();
 
 private:
     glm::vec2 m_size;
+    glm::ivec2 m_allocatedSize = { 0, 0 };
+    bool m_shrinkPending = false;
+    std::chrono::steady_clock::time_point m_shrinkRequested;
+
     u32 m_fbo = 0;
     u32 m_texture = 0;
     u32 m_rbo = 0;
+
+    // Created on first use of beginTransparency
+    u32 m_oitFbo = 0;
+    u32 m_accumTexture = 0;
+    u32 m_revealageTexture = 0;
+    u32 m_resolveShader = 0;
+
+    // Created on first use of beginOverdraw
+    u32 m_overdrawFbo = 0;
+    u32 m_overdrawTexture = 0;
+    u32 m_heatmapShader = 0;
+    u32 m_reduceShader = 0;
+    u32 m_statsBuffer = 0; // Written by the reduction
+    u32 m_statsReadback = 0; // Persistently mapped copy, guarded by m_statsFence
+    const u32* m_mappedStats = nullptr;
+    void* m_statsFence = nullptr; // GLsync
+    OverdrawStats m_overdrawStats = {};
+
+    u32 m_fullscreenVao = 0;
+
+    memory::TrackedSize m_memory = memory::TrackedSize(memory::Category::Framebuffers);
 };
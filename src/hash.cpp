@@ -0,0 +1,101 @@
+#include "hash.h"
+
+#include <bit>
+#include <cstring>
+
+
+namespace {
+
+constexpr u64 s_prime1 = 0x9E3779B185EBCA87;
+constexpr u64 s_prime2 = 0xC2B2AE3D27D4EB4F;
+constexpr u64 s_prime3 = 0x165667B19E3779F9;
+constexpr u64 s_prime4 = 0x85EBCA77C2B2AE63;
+constexpr u64 s_prime5 = 0x27D4EB2F165667C5;
+
+// Little endian reads, which is what the DS data and every platform we build for use
+inline u64 read64(const u8* p) {
+    u64 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline u32 read32(const u8* p) {
+    u32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline u64 round(u64 acc, u64 input) {
+    acc += input * s_prime2;
+    acc = std::rotl(acc, 31);
+    return acc * s_prime1;
+}
+
+inline u64 mergeRound(u64 acc, u64 value) {
+    acc ^= round(0, value);
+    return acc * s_prime1 + s_prime4;
+}
+
+}
+
+
+namespace hash {
+
+u64 xxh64(const void* data, size_t size, u64 seed) {
+    const u8* p = (const u8*)data;
+    const u8* const end = p + size;
+    u64 h;
+
+    if (size >= 32) {
+        u64 v1 = seed + s_prime1 + s_prime2;
+        u64 v2 = seed + s_prime2;
+        u64 v3 = seed;
+        u64 v4 = seed - s_prime1;
+
+        // Four independent lanes so the multiplies can overlap
+        const u8* const limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + s_prime5;
+    }
+
+    h += (u64)size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = std::rotl(h, 27) * s_prime1 + s_prime4;
+    }
+
+    if (p + 4 <= end) {
+        h ^= (u64)read32(p) * s_prime1;
+        h = std::rotl(h, 23) * s_prime2 + s_prime3;
+        p += 4;
+    }
+
+    for (; p < end; p++) {
+        h ^= *p * s_prime5;
+        h = std::rotl(h, 11) * s_prime1;
+    }
+
+    h ^= h >> 33;
+    h *= s_prime2;
+    h ^= h >> 29;
+    h *= s_prime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+}
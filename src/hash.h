@@ -0,0 +1,18 @@
+#pragma once
+
+#include "types.h"
+
+#include <span>
+
+
+// Content hashing for dedupe and change detection, not suitable for anything security related
+namespace hash {
+
+// XXH64, produces the same values as the reference implementation
+u64 xxh64(const void* data, size_t size, u64 seed = 0);
+
+inline u64 xxh64(std::span<const u8> data, u64 seed = 0) {
+    return xxh64(data.data(), data.size(), seed);
+}
+
+}
@@ -0,0 +1,158 @@
+#include "lz.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+
+// Neither format can expand a single bit of flags into more than this, anything larger is garbage
+constexpr size_t s_maxRatio = 8 * 0x10110 / 33;
+constexpr size_t s_maxSize = 256 * 1024 * 1024;
+
+// Back references may overlap the bytes they produce (distance < length),
+// in which case the copy has to run byte by byte to repeat the pattern
+inline void copyMatch(u8* out, size_t distance, size_t length) {
+    const u8* src = out - distance;
+    if (distance >= length) {
+        std::memcpy(out, src, length);
+        return;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        out[i] = src[i];
+    }
+}
+
+}
+
+
+namespace lz {
+
+std::optional<Header> readHeader(std::span<const u8> data) {
+    if (data.size() < 4 || (data[0] != (u8)Type::LZ10 && data[0] != (u8)Type::LZ11)) {
+        return std::nullopt;
+    }
+
+    Header header = { .type = (Type)data[0], .size = 0, .headerSize = 4 };
+    header.size = data[1] | data[2] << 8 | data[3] << 16;
+
+    if (header.size == 0) {
+        if (data.size() < 8) {
+            return std::nullopt;
+        }
+
+        header.size = data[4] | data[5] << 8 | data[6] << 16 | (size_t)data[7] << 24;
+        header.headerSize = 8;
+    }
+
+    if (header.size == 0 || header.size > s_maxSize || header.size / s_maxRatio > data.size()) {
+        return std::nullopt;
+    }
+
+    return header;
+}
+
+bool isCompressed(std::span<const u8> data) {
+    return readHeader(data).has_value();
+}
+
+bool decompress(std::span<const u8> data, const Header& header, std::span<u8> output) {
+    if (output.size() > header.size) {
+        return false;
+    }
+
+    const u8* in = data.data() + header.headerSize;
+    const u8* const inEnd = data.data() + data.size();
+    u8* const outBegin = output.data();
+    u8* out = outBegin;
+    u8* const outEnd = outBegin + output.size();
+
+    const bool extended = header.type == Type::LZ11;
+
+    while (out < outEnd) {
+        if (in >= inEnd) {
+            return false;
+        }
+
+        u8 flags = *in++;
+
+        // Each flag bit, MSB first, says whether the next block is a literal (0) or a back reference (1)
+        for (int bit = 0; bit < 8 && out < outEnd; bit++, flags <<= 1) {
+            if (!(flags & 0x80)) {
+                if (in >= inEnd) {
+                    return false;
+                }
+
+                *out++ = *in++;
+                continue;
+            }
+
+            if (inEnd - in < 2) {
+                return false;
+            }
+
+            size_t length;
+            size_t distance;
+
+            if (!extended) {
+                length = (in[0] >> 4) + 3;
+                distance = ((in[0] & 0xF) << 8 | in[1]) + 1;
+                in += 2;
+            } else {
+                switch (in[0] >> 4) {
+                case 0:
+                    if (inEnd - in < 3) {
+                        return false;
+                    }
+
+                    length = ((in[0] & 0xF) << 4 | in[1] >> 4) + 0x11;
+                    distance = ((in[1] & 0xF) << 8 | in[2]) + 1;
+                    in += 3;
+                    break;
+                case 1:
+                    if (inEnd - in < 4) {
+                        return false;
+                    }
+
+                    length = ((in[0] & 0xF) << 12 | in[1] << 4 | in[2] >> 4) + 0x111;
+                    distance = ((in[2] & 0xF) << 8 | in[3]) + 1;
+                    in += 4;
+                    break;
+                default:
+                    length = (in[0] >> 4) + 1;
+                    distance = ((in[0] & 0xF) << 8 | in[1]) + 1;
+                    in += 2;
+                    break;
+                }
+            }
+
+            if (distance > (size_t)(out - outBegin)) {
+                return false;
+            }
+
+            // Matches can run past the end when only a prefix is decoded or the encoder padded the last block
+            length = std::min(length, (size_t)(outEnd - out));
+            copyMatch(out, distance, length);
+            out += length;
+        }
+    }
+
+    return true;
+}
+
+std::optional<std::vector<u8>> decompress(std::span<const u8> data) {
+    const auto header = readHeader(data);
+    if (!header) {
+        return std::nullopt;
+    }
+
+    std::vector<u8> output(header->size);
+    if (!decompress(data, *header, output)) {
+        return std::nullopt;
+    }
+
+    return output;
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "types.h"
+
+#include <optional>
+#include <span>
+#include <vector>
+
+
+// Decoder for the LZ77 variants of the DS BIOS (LZ10 and LZ11).
+// Compressed data starts with a type byte and the 24 bit decompressed size,
+// a size of 0 means the real size follows as a 32 bit value.
+namespace lz {
+
+enum class Type : u8 {
+    LZ10 = 0x10,
+    LZ11 = 0x11
+};
+
+struct Header {
+    Type type;
+    size_t size; // Decompressed size
+    size_t headerSize; // Offset of the first block
+};
+
+// Returns nothing if the data doesn't look like LZ10/LZ11 compressed data
+std::optional<Header> readHeader(std::span<const u8> data);
+
+bool isCompressed(std::span<const u8> data);
+
+// Decodes into output, which can be smaller than header.size to only decode the start of the data.
+// Returns false if the data is truncated or references bytes before the start of the output.
+bool decompress(std::span<const u8> data, const Header& header, std::span<u8> output);
+
+// Convenience overload that allocates the output, returns nothing on failure
+std::optional<std::vector<u8>> decompress(std::span<const u8> data);
+
+}
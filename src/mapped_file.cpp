@@ -0,0 +1,142 @@
+#include "mapped_file.h"
+
+#include <spdlog/spdlog.h>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    open(path);
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_isEmpty = std::exchange(other.m_isEmpty, false);
+#ifdef _WIN32
+        m_file = std::exchange(other.m_file, nullptr);
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+
+    return *this;
+}
+
+bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        spdlog::error("Failed to open file: {}", path.string());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    if (size.QuadPart == 0) {
+        m_isEmpty = true;
+        return true;
+    }
+
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        spdlog::error("Failed to map file: {}", path.string());
+        close();
+        return false;
+    }
+
+    m_data = (const u8*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        spdlog::error("Failed to map file: {}", path.string());
+        close();
+        return false;
+    }
+
+    m_size = (size_t)size.QuadPart;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error("Failed to open file: {}", path.string());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        ::close(fd);
+        m_isEmpty = true;
+        return true;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        spdlog::error("Failed to map file: {}", path.string());
+        return false;
+    }
+
+    m_data = (const u8*)data;
+    m_size = (size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+
+    if (m_file) {
+        CloseHandle(m_file);
+    }
+
+    m_file = nullptr;
+    m_mapping = nullptr;
+#else
+    if (m_data) {
+        munmap((void*)m_data, m_size);
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_isEmpty = false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <span>
+
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr || m_isEmpty; }
+    std::span<const u8> getData() const { return { m_data, m_size }; }
+    size_t getSize() const { return m_size; }
+
+private:
+    const u8* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_isEmpty = false; // Empty files can't be mapped but are still valid
+
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,131 @@
+#include "memory_tracker.h"
+
+#include <array>
+#include <atomic>
+#include <fmt/format.h>
+#include <utility>
+
+
+namespace {
+
+struct Counter {
+    std::atomic<u64> current = 0;
+    std::atomic<u64> peak = 0;
+    std::atomic<u64> allocations = 0;
+};
+
+std::array<Counter, memory::CATEGORY_COUNT> s_counters;
+
+constexpr std::array s_names = {
+    "Archive data",
+    "Texture data",
+    "Decoded pixels",
+    "Particle pool",
+    "Instance data",
+    "GL textures",
+    "GL buffers",
+    "Framebuffers"
+};
+
+static_assert(s_names.size() == memory::CATEGORY_COUNT);
+
+}
+
+
+namespace memory {
+
+void track(Category category, u64 bytes) {
+    auto& counter = s_counters[(size_t)category];
+    const u64 current = counter.current += bytes;
+    ++counter.allocations;
+
+    u64 peak = counter.peak;
+    while (current > peak && !counter.peak.compare_exchange_weak(peak, current)) {}
+}
+
+void untrack(Category category, u64 bytes) {
+    s_counters[(size_t)category].current -= bytes;
+}
+
+u64 getCurrent(Category category) {
+    return s_counters[(size_t)category].current;
+}
+
+u64 getPeak(Category category) {
+    return s_counters[(size_t)category].peak;
+}
+
+u64 getAllocationCount(Category category) {
+    return s_counters[(size_t)category].allocations;
+}
+
+const char* getName(Category category) {
+    return s_names[(size_t)category];
+}
+
+bool isGPU(Category category) {
+    return category == Category::GLTextures || category == Category::GLBuffers || category == Category::Framebuffers;
+}
+
+std::string formatSize(u64 bytes) {
+    if (bytes < 1024) {
+        return fmt::format("{} B", bytes);
+    }
+
+    if (bytes < 1024 * 1024) {
+        return fmt::format("{:.1f} KB", bytes / 1024.0);
+    }
+
+    return fmt::format("{:.1f} MB", bytes / (1024.0 * 1024.0));
+}
+
+u64 Usage::getTotal() const {
+    u64 total = 0;
+    for (const u64 size : bytes) {
+        total += size;
+    }
+
+    return total;
+}
+
+u64 Usage::getGPUTotal() const {
+    u64 total = 0;
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        if (isGPU((Category)i)) {
+            total += bytes[i];
+        }
+    }
+
+    return total;
+}
+
+TrackedSize::TrackedSize(TrackedSize&& other) noexcept
+    : m_category(other.m_category), m_bytes(std::exchange(other.m_bytes, 0)) {}
+
+TrackedSize& TrackedSize::operator=(TrackedSize&& other) noexcept {
+    if (this != &other) {
+        set(0);
+        m_category = other.m_category;
+        m_bytes = std::exchange(other.m_bytes, 0);
+    }
+
+    return *this;
+}
+
+void TrackedSize::set(u64 bytes) {
+    if (bytes == m_bytes) {
+        return;
+    }
+
+    if (m_bytes > 0) {
+        untrack(m_category, m_bytes);
+    }
+
+    if (bytes > 0) {
+        track(m_category, bytes);
+    }
+
+    m_bytes = bytes;
+}
+
+}
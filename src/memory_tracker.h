@@ -0,0 +1,114 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Bytes in use per subsystem. The numbers come from the allocations themselves: containers allocate
+// through TrackedAllocator, GL objects and other one-off allocations record their size in a TrackedSize.
+// Safe to use from any thread.
+namespace memory {
+
+enum class Category : u8 {
+    ArchiveData, // Parsed resources, and file contents while they are being parsed
+    TextureData, // DS texture and palette data
+    DecodedPixels, // RGBA8 conversions on their way to the GPU or the texture cache
+    ParticlePool, // CPU particles
+    InstanceData, // CPU side instance lists of the particle renderers
+    GLTextures,
+    GLBuffers, // Particle geometry, instance and GPU simulator buffers
+    Framebuffers, // Viewport render targets
+
+    Count
+};
+
+constexpr size_t CATEGORY_COUNT = (size_t)Category::Count;
+
+void track(Category category, u64 bytes);
+void untrack(Category category, u64 bytes);
+
+u64 getCurrent(Category category);
+u64 getPeak(Category category);
+u64 getAllocationCount(Category category); // Since startup
+
+const char* getName(Category category);
+bool isGPU(Category category);
+
+// "512 B", "3.2 KB", "41.0 MB"
+std::string formatSize(u64 bytes);
+
+template<typename T, Category C>
+struct TrackedAllocator {
+    using value_type = T;
+
+    // The category is a non-type parameter, which std::allocator_traits can't rebind on its own
+    template<typename U>
+    struct rebind {
+        using other = TrackedAllocator<U, C>;
+    };
+
+    TrackedAllocator() = default;
+
+    template<typename U>
+    TrackedAllocator(const TrackedAllocator<U, C>&) noexcept {}
+
+    T* allocate(size_t count) {
+        T* data = std::allocator<T>().allocate(count);
+        track(C, count * sizeof(T));
+        return data;
+    }
+
+    void deallocate(T* data, size_t count) noexcept {
+        untrack(C, count * sizeof(T));
+        std::allocator<T>().deallocate(data, count);
+    }
+
+    template<typename U>
+    bool operator==(const TrackedAllocator<U, C>&) const noexcept { return true; }
+};
+
+template<typename T, Category C>
+using TrackedVector = std::vector<T, TrackedAllocator<T, C>>;
+
+// Same number the allocator tracked for the vector
+template<typename T, Category C>
+u64 getSize(const std::vector<T, TrackedAllocator<T, C>>& vector) {
+    return vector.capacity() * sizeof(T);
+}
+
+// Bytes per category held by a single owner, e.g. an editor tab
+struct Usage {
+    std::array<u64, CATEGORY_COUNT> bytes = {};
+
+    u64& operator[](Category category) { return bytes[(size_t)category]; }
+    u64 operator[](Category category) const { return bytes[(size_t)category]; }
+
+    u64 getTotal() const;
+    u64 getGPUTotal() const;
+};
+
+// Size of an allocation the tracker can't see by itself, like the storage of a GL object.
+// Belongs to the object owning the allocation and untracks the size when that object goes away.
+class TrackedSize {
+public:
+    explicit TrackedSize(Category category) : m_category(category) {}
+    ~TrackedSize() { set(0); }
+
+    TrackedSize(const TrackedSize&) = delete;
+    TrackedSize& operator=(const TrackedSize&) = delete;
+    TrackedSize(TrackedSize&& other) noexcept;
+    TrackedSize& operator=(TrackedSize&& other) noexcept;
+
+    void set(u64 bytes);
+    u64 get() const { return m_bytes; }
+
+private:
+    Category m_category;
+    u64 m_bytes = 0;
+};
+
+}
@@ -0,0 +1,85 @@
+#include "narc.h"
+
+#include <spdlog/spdlog.h>
+
+
+namespace {
+
+struct NarcHeader {
+    u32 magic;
+    u16 byteOrder;
+    u16 version;
+    u32 fileSize;
+    u16 headerSize;
+    u16 sectionCount;
+};
+
+struct SectionHeader {
+    u32 magic;
+    u32 size; // Including this header
+};
+
+}
+
+
+bool NarcArchive::open(const std::filesystem::path& path) {
+    return map(path) && parse();
+}
+
+bool NarcArchive::open(std::span<const u8> data) {
+    m_path.clear();
+    m_data = data;
+    return parse();
+}
+
+bool NarcArchive::isNarc(std::span<const u8> data) {
+    u32 magic;
+    return read(data, 0, magic) && magic == NARC_MAGIC;
+}
+
+bool NarcArchive::parse() {
+    NarcHeader header;
+    if (!read(m_data, 0, header) || header.magic != NARC_MAGIC) {
+        spdlog::error("Not a NARC file: {}", m_path.string());
+        return false;
+    }
+
+    std::span<const u8> fat;
+    std::span<const u8> fnt;
+    size_t imageOffset = 0;
+
+    size_t offset = header.headerSize;
+    for (u16 i = 0; i < header.sectionCount; i++) {
+        SectionHeader section;
+        if (!read(m_data, offset, section) || section.size < sizeof(SectionHeader) || section.size > m_data.size() - offset) {
+            spdlog::error("Truncated NARC file: {}", m_path.string());
+            return false;
+        }
+
+        const auto contents = m_data.subspan(offset + sizeof(SectionHeader), section.size - sizeof(SectionHeader));
+        switch (section.magic) {
+        case FATB_MAGIC:
+            fat = contents;
+            break;
+        case FNTB_MAGIC:
+            fnt = contents;
+            break;
+        case FIMG_MAGIC:
+            imageOffset = offset + sizeof(SectionHeader);
+            break;
+        default:
+            break;
+        }
+
+        offset += section.size;
+    }
+
+    // The FAT starts with the file count, followed by (start, end) pairs relative to the FIMG
+    u16 fileCount;
+    if (!read(fat, 0, fileCount) || fat.size() < 4 + fileCount * 8ull || imageOffset == 0) {
+        spdlog::error("Invalid NARC file: {}", m_path.string());
+        return false;
+    }
+
+    return readTables(fat.subspan(4, fileCount * 8ull), fnt, imageOffset);
+}
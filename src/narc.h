@@ -0,0 +1,28 @@
+#pragma once
+
+#include "nitro_fs.h"
+
+#include <filesystem>
+#include <span>
+
+
+// Nitro archive (.narc), the container most DS games keep their data files in
+class NarcArchive : public NitroFS {
+public:
+    // Maps the file, its files stay valid as long as the archive
+    bool open(const std::filesystem::path& path);
+
+    // Reads an archive that is already in memory, data has to outlive the archive
+    bool open(std::span<const u8> data);
+
+    static bool isNarcFile(const std::filesystem::path& path) { return path.extension() == ".narc"; }
+    static bool isNarc(std::span<const u8> data);
+
+private:
+    static constexpr u32 NARC_MAGIC = 0x4352414E; // 'NARC'
+    static constexpr u32 FATB_MAGIC = 0x46415442; // 'BTAF'
+    static constexpr u32 FNTB_MAGIC = 0x464E5442; // 'BTNF'
+    static constexpr u32 FIMG_MAGIC = 0x46494D47; // 'GMIF'
+
+    bool parse();
+};
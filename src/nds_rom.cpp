@@ -0,0 +1,50 @@
+#include "nds_rom.h"
+
+#include <spdlog/spdlog.h>
+
+
+namespace {
+
+// The part of the cartridge header pointing at the file system
+struct RomTables {
+    u32 fntOffset;
+    u32 fntSize;
+    u32 fatOffset;
+    u32 fatSize;
+};
+
+constexpr size_t s_tablesOffset = 0x40;
+constexpr size_t s_headerSize = 0x200;
+
+}
+
+
+bool NdsRom::open(const std::filesystem::path& path) {
+    return map(path) && parse();
+}
+
+bool NdsRom::open(std::span<const u8> data) {
+    m_path.clear();
+    m_data = data;
+    return parse();
+}
+
+bool NdsRom::parse() {
+    RomTables tables;
+    if (m_data.size() < s_headerSize || !read(m_data, s_tablesOffset, tables)) {
+        spdlog::error("Not an NDS ROM: {}", m_path.string());
+        return false;
+    }
+
+    const auto inBounds = [this](u32 offset, u32 size) {
+        return offset >= s_headerSize && offset <= m_data.size() && size <= m_data.size() - offset;
+    };
+
+    if (!inBounds(tables.fntOffset, tables.fntSize) || !inBounds(tables.fatOffset, tables.fatSize) || tables.fatSize % 8 != 0) {
+        spdlog::error("Invalid NDS ROM: {}", m_path.string());
+        return false;
+    }
+
+    // ROM FAT entries are absolute offsets
+    return readTables(m_data.subspan(tables.fatOffset, tables.fatSize), m_data.subspan(tables.fntOffset, tables.fntSize), 0);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "nitro_fs.h"
+
+#include <filesystem>
+#include <span>
+
+
+// NitroFS of an NDS ROM image, overlays show up as unnamed files in the root
+class NdsRom : public NitroFS {
+public:
+    // Maps the file, its files stay valid as long as the ROM
+    bool open(const std::filesystem::path& path);
+
+    // Reads a ROM that is already in memory, data has to outlive the ROM
+    bool open(std::span<const u8> data);
+
+    static bool isRomFile(const std::filesystem::path& path) { return path.extension() == ".nds"; }
+
+private:
+    bool parse();
+};
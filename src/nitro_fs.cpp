@@ -0,0 +1,290 @@
+#include "nitro_fs.h"
+#include "lz.h"
+#include "narc.h"
+#include "nds_rom.h"
+
+#include <array>
+#include <deque>
+#include <fmt/format.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+
+
+namespace {
+
+struct FntDirectory {
+    u32 subtableOffset; // Relative to the start of the FNT
+    u16 firstFile;
+    u16 parent; // Total directory count for the root
+};
+
+constexpr u32 s_splMagic = 0x53504120; // ' APS'
+
+}
+
+
+std::unique_ptr<NitroFS> NitroFS::load(const std::filesystem::path& path) {
+    if (NdsRom::isRomFile(path)) {
+        auto rom = std::make_unique<NdsRom>();
+        return rom->open(path) ? std::move(rom) : nullptr;
+    }
+
+    auto narc = std::make_unique<NarcArchive>();
+    return narc->open(path) ? std::move(narc) : nullptr;
+}
+
+std::unique_ptr<NitroFS> NitroFS::load(std::span<const u8> data) {
+    if (NarcArchive::isNarc(data)) {
+        auto narc = std::make_unique<NarcArchive>();
+        return narc->open(data) ? std::move(narc) : nullptr;
+    }
+
+    auto rom = std::make_unique<NdsRom>();
+    return rom->open(data) ? std::move(rom) : nullptr;
+}
+
+bool NitroFS::readFile(const std::filesystem::path& path, const std::function<void(std::span<const u8>)>& callback) {
+    // The first component that exists on disk is the outermost container (or the file itself)
+    std::filesystem::path container;
+    auto it = path.begin();
+    for (std::error_code ec; it != path.end(); ++it) {
+        container /= *it;
+        if (std::filesystem::is_regular_file(container, ec)) {
+            break;
+        }
+    }
+
+    if (it == path.end()) {
+        spdlog::error("File not found: {}", path.string());
+        return false;
+    }
+
+    MappedFile file(container);
+    if (!file.isOpen()) {
+        return false;
+    }
+
+    std::vector<std::string> components;
+    for (++it; it != path.end(); ++it) {
+        components.push_back(it->string());
+    }
+
+    auto data = file.getData();
+    std::vector<std::vector<u8>> decompressed; // Backs data for compressed containers
+    size_t next = 0;
+
+    while (next < components.size()) {
+        if (const auto header = lz::readHeader(data)) {
+            auto& buffer = decompressed.emplace_back(header->size);
+            if (!lz::decompress(data, *header, buffer)) {
+                spdlog::error("Failed to decompress container in {}", path.string());
+                return false;
+            }
+
+            data = buffer;
+        }
+
+        const auto fs = load(data);
+        if (!fs) {
+            spdlog::error("Not a NARC file or ROM: {}", path.string());
+            return false;
+        }
+
+        // The longest matching prefix wins, nested containers are matched one at a time
+        bool found = false;
+        for (size_t end = components.size(); end > next && !found; end--) {
+            std::string filePath = components[next];
+            for (size_t i = next + 1; i < end; i++) {
+                filePath += '/' + components[i];
+            }
+
+            if (const auto index = fs->find(filePath)) {
+                data = fs->getData(*index);
+                next = end;
+                found = true;
+            }
+        }
+
+        if (!found) {
+            spdlog::error("File not found: {}", path.string());
+            return false;
+        }
+    }
+
+    callback(data);
+    return true;
+}
+
+std::span<const u8> NitroFS::getData(size_t index) const {
+    const auto& file = m_files[index];
+    return m_data.subspan(file.offset, file.size);
+}
+
+std::optional<size_t> NitroFS::find(std::string_view path) const {
+    for (size_t i = 0; i < m_files.size(); i++) {
+        if (m_files[i].path == path) {
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool NitroFS::map(const std::filesystem::path& path) {
+    m_path = path;
+    m_data = {};
+
+    if (!m_file.open(path)) {
+        return false;
+    }
+
+    m_data = m_file.getData();
+    return true;
+}
+
+bool NitroFS::readTables(std::span<const u8> fat, std::span<const u8> fnt, size_t imageOffset) {
+    m_files.clear();
+    m_directories.clear();
+
+    if (imageOffset > m_data.size() || fat.size() / 8 > 0xFFFF) {
+        return false;
+    }
+
+    const size_t imageSize = m_data.size() - imageOffset;
+
+    m_files.resize(fat.size() / 8);
+    for (size_t i = 0; i < m_files.size(); i++) {
+        std::array<u32, 2> range;
+        read(fat, i * 8, range);
+
+        if (range[0] > range[1] || range[1] > imageSize) {
+            spdlog::error("Invalid file {} in {}", i, m_path.string());
+            return false;
+        }
+
+        m_files[i].offset = (u32)(imageOffset + range[0]);
+        m_files[i].size = range[1] - range[0];
+    }
+
+    // Names are optional, most NARCs only have an empty root directory
+    if (!readNames(fnt)) {
+        spdlog::warn("Ignoring broken file names in {}", m_path.string());
+        m_directories.clear();
+        for (auto& file : m_files) {
+            file.name.clear();
+        }
+    }
+
+    if (m_directories.empty()) {
+        m_directories.emplace_back();
+    }
+
+    // ROM overlays and files of unnamed archives
+    for (size_t i = 0; i < m_files.size(); i++) {
+        if (m_files[i].name.empty()) {
+            m_files[i].name = makeName(i);
+            m_files[i].path = m_files[i].name;
+            m_directories[0].files.push_back((u16)i);
+        }
+    }
+
+    return true;
+}
+
+bool NitroFS::readNames(std::span<const u8> fnt) {
+    FntDirectory root;
+    if (!read(fnt, 0, root)) {
+        return true;
+    }
+
+    const size_t directoryCount = root.parent;
+    if (directoryCount == 0 || directoryCount > 0x1000 || directoryCount * sizeof(FntDirectory) > fnt.size()) {
+        return false;
+    }
+
+    m_directories.resize(directoryCount);
+
+    // Walk down from the root so every directory knows its path when its entries are named
+    std::vector<std::string> prefixes(directoryCount);
+    std::vector<bool> visited(directoryCount);
+    std::deque<size_t> pending = { 0 };
+    visited[0] = true;
+
+    while (!pending.empty()) {
+        const size_t index = pending.front();
+        pending.pop_front();
+
+        FntDirectory directory;
+        read(fnt, index * sizeof(FntDirectory), directory);
+
+        size_t offset = directory.subtableOffset;
+        size_t file = directory.firstFile;
+
+        while (true) {
+            u8 type;
+            if (!read(fnt, offset++, type)) {
+                return false;
+            }
+
+            if (type == 0) {
+                break;
+            }
+
+            const size_t length = type & 0x7F;
+            if (offset + length > fnt.size()) {
+                return false;
+            }
+
+            std::string name((const char*)fnt.data() + offset, length);
+            offset += length;
+
+            if (type & 0x80) {
+                u16 id;
+                if (!read(fnt, offset, id)) {
+                    return false;
+                }
+
+                offset += 2;
+
+                const size_t child = id & 0x0FFF;
+                if (child >= directoryCount || visited[child]) {
+                    return false;
+                }
+
+                visited[child] = true;
+                prefixes[child] = prefixes[index] + name + '/';
+                m_directories[child].name = std::move(name);
+                m_directories[index].directories.push_back((u16)child);
+                pending.push_back(child);
+            } else {
+                if (file >= m_files.size()) {
+                    return false;
+                }
+
+                m_files[file].path = prefixes[index] + name;
+                m_files[file].name = std::move(name);
+                m_directories[index].files.push_back((u16)file);
+                ++file;
+            }
+        }
+    }
+
+    return true;
+}
+
+std::string NitroFS::makeName(size_t index) const {
+    auto data = getData(index);
+
+    // Compressed files get named after their contents as well
+    std::array<u8, 4> decompressed;
+    if (const auto header = lz::readHeader(data); header && header->size >= decompressed.size()) {
+        if (lz::decompress(data, *header, decompressed)) {
+            data = decompressed;
+        }
+    }
+
+    u32 magic;
+    const bool isSpl = read(data, 0, magic) && magic == s_splMagic;
+
+    return fmt::format("{:04}{}", index, isSpl ? ".spa" : ".bin");
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "types.h"
+
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// File system used by NDS ROMs and NARC archives: a file allocation table plus an optional name table.
+// Files are views into the data the file system was opened on, which is either a mapped file
+// owned by the file system or a span that has to outlive it.
+class NitroFS {
+public:
+    struct File {
+        std::string name;
+        std::string path; // Relative to the file system root, '/' separated
+        u32 offset; // Into getData()
+        u32 size;
+    };
+
+    struct Directory {
+        std::string name;
+        std::vector<u16> directories; // Indices into getDirectories()
+        std::vector<u16> files; // Indices into getFiles()
+    };
+
+    // Opens a .nds or .narc file, the type is picked by the extension
+    static std::unique_ptr<NitroFS> load(const std::filesystem::path& path);
+
+    // Opens a ROM or NARC that is already in memory, the type is picked by the contents
+    static std::unique_ptr<NitroFS> load(std::span<const u8> data);
+
+    // Reads a file whose path can go through .nds and .narc files, e.g. "game.nds/a/0/4/2/0003.spa".
+    // Compressed containers are decompressed, callback is called with the data of the innermost file.
+    static bool readFile(const std::filesystem::path& path, const std::function<void(std::span<const u8>)>& callback);
+
+    const std::filesystem::path& getPath() const { return m_path; }
+    std::span<const u8> getData() const { return m_data; }
+    const std::vector<File>& getFiles() const { return m_files; }
+    const std::vector<Directory>& getDirectories() const { return m_directories; } // Root first
+
+    std::span<const u8> getData(size_t index) const;
+    std::optional<size_t> find(std::string_view path) const;
+
+protected:
+    // Maps the file, getData() is empty if that failed
+    bool map(const std::filesystem::path& path);
+
+    // fat holds (start, end) pairs relative to imageOffset
+    bool readTables(std::span<const u8> fat, std::span<const u8> fnt, size_t imageOffset);
+
+    template<class T>
+    static bool read(std::span<const u8> data, size_t offset, T& value) {
+        if (offset > data.size() || data.size() - offset < sizeof(T)) {
+            return false;
+        }
+
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        return true;
+    }
+
+private:
+    bool readNames(std::span<const u8> fnt);
+    std::string makeName(size_t index) const;
+
+protected:
+    std::filesystem::path m_path;
+    std::span<const u8> m_data;
+
+private:
+    MappedFile m_file;
+    std::vector<File> m_files;
+    std::vector<Directory> m_directories;
+};
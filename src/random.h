@@ -13,6 +13,19 @@ inline std::uniform_real_distribution<f32> s_distf(0.0f, 1.0f);
 
 namespace random {
 
+// Makes all following random values reproducible
+inline void seed(u64 value) {
+    detail::s_gen.seed(value);
+    detail::s_dist.reset();
+    detail::s_dist32.reset();
+    detail::s_distf.reset();
+}
+
+// Goes back to non-reproducible random values after seed()
+inline void reseed() {
+    seed(((u64)detail::s_rd() << 32) | detail::s_rd());
+}
+
 inline u64 nextU64() {
     return detail::s_dist(detail::s_gen);
 }
@@ -4,6 +4,7 @@
 #include <map>
 
 #include "spl_resource.h"
+#include "spl_behavior.h"
 
 #define NAME_CASE(T, x) case T::x: return #x
 
@@ -63,6 +64,26 @@ inline constexpr std::array g_collisionType = {
     "Kill",
     "Bounce"
 };
+
+inline const std::map<TextureFormat, const char*> g_textureFormatNames = {
+    { TextureFormat::None, "None" },
+    { TextureFormat::A3I5, "A3I5" },
+    { TextureFormat::Palette4, "Palette4" },
+    { TextureFormat::Palette16, "Palette16" },
+    { TextureFormat::Palette256, "Palette256" },
+    { TextureFormat::Comp4x4, "Comp4x4" },
+    { TextureFormat::A5I3, "A5I3" },
+    { TextureFormat::Direct, "Direct" }
+};
+
+inline const std::map<SPLBehaviorType, const char*> g_behaviorTypeNames = {
+    { SPLBehaviorType::Gravity, "Gravity" },
+    { SPLBehaviorType::Random, "Random" },
+    { SPLBehaviorType::Magnet, "Magnet" },
+    { SPLBehaviorType::Spin, "Spin" },
+    { SPLBehaviorType::CollisionPlane, "Collision Plane" },
+    { SPLBehaviorType::Convergence, "Convergence" }
+};
 } // namespace detail
 
 inline const char* getEmissionType(SPLEmissionType v) {
@@ -94,3 +115,13 @@ inline const char* getScaleAnimDir(SPLScaleAnimDir v) {
     const auto it = detail::g_scaleAnimDirNames.find(v);
     return it != detail::g_scaleAnimDirNames.end() ? it->second : "Unknown";
 }
+
+inline const char* getTextureFormat(TextureFormat v) {
+    const auto it = detail::g_textureFormatNames.find(v);
+    return it != detail::g_textureFormatNames.end() ? it->second : "Unknown";
+}
+
+inline const char* getBehaviorType(SPLBehaviorType v) {
+    const auto it = detail::g_behaviorTypeNames.find(v);
+    return it != detail::g_behaviorTypeNames.end() ? it->second : "Unknown";
+}
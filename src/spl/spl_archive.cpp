@@ -1,11 +1,28 @@
 #include "spl_archive.h"
+#include "gl_texture_pool.h"
 #include "gl_util.h"
+#include "hash.h"
+#include "lz.h"
+#include "mapped_file.h"
+#include "nitro_fs.h"
 
 #include <gl/glew.h>
 #include <glm/gtc/constants.hpp>
 #include <spdlog/spdlog.h>
-#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <concepts>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <random>
+#include <streambuf>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 template<class T> requires std::is_trivially_copyable_v<T>
@@ -14,24 +31,261 @@ std::istream& operator>>(std::istream& stream, T& v) {
 }
 
 
-SPLArchive::SPLArchive(const std::filesystem::path& filename) : m_header() {
-    load(filename);
+namespace {
+
+// Read-only stream over a buffer, so the parser works the same on files and decompressed data
+class MemoryBuffer : public std::streambuf {
+public:
+    explicit MemoryBuffer(std::span<const u8> data) {
+        const auto begin = (char*)data.data();
+        setg(begin, begin, begin + data.size());
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios::seekdir dir, std::ios::openmode) override {
+        const auto base = dir == std::ios::beg ? eback() : dir == std::ios::cur ? gptr() : egptr();
+        const auto target = base + off;
+        if (target < eback() || target > egptr()) {
+            return pos_type(off_type(-1));
+        }
+
+        setg(eback(), target, egptr());
+        return target - eback();
+    }
+
+    pos_type seekpos(pos_type pos, std::ios::openmode mode) override {
+        return seekoff(off_type(pos), std::ios::beg, mode);
+    }
+};
+
+template<class T> requires std::is_trivially_copyable_v<T>
+void append(std::vector<u8>& out, const T& value) {
+    const auto bytes = reinterpret_cast<const u8*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
 }
 
+// [0, 1] -> [0, max]
+u32 toUnorm(f32 value, u32 max) {
+    return (u32)std::clamp<long>(std::lround(value * (f32)max), 0, (long)max);
+}
 
-void SPLArchive::load(const std::filesystem::path& filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::in);
-    if (!file) {
-        spdlog::error("Failed to open file: {}", filename.string());
-        return;
+GXRgb toRgb(const glm::vec3& color) {
+    GXRgb rgb(0);
+    rgb.r = toUnorm(color.r, 31);
+    rgb.g = toUnorm(color.g, 31);
+    rgb.b = toUnorm(color.b, 31);
+    return rgb;
+}
+
+template<class T>
+const T* findBehavior(const SPLResource& resource, SPLBehaviorType type) {
+    for (const auto& behavior : resource.behaviors) {
+        if (behavior->type == type) {
+            return static_cast<const T*>(behavior.get());
+        }
+    }
+
+    return nullptr;
+}
+
+// Part of a saved file, copied either from the source file or from the encoded buffer
+struct Segment {
+    bool fromSource;
+    u64 offset;
+    u64 size;
+};
+
+void addSegment(std::vector<Segment>& segments, bool fromSource, u64 offset, u64 size) {
+    // Clean resources next to each other usually are in the source too, so they become a single copy
+    if (!segments.empty()) {
+        auto& last = segments.back();
+        if (last.fromSource == fromSource && last.offset + last.size == offset) {
+            last.size += size;
+            return;
+        }
+    }
+
+    segments.push_back({ fromSource, offset, size });
+}
+
+#ifdef __linux__
+bool writeAll(int fd, const u8* data, u64 size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written <= 0) {
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+// Clean parts are copied by the kernel without passing through user space, or not copied at all on
+// filesystems that can share extents. Where copy_file_range doesn't work (e.g. across filesystems on
+// older kernels) they are written from the mapped source instead. sourcePath is empty if nothing is copied.
+// The file is synced before returning, so the rename that follows can't leave a truncated archive behind.
+bool writeSegments(
+    const std::filesystem::path& path,
+    std::span<const Segment> segments,
+    std::span<const u8> encoded,
+    std::span<const u8> source,
+    const std::filesystem::path& sourcePath,
+    std::filesystem::perms perms
+) {
+    const int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (out < 0) {
+        return false;
+    }
+
+    // The umask applies to open but not to fchmod
+    bool success = fchmod(out, (mode_t)(perms & std::filesystem::perms::mask)) == 0;
+    int in = sourcePath.empty() ? -1 : open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+    for (const auto& segment : segments) {
+        if (!success) {
+            break;
+        }
+
+        if (!segment.fromSource) {
+            success = writeAll(out, encoded.data() + segment.offset, segment.size);
+            continue;
+        }
+
+        off64_t offset = (off64_t)segment.offset;
+        u64 remaining = segment.size;
+        while (in >= 0 && remaining > 0) {
+            const ssize_t copied = copy_file_range(in, &offset, out, nullptr, remaining, 0);
+            if (copied <= 0) {
+                close(in);
+                in = -1;
+                break;
+            }
+
+            remaining -= copied;
+        }
+
+        success = writeAll(out, source.data() + segment.offset + (segment.size - remaining), remaining);
+    }
+
+    if (in >= 0) {
+        close(in);
+    }
+
+    success = success && fsync(out) == 0;
+    return close(out) == 0 && success;
+}
+
+// Makes the rename itself survive a crash
+void syncDirectory(const std::filesystem::path& directory) {
+    const int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+#else
+bool writeBuffered(const std::filesystem::path& path, std::span<const Segment> segments, std::span<const u8> encoded, std::span<const u8> source) {
+    u64 size = 0;
+    for (const auto& segment : segments) {
+        size += segment.size;
+    }
+
+    std::vector<u8> buffer;
+    buffer.reserve(size);
+    for (const auto& segment : segments) {
+        const auto data = (segment.fromSource ? source : encoded).subspan(segment.offset, segment.size);
+        buffer.insert(buffer.end(), data.begin(), data.end());
+    }
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream.write((const char*)buffer.data(), (std::streamsize)buffer.size());
+    stream.flush();
+    return (bool)stream;
+}
+#endif
+
+}
+
+
+SPLArchive::SPLArchive() : m_header() {}
+
+SPLArchive::SPLArchive(const std::filesystem::path& filename, bool createTextures) : m_header() {
+    if (parse(filename) && createTextures) {
+        this->createTextures();
+    }
+}
+
+
+bool SPLArchive::parse(const std::filesystem::path& filename, std::stop_token stop, const ProgressCallback& progress) {
+    // Files inside ROMs and NARCs are parsed straight out of the mapped container
+    bool parsed = false;
+    bool compressed = false;
+    const bool read = NitroFS::readFile(filename, [&](std::span<const u8> data) {
+        parsed = parse(data, stop, progress);
+        compressed = lz::readHeader(data).has_value();
+    });
+
+    // The ranges only point into the file itself if it was neither compressed nor inside a container
+    std::error_code ec;
+    if (read && parsed && !compressed && std::filesystem::is_regular_file(filename, ec)) {
+        setSource(filename);
     }
 
+    return read && parsed;
+}
+
+bool SPLArchive::parse(std::span<const u8> data, std::stop_token stop, const ProgressCallback& progress) {
+    // Archives extracted from ROMs are often still LZ compressed
+    if (const auto header = lz::readHeader(data)) {
+        const auto start = std::chrono::steady_clock::now();
+
+        memory::TrackedVector<u8, memory::Category::ArchiveData> decompressed(header->size);
+        if (!lz::decompress(data, *header, decompressed)) {
+            spdlog::error("Failed to decompress LZ{:02X} data", (u32)header->type);
+            return false;
+        }
+
+        const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        spdlog::info("Decompressed LZ{:02X} archive: {} -> {} bytes in {:.2f} ms, {:.1f} MB/s",
+            (u32)header->type,
+            data.size(),
+            decompressed.size(),
+            seconds * 1000.0,
+            decompressed.size() / std::max(seconds, 1e-9) / (1024.0 * 1024.0)
+        );
+
+        return parse(decompressed, stop, progress);
+    }
+
+    MemoryBuffer buffer(data);
+    std::istream file(&buffer);
+
+    const f32 fileSize = (f32)std::max<size_t>(data.size(), 1);
+
+    const auto reportProgress = [&] {
+        if (progress) {
+            progress(std::min((f32)file.tellg() / fileSize, 1.0f));
+        }
+    };
+
     file >> m_header;
 
     m_resources.resize(m_header.resCount);
+    m_resourceHashes.assign(m_header.resCount, 0);
+    m_resourceRanges.assign(m_header.resCount, {});
+    m_dirtyResources.assign(m_header.resCount, false);
+    m_sourcePath.clear();
     
     for (size_t i = 0; i < m_header.resCount; i++) {
+        if (stop.stop_requested()) {
+            return false;
+        }
+
         SPLResource& res = m_resources[i];
+        const s64 resourceStart = file.tellg();
 
         SPLResourceHeaderNative header;
         file >> header;
@@ -106,18 +360,36 @@ void SPLArchive::load(const std::filesystem::path& filename) {
             file >> convergenceBehavior;
             res.behaviors.push_back(fromNative(convergenceBehavior));
         }
+
+        // Hashed over the native bytes while they are at hand, so it doesn't depend on the conversion
+        const s64 resourceEnd = file.tellg();
+        if (resourceStart >= 0 && resourceEnd >= resourceStart) {
+            m_resourceHashes[i] = hash::xxh64(data.subspan(resourceStart, resourceEnd - resourceStart));
+            m_resourceRanges[i] = { (u64)resourceStart, (u64)(resourceEnd - resourceStart) };
+        }
+
+        reportProgress();
     }
 
     m_textures.resize(m_header.texCount);
+    m_textureResources.resize(m_header.texCount);
+    m_textureRanges.assign(m_header.texCount, {});
 
     for (size_t i = 0; i < m_header.texCount; i++) {
+        if (stop.stop_requested()) {
+            return false;
+        }
+
         SPLTexture& tex = m_textures[i];
 
         SPLTextureResource texRes;
         s64 offset = file.tellg();
         file >> texRes;
 
-        tex.resource = nullptr;
+        m_textureResources[i] = texRes;
+        m_textureRanges[i] = { (u64)offset, texRes.resourceSize };
+
+        tex.resource = &m_textureResources[i];
         tex.param = fromNative(texRes.param);
         tex.width = 1 << (texRes.param.s + 3);
         tex.height = 1 << (texRes.param.t + 3);
@@ -139,23 +411,389 @@ void SPLArchive::load(const std::filesystem::path& filename) {
 
             tex.textureData = m_textureData.back();
             tex.paletteData = m_paletteData.back();
-
-            tex.glTexture = std::make_shared<GLTexture>(tex);
         }
 
         file.seekg(offset + texRes.resourceSize, std::ios::beg);
+        reportProgress();
+    }
+
+    m_textureHashes.assign(m_header.texCount, 0);
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        if (!m_textures[i].param.useSharedTexture) {
+            m_textureHashes[i] = hashTexture(m_textures[i].textureData, m_textures[i].paletteData);
+        }
     }
 
     // Resolve shared textures
-    for (auto& tex : m_textures) {
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        auto& tex = m_textures[i];
         if (tex.param.useSharedTexture) {
             tex.textureData = m_textureData[tex.param.sharedTexID];
             tex.paletteData = m_paletteData[tex.param.sharedTexID];
+            m_textureHashes[i] = m_textureHashes[tex.param.sharedTexID];
+        }
+    }
+
+    return true;
+}
+
+u64 SPLArchive::hashTexture(std::span<const u8> textureData, std::span<const u8> paletteData) {
+    return hash::xxh64(paletteData, hash::xxh64(textureData));
+}
+
+void SPLArchive::createTextures() {
+    // Archives shared between editors only get their textures once
+    if (m_textureUsers++ > 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        auto& tex = m_textures[i];
+        if (!tex.param.useSharedTexture) {
+            tex.glTexture = g_texturePool
+                ? g_texturePool->acquire(tex, m_textureHashes[i])
+                : std::make_shared<GLTexture>(tex);
+        }
+    }
+
+    for (auto& tex : m_textures) {
+        if (tex.param.useSharedTexture) {
             tex.glTexture = m_textures[tex.param.sharedTexID].glTexture;
         }
     }
 }
 
+void SPLArchive::releaseTextures() {
+    if (m_textureUsers == 0 || --m_textureUsers > 0) {
+        return;
+    }
+
+    // The pool deletes the GL textures no other archive holds on to
+    for (auto& tex : m_textures) {
+        tex.glTexture.reset();
+    }
+}
+
+void SPLArchive::replaceContents(SPLArchive& other) {
+    if (m_textureUsers > 0) {
+        other.createTextures();
+    }
+
+    // Swapping keeps the buffers the texture spans point into
+    std::swap(m_header, other.m_header);
+    std::swap(m_resources, other.m_resources);
+    std::swap(m_textures, other.m_textures);
+    std::swap(m_textureData, other.m_textureData);
+    std::swap(m_paletteData, other.m_paletteData);
+    std::swap(m_resourceHashes, other.m_resourceHashes);
+    std::swap(m_textureHashes, other.m_textureHashes);
+    std::swap(m_textureResources, other.m_textureResources);
+    std::swap(m_textureArray, other.m_textureArray);
+
+    std::swap(m_resourceRanges, other.m_resourceRanges);
+    std::swap(m_textureRanges, other.m_textureRanges);
+    std::swap(m_sourcePath, other.m_sourcePath);
+    std::swap(m_sourceSize, other.m_sourceSize);
+    std::swap(m_sourceWriteTime, other.m_sourceWriteTime);
+    std::swap(m_dirtyResources, other.m_dirtyResources);
+}
+
+void SPLArchive::markResourceDirty(size_t index) {
+    if (index >= m_dirtyResources.size()) {
+        m_dirtyResources.resize(index + 1, true);
+    }
+
+    m_dirtyResources[index] = true;
+}
+
+bool SPLArchive::save(const std::filesystem::path& path) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::error_code ec;
+    const auto directory = path.parent_path();
+    if (!directory.empty() && !std::filesystem::is_directory(directory, ec)) {
+        spdlog::error("Can't save {}, files inside .narc and .nds files can't be written to", path.string());
+        return false;
+    }
+
+    MappedFile source;
+    if (isSourceUnchanged()) {
+        source.open(m_sourcePath);
+    }
+
+    const bool copyClean = source.isOpen();
+
+    SPLFileHeader header = m_header;
+    header.resCount = (u16)m_resources.size();
+    header.texCount = (u16)m_textures.size();
+
+    // The header is filled in once the section sizes are known
+    std::vector<u8> encoded(sizeof(SPLFileHeader));
+    std::vector<Segment> segments;
+    addSegment(segments, false, 0, sizeof(SPLFileHeader));
+    u64 outputSize = sizeof(SPLFileHeader);
+
+    std::vector<SourceRange> resourceRanges(m_resources.size());
+    std::vector<std::pair<size_t, u64>> encodedResources; // Index, hash of the new native bytes
+
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        const auto range = i < m_resourceRanges.size() ? m_resourceRanges[i] : SourceRange{};
+
+        if (copyClean && !isResourceDirty(i) && range.size > 0) {
+            addSegment(segments, true, range.offset, range.size);
+            resourceRanges[i] = { outputSize, range.size };
+        } else {
+            const size_t offset = encoded.size();
+            encodeResource(m_resources[i], encoded);
+            const size_t size = encoded.size() - offset;
+
+            addSegment(segments, false, offset, size);
+            resourceRanges[i] = { outputSize, size };
+            encodedResources.emplace_back(i, hash::xxh64(std::span(encoded).subspan(offset, size)));
+        }
+
+        outputSize += resourceRanges[i].size;
+    }
+
+    header.resSize = (u32)(outputSize - sizeof(SPLFileHeader));
+    header.texOffset = (u32)outputSize;
+
+    std::vector<SourceRange> textureRanges(m_textures.size());
+    size_t encodedTextures = 0;
+
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        const auto range = i < m_textureRanges.size() ? m_textureRanges[i] : SourceRange{};
+
+        if (copyClean && range.size > 0) {
+            addSegment(segments, true, range.offset, range.size);
+            textureRanges[i] = { outputSize, range.size };
+        } else {
+            const size_t offset = encoded.size();
+            encodeTexture(i, encoded);
+            const size_t size = encoded.size() - offset;
+
+            addSegment(segments, false, offset, size);
+            textureRanges[i] = { outputSize, size };
+            ++encodedTextures;
+        }
+
+        outputSize += textureRanges[i].size;
+    }
+
+    header.texSize = (u32)(outputSize - header.texOffset);
+    std::memcpy(encoded.data(), &header, sizeof(header));
+
+    u64 copied = 0;
+    for (const auto& segment : segments) {
+        copied += segment.fromSource ? segment.size : 0;
+    }
+
+    // Written next to the destination so the rename can't cross filesystems
+    auto temp = path;
+    temp += fmt::format(".{:08x}.tmp", std::random_device{}());
+
+    // The replacement keeps the permissions of the file it replaces
+    std::error_code statusError;
+    const auto existing = std::filesystem::status(path, statusError);
+    const auto perms = std::filesystem::exists(existing)
+        ? existing.permissions()
+        : std::filesystem::perms::owner_read | std::filesystem::perms::owner_write
+            | std::filesystem::perms::group_read | std::filesystem::perms::others_read;
+
+#ifdef __linux__
+    bool written = writeSegments(temp, segments, encoded, source.getData(), copyClean ? m_sourcePath : std::filesystem::path(), perms);
+#else
+    bool written = writeBuffered(temp, segments, encoded, source.getData());
+    if (written) {
+        std::filesystem::permissions(temp, perms, ec);
+        written = !ec;
+    }
+#endif
+
+    // Some platforms can't replace a file that is still mapped
+    source.close();
+
+    if (written) {
+        std::filesystem::rename(temp, path, ec);
+    }
+
+    if (!written || ec) {
+        spdlog::error("Failed to save {}{}", path.string(), ec ? ": " + ec.message() : "");
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+
+#ifdef __linux__
+    syncDirectory(directory);
+#endif
+
+    m_header = header;
+    m_resourceRanges = std::move(resourceRanges);
+    m_textureRanges = std::move(textureRanges);
+    m_dirtyResources.assign(m_resources.size(), false);
+
+    m_resourceHashes.resize(m_resources.size(), 0);
+    for (const auto& [index, hash] : encodedResources) {
+        m_resourceHashes[index] = hash;
+    }
+
+    setSource(path);
+
+    spdlog::info("Saved {} ({} of {} resources and {} of {} textures encoded, {} of {} bytes copied) in {:.2f} ms",
+        path.filename().string(),
+        encodedResources.size(),
+        m_resources.size(),
+        encodedTextures,
+        m_textures.size(),
+        copied,
+        outputSize,
+        std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count()
+    );
+
+    return true;
+}
+
+bool SPLArchive::isSourceUnchanged() const {
+    if (m_sourcePath.empty()) {
+        return false;
+    }
+
+    std::error_code ec;
+    const u64 size = std::filesystem::file_size(m_sourcePath, ec);
+    if (ec) {
+        return false;
+    }
+
+    const auto writeTime = std::filesystem::last_write_time(m_sourcePath, ec);
+    return !ec && size == m_sourceSize && writeTime == m_sourceWriteTime;
+}
+
+void SPLArchive::setSource(const std::filesystem::path& path) {
+    std::error_code ec;
+    m_sourcePath = std::filesystem::absolute(path, ec);
+    if (!ec) {
+        m_sourceSize = std::filesystem::file_size(path, ec);
+    }
+
+    if (!ec) {
+        m_sourceWriteTime = std::filesystem::last_write_time(path, ec);
+    }
+
+    if (ec) {
+        m_sourcePath.clear();
+    }
+}
+
+void SPLArchive::encodeResource(const SPLResource& resource, std::vector<u8>& out) {
+    const auto& flags = resource.header.flags;
+
+    const auto gravity = findBehavior<SPLGravityBehavior>(resource, SPLBehaviorType::Gravity);
+    const auto random = findBehavior<SPLRandomBehavior>(resource, SPLBehaviorType::Random);
+    const auto magnet = findBehavior<SPLMagnetBehavior>(resource, SPLBehaviorType::Magnet);
+    const auto spin = findBehavior<SPLSpinBehavior>(resource, SPLBehaviorType::Spin);
+    const auto collisionPlane = findBehavior<SPLCollisionPlaneBehavior>(resource, SPLBehaviorType::CollisionPlane);
+    const auto convergence = findBehavior<SPLConvergenceBehavior>(resource, SPLBehaviorType::Convergence);
+
+    // The flags tell the reader what follows the header, so they have to match what is actually written
+    auto header = toNative(resource.header);
+    header.flags.hasScaleAnim = flags.hasScaleAnim && resource.scaleAnim;
+    header.flags.hasColorAnim = flags.hasColorAnim && resource.colorAnim;
+    header.flags.hasAlphaAnim = flags.hasAlphaAnim && resource.alphaAnim;
+    header.flags.hasTexAnim = flags.hasTexAnim && resource.texAnim;
+    header.flags.hasChildResource = flags.hasChildResource && resource.childResource;
+    header.flags.hasGravityBehavior = gravity != nullptr;
+    header.flags.hasRandomBehavior = random != nullptr;
+    header.flags.hasMagnetBehavior = magnet != nullptr;
+    header.flags.hasSpinBehavior = spin != nullptr;
+    header.flags.hasCollisionPlaneBehavior = collisionPlane != nullptr;
+    header.flags.hasConvergenceBehavior = convergence != nullptr;
+
+    append(out, header);
+
+    // Same order as parse reads them
+    if (header.flags.hasScaleAnim) {
+        append(out, toNative(*resource.scaleAnim));
+    }
+
+    if (header.flags.hasColorAnim) {
+        append(out, toNative(*resource.colorAnim));
+    }
+
+    if (header.flags.hasAlphaAnim) {
+        append(out, toNative(*resource.alphaAnim));
+    }
+
+    if (header.flags.hasTexAnim) {
+        append(out, toNative(*resource.texAnim));
+    }
+
+    if (header.flags.hasChildResource) {
+        append(out, toNative(*resource.childResource));
+    }
+
+    if (gravity) {
+        append(out, toNative(*gravity));
+    }
+
+    if (random) {
+        append(out, toNative(*random));
+    }
+
+    if (magnet) {
+        append(out, toNative(*magnet));
+    }
+
+    if (spin) {
+        append(out, toNative(*spin));
+    }
+
+    if (collisionPlane) {
+        append(out, toNative(*collisionPlane));
+    }
+
+    if (convergence) {
+        append(out, toNative(*convergence));
+    }
+}
+
+void SPLArchive::encodeTexture(size_t index, std::vector<u8>& out) const {
+    const auto& tex = m_textures[index];
+
+    // Shared textures only consist of their header, the data belongs to the texture they point to
+    const bool hasData = !tex.param.useSharedTexture;
+
+    SPLTextureResource resource = tex.resource ? *tex.resource : SPLTextureResource{};
+    resource.param = toNative(tex.param);
+    resource.textureSize = hasData ? (u32)tex.textureData.size() : 0;
+    resource.paletteSize = hasData ? (u32)tex.paletteData.size() : 0;
+    resource.paletteOffset = (u32)sizeof(SPLTextureResource) + resource.textureSize;
+    resource.resourceSize = resource.paletteOffset + resource.paletteSize;
+
+    append(out, resource);
+    if (hasData) {
+        out.insert(out.end(), tex.textureData.begin(), tex.textureData.end());
+        out.insert(out.end(), tex.paletteData.begin(), tex.paletteData.end());
+    }
+}
+
+void SPLArchive::getMemoryUsage(memory::Usage& usage) const {
+    usage[memory::Category::ArchiveData] += memory::getSize(m_resources);
+
+    for (const auto& data : m_textureData) {
+        usage[memory::Category::TextureData] += memory::getSize(data);
+    }
+
+    for (const auto& data : m_paletteData) {
+        usage[memory::Category::TextureData] += memory::getSize(data);
+    }
+
+    for (const auto& tex : m_textures) {
+        if (tex.glTexture && !tex.param.useSharedTexture) {
+            usage[memory::Category::GLTextures] += tex.glTexture->getMemoryUsage();
+        }
+    }
+}
+
 SPLResourceHeader SPLArchive::fromNative(const SPLResourceHeaderNative &native) {
     return SPLResourceHeader {
         .flags = {
@@ -200,6 +838,7 @@ SPLResourceHeader SPLArchive::fromNative(const SPLResourceHeaderNative &native)
         .minRotation = toAngle(native.minRotation),
         .maxRotation = toAngle(native.maxRotation),
         .initAngle = toAngle(native.initAngle),
+        .reserved = native.reserved,
         .emitterLifeTime = toSeconds(native.emitterLifeTime),
         .particleLifeTime = toSeconds(native.particleLifeTime),
         .variance = {
@@ -224,6 +863,10 @@ SPLResourceHeader SPLArchive::fromNative(const SPLResourceHeaderNative &native)
         },
         .polygonX = FX_FX16_TO_F32(native.polygonX),
         .polygonY = FX_FX16_TO_F32(native.polygonY),
+        .userData = {
+            .flags = (u8)native.userData.flags,
+            ._ = {}
+        }
     };
 }
 
@@ -261,6 +904,7 @@ SPLChildResource SPLArchive::fromNative(const SPLChildResourceNative &native) {
         .lifeTime = toSeconds(native.lifeTime),
         .velocityRatio = toSeconds(native.velocityRatio),
         .scaleRatio = toSeconds(native.scaleRatio),
+        .color = native.color.toVec3(),
         .misc = {
             .emissionCount = (u8)native.misc.emissionCount,
             .emissionDelay = (f32)native.misc.emissionDelay / 255.0f,
@@ -312,3 +956,212 @@ SPLTextureParam SPLArchive::fromNative(const SPLTextureParamNative& native) {
     };
 }
 
+SPLResourceHeaderNative SPLArchive::toNative(const SPLResourceHeader& header) {
+    SPLResourceHeaderNative native{};
+    native.flags.all = 0;
+
+    const auto& flags = header.flags;
+    native.flags.emissionType = (u32)flags.emissionType;
+    native.flags.drawType = (u32)flags.drawType;
+    native.flags.circleAxis = (u32)flags.emissionAxis;
+    native.flags.hasScaleAnim = flags.hasScaleAnim;
+    native.flags.hasColorAnim = flags.hasColorAnim;
+    native.flags.hasAlphaAnim = flags.hasAlphaAnim;
+    native.flags.hasTexAnim = flags.hasTexAnim;
+    native.flags.hasRotation = flags.hasRotation;
+    native.flags.randomInitAngle = flags.randomInitAngle;
+    native.flags.selfMaintaining = flags.selfMaintaining;
+    native.flags.followEmitter = flags.followEmitter;
+    native.flags.hasChildResource = flags.hasChildResource;
+    native.flags.polygonRotAxis = (u32)flags.polygonRotAxis;
+    native.flags.polygonReferencePlane = (u32)flags.polygonReferencePlane;
+    native.flags.randomizeLoopedAnim = flags.randomizeLoopedAnim;
+    native.flags.drawChildrenFirst = flags.drawChildrenFirst;
+    native.flags.hideParent = flags.hideParent;
+    native.flags.useViewSpace = flags.useViewSpace;
+    native.flags.hasGravityBehavior = flags.hasGravityBehavior;
+    native.flags.hasRandomBehavior = flags.hasRandomBehavior;
+    native.flags.hasMagnetBehavior = flags.hasMagnetBehavior;
+    native.flags.hasSpinBehavior = flags.hasSpinBehavior;
+    native.flags.hasCollisionPlaneBehavior = flags.hasCollisionPlaneBehavior;
+    native.flags.hasConvergenceBehavior = flags.hasConvergenceBehavior;
+    native.flags.hasFixedPolygonID = flags.hasFixedPolygonID;
+    native.flags.childHasFixedPolygonID = flags.childHasFixedPolygonID;
+
+    native.emitterBasePos = header.emitterBasePos;
+    native.emissionCount = (fx32)(header.emissionCount << FX32_SHIFT);
+    native.radius = FX_F32_TO_FX32(header.radius);
+    native.length = FX_F32_TO_FX32(header.length);
+    native.axis = header.axis;
+    native.color = toRgb(header.color);
+    native.initVelPosAmplifier = FX_F32_TO_FX32(header.initVelPosAmplifier);
+    native.initVelAxisAmplifier = FX_F32_TO_FX32(header.initVelAxisAmplifier);
+    native.baseScale = FX_F32_TO_FX32(header.baseScale);
+    native.aspectRatio = FX_F32_TO_FX16(header.aspectRatio);
+    native.startDelay = toFrames<u16>(header.startDelay);
+    native.minRotation = toIndex<s16>(header.minRotation);
+    native.maxRotation = toIndex<s16>(header.maxRotation);
+    native.initAngle = toIndex<u16>(header.initAngle);
+    native.reserved = header.reserved;
+    native.emitterLifeTime = toFrames<u16>(header.emitterLifeTime);
+    native.particleLifeTime = toFrames<u16>(header.particleLifeTime);
+
+    native.variance.baseScale = toUnorm(header.variance.baseScale, 255);
+    native.variance.lifeTime = toUnorm(header.variance.lifeTime, 255);
+    native.variance.initVel = toUnorm(header.variance.initVel, 255);
+
+    const auto& misc = header.misc;
+    native.misc.emissionInterval = std::min(toFrames(misc.emissionInterval), 255u);
+    native.misc.baseAlpha = toUnorm(misc.baseAlpha, 31);
+    native.misc.airResistance = (u32)std::clamp<long>(std::lround((misc.airResistance - 0.75f) * 512.0f), 0, 255);
+    native.misc.textureIndex = misc.textureIndex;
+    native.misc.loopFrames = std::min(toFrames(misc.loopTime), 255u);
+    native.misc.dbbScale = (u16)std::lround(misc.dbbScale * (1 << FX16_SHIFT)); // Negative values wrap, same as fx16
+    native.misc.textureTileCountS = misc.textureTileCountS;
+    native.misc.textureTileCountT = misc.textureTileCountT;
+    native.misc.scaleAnimDir = (u32)misc.scaleAnimDir;
+    native.misc.dpolFaceEmitter = misc.dpolFaceEmitter;
+    native.misc.flipTextureS = misc.flipTextureS;
+    native.misc.flipTextureT = misc.flipTextureT;
+
+    native.polygonX = FX_F32_TO_FX16(header.polygonX);
+    native.polygonY = FX_F32_TO_FX16(header.polygonY);
+    native.userData.flags = header.userData.flags;
+
+    return native;
+}
+
+SPLScaleAnimNative SPLArchive::toNative(const SPLScaleAnim& anim) {
+    SPLScaleAnimNative native{};
+    native.start = FX_F32_TO_FX16(anim.start);
+    native.mid = FX_F32_TO_FX16(anim.mid);
+    native.end = FX_F32_TO_FX16(anim.end);
+    native.curve = anim.curve;
+    native.flags.loop = anim.flags.loop;
+    return native;
+}
+
+SPLColorAnimNative SPLArchive::toNative(const SPLColorAnim& anim) {
+    SPLColorAnimNative native{};
+    native.start = toRgb(anim.start);
+    native.end = toRgb(anim.end);
+    native.curve = anim.curve;
+    native.flags.randomStartColor = anim.flags.randomStartColor;
+    native.flags.loop = anim.flags.loop;
+    native.flags.interpolate = anim.flags.interpolate;
+    return native;
+}
+
+SPLAlphaAnimNative SPLArchive::toNative(const SPLAlphaAnim& anim) {
+    SPLAlphaAnimNative native{};
+    native.alpha.all = 0;
+    native.alpha.start = toUnorm(anim.alpha.start, 31);
+    native.alpha.mid = toUnorm(anim.alpha.mid, 31);
+    native.alpha.end = toUnorm(anim.alpha.end, 31);
+    native.flags.randomRange = toUnorm(anim.flags.randomRange, 255);
+    native.flags.loop = anim.flags.loop;
+    native.curve = anim.curve;
+    return native;
+}
+
+SPLTexAnimNative SPLArchive::toNative(const SPLTexAnim& anim) {
+    SPLTexAnimNative native{};
+    std::ranges::copy(anim.textures, std::begin(native.textures));
+    native.param.frameCount = anim.param.textureCount;
+    native.param.step = toUnorm(anim.param.step, 255);
+    native.param.randomizeInit = anim.param.randomizeInit;
+    native.param.loop = anim.param.loop;
+    return native;
+}
+
+SPLChildResourceNative SPLArchive::toNative(const SPLChildResource& child) {
+    SPLChildResourceNative native{};
+    native.flags.all = 0;
+
+    const auto& flags = child.flags;
+    native.flags.usesBehaviors = flags.usesBehaviors;
+    native.flags.hasScaleAnim = flags.hasScaleAnim;
+    native.flags.hasAlphaAnim = flags.hasAlphaAnim;
+    native.flags.rotationType = (u16)flags.rotationType;
+    native.flags.followEmitter = flags.followEmitter;
+    native.flags.useChildColor = flags.useChildColor;
+    native.flags.drawType = (u16)flags.drawType;
+    native.flags.polygonRotAxis = (u16)flags.polygonRotAxis;
+    native.flags.polygonReferencePlane = (u16)flags.polygonReferencePlane;
+
+    native.randomInitVelMag = FX_F32_TO_FX16(child.randomInitVelMag);
+    native.endScale = FX_F32_TO_FX16(child.endScale);
+    native.lifeTime = toFrames<u16>(child.lifeTime);
+    native.velocityRatio = toFrames<u8>(child.velocityRatio);
+    native.scaleRatio = toFrames<u8>(child.scaleRatio);
+    native.color = toRgb(child.color);
+
+    const auto& misc = child.misc;
+    native.misc.emissionCount = misc.emissionCount;
+    native.misc.emissionDelay = toUnorm(misc.emissionDelay, 255);
+    native.misc.emissionInterval = std::min(toFrames(misc.emissionInterval), 255u);
+    native.misc.texture = misc.texture;
+    native.misc.textureTileCountS = misc.textureTileCountS;
+    native.misc.textureTileCountT = misc.textureTileCountT;
+    native.misc.flipTextureS = misc.flipTextureS;
+    native.misc.flipTextureT = misc.flipTextureT;
+    native.misc.dpolFaceEmitter = misc.dpolFaceEmitter;
+
+    return native;
+}
+
+SPLGravityBehaviorNative SPLArchive::toNative(const SPLGravityBehavior& behavior) {
+    SPLGravityBehaviorNative native{};
+    native.magnitude = behavior.magnitude;
+    return native;
+}
+
+SPLRandomBehaviorNative SPLArchive::toNative(const SPLRandomBehavior& behavior) {
+    SPLRandomBehaviorNative native{};
+    native.magnitude = behavior.magnitude;
+    native.applyInterval = toFrames<u16>(behavior.applyInterval);
+    return native;
+}
+
+SPLMagnetBehaviorNative SPLArchive::toNative(const SPLMagnetBehavior& behavior) {
+    SPLMagnetBehaviorNative native{};
+    native.target = behavior.target;
+    native.force = FX_F32_TO_FX16(behavior.force);
+    return native;
+}
+
+SPLSpinBehaviorNative SPLArchive::toNative(const SPLSpinBehavior& behavior) {
+    SPLSpinBehaviorNative native{};
+    native.angle = toIndex<u16>(behavior.angle);
+    native.axis = (u16)behavior.axis;
+    return native;
+}
+
+SPLCollisionPlaneBehaviorNative SPLArchive::toNative(const SPLCollisionPlaneBehavior& behavior) {
+    SPLCollisionPlaneBehaviorNative native{};
+    native.y = FX_F32_TO_FX32(behavior.y);
+    native.elasticity = FX_F32_TO_FX16(behavior.elasticity);
+    native.flags.collisionType = (u16)behavior.collisionType;
+    return native;
+}
+
+SPLConvergenceBehaviorNative SPLArchive::toNative(const SPLConvergenceBehavior& behavior) {
+    SPLConvergenceBehaviorNative native{};
+    native.target = behavior.target;
+    native.force = FX_F32_TO_FX16(behavior.force);
+    return native;
+}
+
+SPLTextureParamNative SPLArchive::toNative(const SPLTextureParam& param) {
+    SPLTextureParamNative native{};
+    native.all = 0;
+    native.format = (u32)param.format;
+    native.s = param.s;
+    native.t = param.t;
+    native.repeat = (u32)param.repeat;
+    native.flip = (u32)param.flip;
+    native.palColor0 = param.palColor0Transparent;
+    native.useSharedTexture = param.useSharedTexture;
+    native.sharedTexID = param.sharedTexID;
+    return native;
+}
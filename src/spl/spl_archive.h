@@ -1,24 +1,79 @@
 #pragma once
 
+#include <cmath>
 #include <concepts>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <span>
+#include <stop_token>
 #include <string_view>
 #include <vector>
 
+#include "memory_tracker.h"
 #include "spl_resource.h"
 #include "glm/gtc/constants.hpp"
 
 
 class SPLArchive {
 public:
-    explicit SPLArchive(const std::filesystem::path& filename);
+    using ResourceList = memory::TrackedVector<SPLResource, memory::Category::ArchiveData>;
+
+    // Receives the fraction of the file parsed so far, in [0, 1]
+    using ProgressCallback = std::function<void(f32)>;
+
+    SPLArchive();
+
+    // Without createTextures no GL context is needed, SPLTexture::glTexture stays empty
+    explicit SPLArchive(const std::filesystem::path& filename, bool createTextures = true);
+
+    // Reads the file without touching GL, so it can run on any thread.
+    // LZ10/LZ11 compressed files are decompressed in memory first, paths that go through
+    // .nds or .narc files ("effects.narc/0003.spa") are read from inside the container.
+    // Returns false if the file couldn't be read or the stop was requested.
+    bool parse(const std::filesystem::path& filename, std::stop_token stop = {}, const ProgressCallback& progress = {});
+
+    // Same as above for an archive that is already in memory, nothing is kept referencing the data
+    bool parse(std::span<const u8> data, std::stop_token stop = {}, const ProgressCallback& progress = {});
+
+    // Creates the GL textures for a parsed archive, must be called on the thread owning the GL context.
+    // Textures with the same contents are shared with other archives through g_texturePool.
+    // Calls are counted, archives shared between editors keep their textures until every
+    // createTextures is matched by a releaseTextures.
+    void createTextures();
+    void releaseTextures();
+
+    // Takes over the contents of another parsed archive, e.g. the same file read again after it changed.
+    // This object stays the same, so everything holding on to it sees the new contents. If it has textures,
+    // the new ones are created while the old ones are still alive, unchanged ones come back out of g_texturePool.
+    // other is left with the previous contents, pointers into them stay valid until other is destroyed.
+    void replaceContents(SPLArchive& other);
+
+    // Edited resources are converted back to the native structs by save(),
+    // everything else is copied over from the file as it was loaded
+    void markResourceDirty(size_t index);
+    bool isResourceDirty(size_t index) const { return index < m_dirtyResources.size() && m_dirtyResources[index]; }
+
+    // Writes the archive to a temporary file next to path and renames it over path, keeping its permissions.
+    // Clean resources and textures are copied from the file the archive was loaded from (with copy_file_range
+    // where available) as long as that file didn't change in the meantime, the rest is encoded again.
+    // Archives read out of a container or an LZ compressed file are encoded in full.
+    // Paths inside .narc and .nds files can't be written to.
+    bool save(const std::filesystem::path& path);
+
+    // Whether the file the archive was read from or last saved to is still the same as back then.
+    // Always false for archives that didn't come straight from a file.
+    bool isSourceUnchanged() const;
+
+    // Tracked bytes of the resource list, texture data and GL textures.
+    // GL textures shared with other archives are counted for each of them.
+    void getMemoryUsage(memory::Usage& usage) const;
 
     const SPLResource& getResource(size_t index) const { return m_resources[index]; }
     SPLResource& getResource(size_t index) { return m_resources[index]; }
 
-    const std::vector<SPLResource>& getResources() const { return m_resources; }
-    std::vector<SPLResource>& getResources() { return m_resources; }
+    const ResourceList& getResources() const { return m_resources; }
+    ResourceList& getResources() { return m_resources; }
 
     const SPLTexture& getTexture(size_t index) const { return m_textures[index]; }
     SPLTexture& getTexture(size_t index) { return m_textures[index]; }
@@ -28,14 +83,19 @@ public:
 
     u32 getTextureArray() const { return m_textureArray; }
 
+    // XXH64 of the data as it is on disk, i.e. as loaded or as last written by save(). Edits in between
+    // don't change them. Resources are hashed over their native bytes, textures over texture and palette data.
+    u64 getResourceHash(size_t index) const { return m_resourceHashes[index]; }
+    u64 getTextureHash(size_t index) const { return m_textureHashes[index]; }
+
+    static u64 hashTexture(std::span<const u8> textureData, std::span<const u8> paletteData);
+
     size_t getResourceCount() const { return m_resources.size(); }
     size_t getTextureCount() const { return m_header.texCount; }
 
     static constexpr u32 SPL_FRAMES_PER_SECOND = 30;
 
 private:
-    void load(const std::filesystem::path& filename);
-
     static SPLResourceHeader fromNative(const SPLResourceHeaderNative& native);
 
     SPLScaleAnim fromNative(const SPLScaleAnimNative& native);
@@ -53,6 +113,29 @@ private:
 
     SPLTextureParam fromNative(const SPLTextureParamNative& native);
 
+    static SPLResourceHeaderNative toNative(const SPLResourceHeader& header);
+
+    static SPLScaleAnimNative toNative(const SPLScaleAnim& anim);
+    static SPLColorAnimNative toNative(const SPLColorAnim& anim);
+    static SPLAlphaAnimNative toNative(const SPLAlphaAnim& anim);
+    static SPLTexAnimNative toNative(const SPLTexAnim& anim);
+    static SPLChildResourceNative toNative(const SPLChildResource& child);
+
+    static SPLGravityBehaviorNative toNative(const SPLGravityBehavior& behavior);
+    static SPLRandomBehaviorNative toNative(const SPLRandomBehavior& behavior);
+    static SPLMagnetBehaviorNative toNative(const SPLMagnetBehavior& behavior);
+    static SPLSpinBehaviorNative toNative(const SPLSpinBehavior& behavior);
+    static SPLCollisionPlaneBehaviorNative toNative(const SPLCollisionPlaneBehavior& behavior);
+    static SPLConvergenceBehaviorNative toNative(const SPLConvergenceBehavior& behavior);
+
+    static SPLTextureParamNative toNative(const SPLTextureParam& param);
+
+    // Appends the native representation, as it appears in the file
+    static void encodeResource(const SPLResource& resource, std::vector<u8>& out);
+    void encodeTexture(size_t index, std::vector<u8>& out) const;
+
+    void setSource(const std::filesystem::path& path);
+
     template<std::integral T = u32>
     static f32 toSeconds(T frames) {
         return static_cast<f32>(frames) / SPL_FRAMES_PER_SECOND;
@@ -60,7 +143,7 @@ private:
 
     template<std::integral T = u32>
     static T toFrames(f32 seconds) {
-        return static_cast<T>(seconds * SPL_FRAMES_PER_SECOND);
+        return static_cast<T>(std::lround(seconds * SPL_FRAMES_PER_SECOND));
     }
 
     template<std::integral T = u16>
@@ -70,16 +153,35 @@ private:
 
     template<std::integral T = u16>
     static T toIndex(f32 angle) {
-        return static_cast<T>(angle / glm::two_pi<f32>()) * (T)0xFFFF;
+        return static_cast<T>(std::lround(angle / glm::two_pi<f32>() * 65535.0f));
     }
 
 private:
+    struct SourceRange {
+        u64 offset;
+        u64 size;
+    };
+
     SPLFileHeader m_header;
-    std::vector<SPLResource> m_resources;
+    ResourceList m_resources;
     std::vector<SPLTexture> m_textures;
-    std::vector<std::vector<u8>> m_textureData;
-    std::vector<std::vector<u8>> m_paletteData;
-    u32 m_textureArray;
+    std::vector<TextureBuffer> m_textureData;
+    std::vector<TextureBuffer> m_paletteData;
+    std::vector<u64> m_resourceHashes;
+    std::vector<u64> m_textureHashes;
+    std::vector<SPLTextureResource> m_textureResources; // As read, SPLTexture::resource points in here
+    u32 m_textureArray = 0;
+    u32 m_textureUsers = 0;
+
+    // Where each resource and texture is in the parsed data. m_sourcePath is only set if that data
+    // is the file itself, the size and write time tell whether it was modified since.
+    std::vector<SourceRange> m_resourceRanges;
+    std::vector<SourceRange> m_textureRanges;
+    std::filesystem::path m_sourcePath;
+    u64 m_sourceSize = 0;
+    std::filesystem::file_time_type m_sourceWriteTime;
+
+    std::vector<bool> m_dirtyResources;
 
     friend struct SPLBehavior;
 };
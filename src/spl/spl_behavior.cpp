@@ -4,6 +4,7 @@
 #include "spl_emitter.h"
 #include "spl_particle.h"
 
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 
 
@@ -14,17 +15,16 @@ void SPLGravityBehavior::apply(SPLParticle& particle, glm::vec3& acceleration, S
 SPLRandomBehavior::SPLRandomBehavior(const SPLRandomBehaviorNative& native) : SPLBehavior(SPLBehaviorType::Random) {
     magnitude = native.magnitude.toVec3();
     applyInterval = (f32)native.applyInterval / SPLArchive::SPL_FRAMES_PER_SECOND;
-    lastApplication = std::chrono::steady_clock::now();
 }
 
 void SPLRandomBehavior::apply(SPLParticle& particle, glm::vec3& acceleration, SPLEmitter& emitter, float dt) {
-    const auto now = std::chrono::steady_clock::now();
-    const auto delta = std::chrono::duration_cast<std::chrono::duration<float>>(now - lastApplication);
-    if (delta.count() >= applyInterval) {
+    // Applied on every frame where the emitter's age crosses a multiple of the interval (age % interval == 0 on hardware).
+    // This only depends on simulated time, so two runs with the same time steps apply it on the same frames.
+    const f32 age = emitter.m_age;
+    if (applyInterval <= 0.0f || std::floor(age / applyInterval) != std::floor((age - dt) / applyInterval)) {
         acceleration.x += random::aroundZero(magnitude.x);
         acceleration.y += random::aroundZero(magnitude.y);
         acceleration.z += random::aroundZero(magnitude.z);
-        lastApplication = now;
     }
 }
 
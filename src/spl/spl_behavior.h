@@ -100,15 +100,13 @@ struct SPLGravityBehavior : SPLBehavior {
 struct SPLRandomBehavior : SPLBehavior {
     glm::vec3 magnitude;
     f32 applyInterval;
-    std::chrono::time_point<std::chrono::steady_clock> lastApplication;
 
     explicit SPLRandomBehavior(const SPLRandomBehaviorNative& native);
 
     SPLRandomBehavior(const glm::vec3& mag, f32 interval)
         : SPLBehavior(SPLBehaviorType::Random)
         , magnitude(mag)
-        , applyInterval(interval)
-        , lastApplication(std::chrono::steady_clock::now()) {}
+        , applyInterval(interval) {}
 
     void apply(SPLParticle& particle, glm::vec3& acceleration, SPLEmitter& emitter, float dt) override;
 };
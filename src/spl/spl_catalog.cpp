@@ -0,0 +1,438 @@
+#include "spl_catalog.h"
+#include "spl_archive.h"
+#include "spl_behavior.h"
+#include "spl_resource.h"
+#include "hash.h"
+#include "lz.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+
+namespace {
+
+// On-disk layout of an entry, followed by the path
+struct CatalogRecord {
+    u64 fileSize;
+    s64 lastWrite;
+    u64 hash;
+    u32 textureBytes;
+    u16 resourceCount;
+    u16 textureCount;
+    u16 maxTextureWidth;
+    u16 maxTextureHeight;
+    u8 textureFormats;
+    u8 drawTypes;
+    u8 behaviors;
+    u8 features;
+    u16 pathLength;
+    u16 reserved[3];
+};
+
+static_assert(sizeof(CatalogRecord) == 48);
+
+// Followed by textureCount texture records, then resourceCount resource records
+struct CatalogTextureRecord {
+    u64 hash;
+    u16 width;
+    u16 height;
+    u8 format;
+    u8 reserved[3];
+};
+
+static_assert(sizeof(CatalogTextureRecord) == 16);
+
+struct CatalogResourceRecord {
+    u64 hash;
+    u8 emissionType;
+    u8 drawType;
+    u8 behaviors;
+    u8 features;
+    u8 textureCount;
+    u8 textures[SPLCatalogResource::MAX_TEXTURES];
+    u8 reserved;
+};
+
+static_assert(sizeof(CatalogResourceRecord) == 24);
+
+struct CatalogHeader {
+    u32 magic;
+    u32 version;
+    u32 count;
+};
+
+// Bounds checked sequential reads over a file in memory
+class Reader {
+public:
+    explicit Reader(std::span<const u8> data) : m_data(data) {}
+
+    template<class T> requires std::is_trivially_copyable_v<T>
+    bool read(T& value) {
+        if (m_offset + sizeof(T) > m_data.size()) {
+            return false;
+        }
+
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return true;
+    }
+
+    template<class T>
+    bool skip() {
+        return skip(sizeof(T));
+    }
+
+    bool skip(size_t size) {
+        if (m_offset + size > m_data.size()) {
+            return false;
+        }
+
+        m_offset += size;
+        return true;
+    }
+
+    size_t getOffset() const { return m_offset; }
+    void seek(size_t offset) { m_offset = offset; }
+
+private:
+    std::span<const u8> m_data;
+    size_t m_offset = 0;
+};
+
+}
+
+
+std::optional<SPLCatalogEntry> SPLCatalog::index(const std::filesystem::path& file) {
+    // Deleted files are reindexed when the watcher reports them, that's not worth an error
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(file, ec)) {
+        return std::nullopt;
+    }
+
+    MappedFile mapped(file);
+    if (!mapped.isOpen()) {
+        return std::nullopt;
+    }
+
+    return index(mapped.getData());
+}
+
+std::optional<SPLCatalogEntry> SPLCatalog::index(std::span<const u8> data) {
+    SPLCatalogEntry entry{};
+    entry.fileSize = data.size();
+
+    std::optional<std::vector<u8>> decompressed;
+    if (lz::isCompressed(data)) {
+        decompressed = lz::decompress(data);
+        if (!decompressed) {
+            return std::nullopt;
+        }
+
+        data = *decompressed;
+    }
+
+    entry.hash = hash::xxh64(data);
+
+    Reader reader(data);
+    SPLFileHeader header;
+    if (!reader.read(header)) {
+        return std::nullopt;
+    }
+
+    entry.resourceCount = header.resCount;
+    entry.textureCount = header.texCount;
+
+    // Same layout as SPLArchive::parse, but only the flags are needed
+    for (size_t i = 0; i < header.resCount; i++) {
+        const size_t start = reader.getOffset();
+
+        SPLResourceHeaderNative resource;
+        if (!reader.read(resource)) {
+            return std::nullopt;
+        }
+
+        const auto& flags = resource.flags;
+        auto& summary = entry.resources.emplace_back();
+        summary.emissionType = (u8)flags.emissionType;
+        summary.drawType = (u8)flags.drawType;
+        summary.features = (flags.hasScaleAnim ? SPLCatalogEntry::ScaleAnim : 0)
+            | (flags.hasColorAnim ? SPLCatalogEntry::ColorAnim : 0)
+            | (flags.hasAlphaAnim ? SPLCatalogEntry::AlphaAnim : 0)
+            | (flags.hasTexAnim ? SPLCatalogEntry::TexAnim : 0)
+            | (flags.hasChildResource ? SPLCatalogEntry::ChildResource : 0);
+
+        const auto behavior = [&](bool present, SPLBehaviorType type) {
+            if (present) {
+                summary.behaviors |= 1 << (u32)type;
+            }
+        };
+
+        const auto reference = [&](u8 texture) {
+            const auto end = summary.textures.begin() + summary.textureCount;
+            if (summary.textureCount < summary.textures.size() && std::find(summary.textures.begin(), end, texture) == end) {
+                summary.textures[summary.textureCount++] = texture;
+            }
+        };
+
+        behavior(flags.hasGravityBehavior, SPLBehaviorType::Gravity);
+        behavior(flags.hasRandomBehavior, SPLBehaviorType::Random);
+        behavior(flags.hasMagnetBehavior, SPLBehaviorType::Magnet);
+        behavior(flags.hasSpinBehavior, SPLBehaviorType::Spin);
+        behavior(flags.hasCollisionPlaneBehavior, SPLBehaviorType::CollisionPlane);
+        behavior(flags.hasConvergenceBehavior, SPLBehaviorType::Convergence);
+
+        reference((u8)resource.misc.textureIndex);
+
+        SPLTexAnimNative texAnim;
+        SPLChildResourceNative child;
+        const bool ok = (!flags.hasScaleAnim || reader.skip<SPLScaleAnimNative>())
+            && (!flags.hasColorAnim || reader.skip<SPLColorAnimNative>())
+            && (!flags.hasAlphaAnim || reader.skip<SPLAlphaAnimNative>())
+            && (!flags.hasTexAnim || reader.read(texAnim))
+            && (!flags.hasChildResource || reader.read(child))
+            && (!flags.hasGravityBehavior || reader.skip<SPLGravityBehaviorNative>())
+            && (!flags.hasRandomBehavior || reader.skip<SPLRandomBehaviorNative>())
+            && (!flags.hasMagnetBehavior || reader.skip<SPLMagnetBehaviorNative>())
+            && (!flags.hasSpinBehavior || reader.skip<SPLSpinBehaviorNative>())
+            && (!flags.hasCollisionPlaneBehavior || reader.skip<SPLCollisionPlaneBehaviorNative>())
+            && (!flags.hasConvergenceBehavior || reader.skip<SPLConvergenceBehaviorNative>());
+
+        if (!ok) {
+            return std::nullopt;
+        }
+
+        summary.hash = hash::xxh64(data.subspan(start, reader.getOffset() - start));
+
+        if (flags.hasTexAnim) {
+            for (u32 frame = 0; frame < std::min<u32>(texAnim.param.frameCount, 8); frame++) {
+                reference(texAnim.textures[frame]);
+            }
+        }
+
+        if (flags.hasChildResource) {
+            reference((u8)child.misc.texture);
+        }
+
+        entry.drawTypes |= 1 << summary.drawType;
+        entry.behaviors |= summary.behaviors;
+        entry.features |= summary.features;
+    }
+
+    for (size_t i = 0; i < header.texCount; i++) {
+        const size_t offset = reader.getOffset();
+
+        SPLTextureResource texture;
+        if (!reader.read(texture) || texture.resourceSize < sizeof(SPLTextureResource)) {
+            return std::nullopt;
+        }
+
+        auto& summary = entry.textures.emplace_back();
+        summary.format = (u8)texture.param.format;
+        summary.width = (u16)(1 << (texture.param.s + 3));
+        summary.height = (u16)(1 << (texture.param.t + 3));
+
+        entry.textureFormats |= 1 << summary.format;
+        entry.maxTextureWidth = std::max(entry.maxTextureWidth, summary.width);
+        entry.maxTextureHeight = std::max(entry.maxTextureHeight, summary.height);
+
+        if (texture.param.useSharedTexture) {
+            summary.hash = texture.param.sharedTexID < i ? entry.textures[texture.param.sharedTexID].hash : 0;
+        } else {
+            entry.textureBytes += texture.textureSize + texture.paletteSize;
+
+            // Same bytes as SPLArchive::parse reads
+            const size_t dataOffset = offset + sizeof(SPLTextureResource);
+            const size_t paletteOffset = offset + texture.paletteOffset;
+            if (dataOffset + texture.textureSize > data.size() || paletteOffset + texture.paletteSize > data.size()) {
+                return std::nullopt;
+            }
+
+            summary.hash = SPLArchive::hashTexture(data.subspan(dataOffset, texture.textureSize), data.subspan(paletteOffset, texture.paletteSize));
+        }
+
+        reader.seek(offset);
+        if (!reader.skip(texture.resourceSize)) {
+            return std::nullopt;
+        }
+    }
+
+    return entry;
+}
+
+bool SPLCatalog::load(const std::filesystem::path& path) {
+    m_entries.clear();
+
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    CatalogHeader header;
+    stream.read((char*)&header, sizeof(header));
+    if (!stream || header.magic != CATALOG_MAGIC || header.version != CATALOG_VERSION) {
+        spdlog::info("Ignoring outdated or invalid catalog: {}", path.string());
+        return false;
+    }
+
+    m_entries.reserve(header.count);
+    for (u32 i = 0; i < header.count; i++) {
+        CatalogRecord record;
+        stream.read((char*)&record, sizeof(record));
+
+        std::string relativePath(record.pathLength, '\0');
+        stream.read(relativePath.data(), record.pathLength);
+
+        std::vector<CatalogTextureRecord> textures(record.textureCount);
+        std::vector<CatalogResourceRecord> resources(record.resourceCount);
+        stream.read((char*)textures.data(), (std::streamsize)(textures.size() * sizeof(CatalogTextureRecord)));
+        stream.read((char*)resources.data(), (std::streamsize)(resources.size() * sizeof(CatalogResourceRecord)));
+
+        if (!stream) {
+            spdlog::warn("Truncated catalog: {}", path.string());
+            m_entries.clear();
+            return false;
+        }
+
+        auto& entry = m_entries[relativePath];
+        entry = {
+            .path = relativePath,
+            .fileSize = record.fileSize,
+            .lastWrite = record.lastWrite,
+            .hash = record.hash,
+            .resourceCount = record.resourceCount,
+            .textureCount = record.textureCount,
+            .textureBytes = record.textureBytes,
+            .maxTextureWidth = record.maxTextureWidth,
+            .maxTextureHeight = record.maxTextureHeight,
+            .textureFormats = record.textureFormats,
+            .drawTypes = record.drawTypes,
+            .behaviors = record.behaviors,
+            .features = record.features,
+            .resources = {},
+            .textures = {}
+        };
+
+        entry.textures.reserve(textures.size());
+        for (const auto& texture : textures) {
+            entry.textures.push_back({ .hash = texture.hash, .width = texture.width, .height = texture.height, .format = texture.format });
+        }
+
+        entry.resources.reserve(resources.size());
+        for (const auto& resource : resources) {
+            auto& summary = entry.resources.emplace_back();
+            summary.hash = resource.hash;
+            summary.emissionType = resource.emissionType;
+            summary.drawType = resource.drawType;
+            summary.behaviors = resource.behaviors;
+            summary.features = resource.features;
+            summary.textureCount = std::min<u8>(resource.textureCount, SPLCatalogResource::MAX_TEXTURES);
+            std::copy_n(resource.textures, SPLCatalogResource::MAX_TEXTURES, summary.textures.begin());
+        }
+    }
+
+    return true;
+}
+
+bool SPLCatalog::save(const std::filesystem::path& path) const {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    // Write next to the target and rename so a crash never leaves a half written catalog
+    auto temp = path;
+    temp += ".tmp";
+
+    {
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            spdlog::error("Failed to write catalog: {}", temp.string());
+            return false;
+        }
+
+        const CatalogHeader header = { CATALOG_MAGIC, CATALOG_VERSION, (u32)m_entries.size() };
+        stream.write((const char*)&header, sizeof(header));
+
+        for (const auto& [relativePath, entry] : m_entries) {
+            const CatalogRecord record = {
+                .fileSize = entry.fileSize,
+                .lastWrite = entry.lastWrite,
+                .hash = entry.hash,
+                .textureBytes = entry.textureBytes,
+                .resourceCount = (u16)entry.resources.size(),
+                .textureCount = (u16)entry.textures.size(),
+                .maxTextureWidth = entry.maxTextureWidth,
+                .maxTextureHeight = entry.maxTextureHeight,
+                .textureFormats = entry.textureFormats,
+                .drawTypes = entry.drawTypes,
+                .behaviors = entry.behaviors,
+                .features = entry.features,
+                .pathLength = (u16)relativePath.size(),
+                .reserved = {}
+            };
+
+            stream.write((const char*)&record, sizeof(record));
+            stream.write(relativePath.data(), (std::streamsize)relativePath.size());
+
+            for (const auto& texture : entry.textures) {
+                const CatalogTextureRecord textureRecord = {
+                    .hash = texture.hash,
+                    .width = texture.width,
+                    .height = texture.height,
+                    .format = texture.format,
+                    .reserved = {}
+                };
+
+                stream.write((const char*)&textureRecord, sizeof(textureRecord));
+            }
+
+            for (const auto& resource : entry.resources) {
+                CatalogResourceRecord resourceRecord = {
+                    .hash = resource.hash,
+                    .emissionType = resource.emissionType,
+                    .drawType = resource.drawType,
+                    .behaviors = resource.behaviors,
+                    .features = resource.features,
+                    .textureCount = resource.textureCount,
+                    .textures = {},
+                    .reserved = 0
+                };
+
+                std::ranges::copy(resource.textures, resourceRecord.textures);
+                stream.write((const char*)&resourceRecord, sizeof(resourceRecord));
+            }
+        }
+
+        if (!stream) {
+            spdlog::error("Failed to write catalog: {}", temp.string());
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        spdlog::error("Failed to replace catalog {}: {}", path.string(), ec.message());
+        return false;
+    }
+
+    return true;
+}
+
+const SPLCatalogEntry* SPLCatalog::find(const std::string& relativePath) const {
+    const auto it = m_entries.find(relativePath);
+    return it != m_entries.end() ? &it->second : nullptr;
+}
+
+void SPLCatalog::insert(SPLCatalogEntry entry) {
+    auto key = entry.path;
+    m_entries[std::move(key)] = std::move(entry);
+}
+
+void SPLCatalog::erase(const std::string& relativePath) {
+    m_entries.erase(relativePath);
+}
+
+void SPLCatalog::erasePrefix(std::string_view prefix) {
+    std::erase_if(m_entries, [prefix](const auto& pair) { return pair.first.starts_with(prefix); });
+}
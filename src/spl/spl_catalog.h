@@ -0,0 +1,93 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+struct SPLCatalogTexture {
+    u64 hash = 0; // SPLArchive::hashTexture, shared textures report their owner's
+    u16 width = 0;
+    u16 height = 0;
+    u8 format = 0; // TextureFormat
+};
+
+struct SPLCatalogResource {
+    static constexpr size_t MAX_TEXTURES = 10; // Texture, 8 texture animation frames, child texture
+
+    u64 hash = 0; // Same as SPLArchive::getResourceHash
+    u8 emissionType = 0; // SPLEmissionType
+    u8 drawType = 0; // SPLDrawType
+    u8 behaviors = 0; // 1 << SPLBehaviorType
+    u8 features = 0; // SPLCatalogEntry::Feature
+    u8 textureCount = 0;
+    std::array<u8, MAX_TEXTURES> textures = {}; // Indices of every texture the resource can show
+};
+
+// Summary of an .spa file that can be gathered without creating an SPLArchive
+struct SPLCatalogEntry {
+    enum Feature : u8 {
+        ScaleAnim = 1 << 0,
+        ColorAnim = 1 << 1,
+        AlphaAnim = 1 << 2,
+        TexAnim = 1 << 3,
+        ChildResource = 1 << 4
+    };
+
+    std::string path; // Relative to the project root, generic format
+
+    // Used to decide whether the file has to be indexed again
+    u64 fileSize = 0;
+    s64 lastWrite = 0; // file_time_type ticks
+
+    u64 hash = 0; // XXH64 of the (decompressed) file contents
+    u16 resourceCount = 0;
+    u16 textureCount = 0;
+    u32 textureBytes = 0; // Texture and palette data
+    u16 maxTextureWidth = 0;
+    u16 maxTextureHeight = 0;
+    u8 textureFormats = 0; // 1 << TextureFormat
+    u8 drawTypes = 0; // 1 << SPLDrawType
+    u8 behaviors = 0; // 1 << SPLBehaviorType
+    u8 features = 0; // Feature
+
+    std::vector<SPLCatalogResource> resources;
+    std::vector<SPLCatalogTexture> textures;
+
+    bool hasTextureFormat(TextureFormat format) const { return textureFormats & (1 << (u32)format); }
+};
+
+// Persistent index of the SPL files in a project
+class SPLCatalog {
+public:
+    // Reads the headers of an .spa file, which may be LZ compressed, returns nothing if it isn't one
+    static std::optional<SPLCatalogEntry> index(const std::filesystem::path& file);
+
+    // Same for a file that is already in memory, e.g. inside a ROM. The path of the entry is left empty.
+    static std::optional<SPLCatalogEntry> index(std::span<const u8> data);
+
+    bool load(const std::filesystem::path& path);
+    bool save(const std::filesystem::path& path) const;
+
+    const SPLCatalogEntry* find(const std::string& relativePath) const;
+    void insert(SPLCatalogEntry entry);
+    void erase(const std::string& relativePath);
+    void erasePrefix(std::string_view prefix);
+    void clear() { m_entries.clear(); }
+
+    const std::unordered_map<std::string, SPLCatalogEntry>& getEntries() const { return m_entries; }
+    size_t size() const { return m_entries.size(); }
+
+private:
+    static constexpr u32 CATALOG_MAGIC = 0x4E464358; // 'NFCX'
+    static constexpr u32 CATALOG_VERSION = 3;
+
+    std::unordered_map<std::string, SPLCatalogEntry> m_entries;
+};
@@ -0,0 +1,103 @@
+#include "spl_container_scanner.h"
+#include "lz.h"
+#include "narc.h"
+#include "nds_rom.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+
+namespace {
+
+constexpr u32 s_splMagic = 0x53504120; // ' APS'
+constexpr u32 s_maxWorkers = 16;
+
+}
+
+
+bool SPLContainerScanner::isContainer(const std::filesystem::path& path) {
+    return NdsRom::isRomFile(path) || NarcArchive::isNarcFile(path);
+}
+
+std::optional<std::vector<SPLCatalogEntry>> SPLContainerScanner::scan(const std::filesystem::path& path, std::stop_token stop) {
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto fs = NitroFS::load(path);
+    if (!fs) {
+        return std::nullopt;
+    }
+
+    // Files are handed out one at a time, their sizes vary way too much for fixed ranges
+    const auto& files = fs->getFiles();
+    const u32 workerCount = std::clamp<u32>(std::thread::hardware_concurrency(), 1, s_maxWorkers);
+    std::vector<std::vector<SPLCatalogEntry>> results(workerCount);
+    std::atomic<size_t> next = 0;
+
+    {
+        std::vector<std::jthread> workers;
+        for (u32 worker = 0; worker < workerCount; worker++) {
+            workers.emplace_back([&, worker] {
+                for (size_t i = next++; i < files.size() && !stop.stop_requested(); i = next++) {
+                    scanFile(fs->getData(i), files[i].path, 0, results[worker]);
+                }
+            });
+        }
+    }
+
+    if (stop.stop_requested()) {
+        return std::nullopt;
+    }
+
+    std::vector<SPLCatalogEntry> entries;
+    for (auto& result : results) {
+        std::ranges::move(result, std::back_inserter(entries));
+    }
+
+    std::ranges::sort(entries, {}, &SPLCatalogEntry::path);
+
+    spdlog::info("Scanned {}: {} files, {} SPL archives in {:.1f} ms",
+        path.string(),
+        files.size(),
+        entries.size(),
+        std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count()
+    );
+
+    return entries;
+}
+
+void SPLContainerScanner::scanFile(std::span<const u8> data, const std::string& path, u32 depth, std::vector<SPLCatalogEntry>& entries) {
+    std::vector<u8> decompressed;
+    if (const auto header = lz::readHeader(data)) {
+        decompressed.resize(header->size);
+        if (!lz::decompress(data, *header, decompressed)) {
+            return;
+        }
+
+        data = decompressed;
+    }
+
+    u32 magic = 0;
+    if (data.size() >= sizeof(magic)) {
+        std::memcpy(&magic, data.data(), sizeof(magic));
+    }
+
+    if (magic == s_splMagic) {
+        if (auto entry = SPLCatalog::index(data)) {
+            entry->path = path;
+            entries.push_back(std::move(*entry));
+        }
+    } else if (NarcArchive::isNarc(data) && depth < MAX_DEPTH) {
+        NarcArchive narc;
+        if (!narc.open(data)) {
+            return;
+        }
+
+        for (size_t i = 0; i < narc.getFiles().size(); i++) {
+            scanFile(narc.getData(i), path + '/' + narc.getFiles()[i].path, depth + 1, entries);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "spl_catalog.h"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+
+// Finds the SPL archives inside NDS ROMs and NARC files by their magic, including ones in
+// nested NARCs and LZ compressed files. The files of a container are scanned in parallel.
+class SPLContainerScanner {
+public:
+    static bool isContainer(const std::filesystem::path& path);
+
+    // Entry paths are relative to the container ("a/0/4/2/0003.spa"), so they can be appended to its path
+    // and opened through NitroFS::readFile. Returns nothing if the container couldn't be read or the stop was requested.
+    static std::optional<std::vector<SPLCatalogEntry>> scan(const std::filesystem::path& path, std::stop_token stop = {});
+
+private:
+    static void scanFile(std::span<const u8> data, const std::string& path, u32 depth, std::vector<SPLCatalogEntry>& entries);
+
+    static constexpr u32 MAX_DEPTH = 4; // NARCs inside NARCs
+};
@@ -0,0 +1,118 @@
+#include "spl_cost_estimator.h"
+#include "spl_archive.h"
+#include "editor/ds_budget.h"
+#include "editor/particle_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+// Emitters and particles are updated once per frame, an interval of 0 means every frame
+constexpr f32 s_frameTime = 1.0f / SPLArchive::SPL_FRAMES_PER_SECOND;
+
+f32 toInterval(f32 interval) {
+    return std::max(interval, s_frameTime);
+}
+
+// Number of times something fires when it fires at t = 0 and then every interval until duration
+f32 countEmissions(f32 duration, f32 interval) {
+    return std::floor(std::max(duration, 0.0f) / interval) + 1.0f;
+}
+
+}
+
+
+SPLCostEstimate SPLCostEstimator::estimate(const SPLResource& resource, std::span<const SPLTexture> textures) {
+    const auto& header = resource.header;
+    SPLCostEstimate cost{};
+
+    // Emission happens on the first frame and then every interval while age <= emitterLifeTime.
+    // An interval of 0 emits every frame regardless of the emitter lifetime.
+    const f32 interval = toInterval(header.misc.emissionInterval);
+    const f32 cycle = std::max(header.emitterLifeTime, interval);
+    const f32 batches = header.misc.emissionInterval == 0.0f
+        ? std::ceil(cycle / s_frameTime)
+        : countEmissions(header.emitterLifeTime, interval);
+    const f32 count = (f32)header.emissionCount;
+
+    // Lifetimes are picked uniformly from [lifeTime * (1 - variance), lifeTime]
+    const f32 maxLife = header.particleLifeTime;
+    const f32 meanLife = maxLife * (1.0f - header.variance.lifeTime * 0.5f);
+
+    cost.emissionRate = count * batches / cycle;
+    cost.steadyParticles = cost.emissionRate * meanLife;
+
+    // At most ceil(maxLife / interval) batches can be alive at once. Looping can't exceed that
+    // either, and when there are gaps between cycles it stays closer to rate * maxLife.
+    const f32 overlappingBatches = std::ceil(maxLife / interval);
+    const f32 singleShotPeak = count * std::min(batches, overlappingBatches);
+    const f32 loopedPeak = std::min(count * overlappingBatches, cost.emissionRate * maxLife + count);
+    cost.peakParticles = std::max(singleShotPeak, loopedPeak);
+
+    if (header.flags.hasChildResource && resource.childResource) {
+        const auto& child = resource.childResource.value();
+
+        // Children are emitted from emissionDelay * lifeTime until the parent dies
+        const f32 childInterval = toInterval(child.misc.emissionInterval);
+        const f32 childCount = (f32)child.misc.emissionCount;
+        const f32 emissionsPerParent = countEmissions(meanLife * (1.0f - child.misc.emissionDelay), childInterval);
+        const f32 maxEmissionsPerParent = countEmissions(maxLife * (1.0f - child.misc.emissionDelay), childInterval);
+
+        cost.steadyChildren = cost.emissionRate * emissionsPerParent * childCount * child.lifeTime;
+
+        const f32 overlappingChildBatches = std::min(maxEmissionsPerParent, std::ceil(child.lifeTime / childInterval));
+        cost.peakChildren = cost.peakParticles * childCount * overlappingChildBatches;
+    }
+
+    cost.peakInstanceBytes = (u32)std::ceil(cost.getPeakTotal()) * sizeof(ParticleInstance);
+
+    // Collect every texture the resource can reference
+    std::vector<bool> resident(textures.size(), false);
+    const auto reference = [&](size_t index) {
+        if (index >= textures.size()) {
+            return;
+        }
+
+        const auto& param = textures[index].param;
+        const size_t owner = param.useSharedTexture ? param.sharedTexID : index;
+        if (owner < resident.size()) {
+            resident[owner] = true;
+        }
+    };
+
+    reference(header.misc.textureIndex);
+
+    if (header.flags.hasTexAnim && resource.texAnim) {
+        const auto& anim = resource.texAnim.value();
+        for (u32 i = 0; i < std::min<u32>(anim.param.textureCount, 8); i++) {
+            reference(anim.textures[i]);
+        }
+    }
+
+    if (header.flags.hasChildResource && resource.childResource) {
+        reference(resource.childResource->misc.texture);
+    }
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        if (resident[i]) {
+            ++cost.textureCount;
+            cost.textureBytes += DSBudgetTracker::getTextureVRAMSize(textures[i]);
+            cost.paletteBytes += DSBudgetTracker::getPaletteVRAMSize(textures[i]);
+        }
+    }
+
+    return cost;
+}
+
+std::vector<SPLCostEstimate> SPLCostEstimator::estimate(const SPLArchive& archive) {
+    std::vector<SPLCostEstimate> costs;
+    costs.reserve(archive.getResourceCount());
+
+    for (const auto& resource : archive.getResources()) {
+        costs.push_back(estimate(resource, archive.getTextures()));
+    }
+
+    return costs;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "types.h"
+#include "spl_resource.h"
+
+#include <span>
+#include <vector>
+
+
+class SPLArchive;
+
+// Expected cost of a resource, derived from its parameters alone.
+// Steady state numbers assume the emitter is played looped, peak numbers cover both
+// single shot and looped playback.
+struct SPLCostEstimate {
+    f32 emissionRate; // Parent particles emitted per second while the emitter is active
+    f32 steadyParticles;
+    f32 peakParticles;
+    f32 steadyChildren;
+    f32 peakChildren;
+    u32 peakInstanceBytes; // Per-frame instance upload at peak
+    u32 textureCount; // Textures the resource can reference, shared textures resolved
+    u32 textureBytes; // DS VRAM of those textures
+    u32 paletteBytes;
+
+    f32 getSteadyTotal() const { return steadyParticles + steadyChildren; }
+    f32 getPeakTotal() const { return peakParticles + peakChildren; }
+};
+
+class SPLCostEstimator {
+public:
+    static SPLCostEstimate estimate(const SPLResource& resource, std::span<const SPLTexture> textures);
+    static std::vector<SPLCostEstimate> estimate(const SPLArchive& archive);
+};
@@ -20,72 +20,77 @@ SPLEmitter::SPLEmitter(const SPLResource* resource, ParticleSystem* system, bool
     m_age = 0;
     m_emissionTimer = 0;
 
-    m_axis = resource->header.axis;
-    m_initAngle = resource->header.initAngle;
-    m_emissionCount = resource->header.emissionCount;
-    m_radius = resource->header.radius;
-    m_length = resource->header.length;
-    m_initVelPositionAmplifier = resource->header.initVelPosAmplifier;
-    m_initVelAxisAmplifier = resource->header.initVelAxisAmplifier;
-    m_baseScale = resource->header.baseScale;
-    m_particleLifeTime = resource->header.particleLifeTime;
-
-    m_color = resource->header.color;
-    m_emissionInterval = resource->header.misc.emissionInterval;
-    m_baseAlpha = resource->header.misc.baseAlpha;
     m_updateCycle = 0;
     m_collisionPlaneHeight = std::numeric_limits<f32>::min();
 
+    applyResource();
+
+    m_crossAxis1 = {};
+    m_crossAxis2 = {};
+}
+
+SPLEmitter::~SPLEmitter() = default;
+
+void SPLEmitter::setResource(const SPLResource* resource) {
+    m_resource = resource;
+    applyResource();
+}
+
+void SPLEmitter::applyResource() {
+    const auto& header = m_resource->header;
+    const auto& child = m_resource->childResource;
+
+    m_axis = header.axis;
+    m_initAngle = header.initAngle;
+    m_emissionCount = header.emissionCount;
+    m_radius = header.radius;
+    m_length = header.length;
+    m_initVelPositionAmplifier = header.initVelPosAmplifier;
+    m_initVelAxisAmplifier = header.initVelAxisAmplifier;
+    m_baseScale = header.baseScale;
+    m_particleLifeTime = header.particleLifeTime;
+
+    m_color = header.color;
+    m_emissionInterval = header.misc.emissionInterval;
+    m_baseAlpha = header.misc.baseAlpha;
+
     // Textures can only be tiled in powers of 2
     m_texCoords = {
-        glm::pow(2.0f, resource->header.misc.textureTileCountS),
-        glm::pow(2.0f, resource->header.misc.textureTileCountT)
+        glm::pow(2.0f, header.misc.textureTileCountS),
+        glm::pow(2.0f, header.misc.textureTileCountT)
     };
 
-    if (resource->header.misc.flipTextureS) {
+    if (header.misc.flipTextureS) {
         m_texCoords.x = -m_texCoords.x;
     }
 
-    if (resource->header.misc.flipTextureT) {
+    if (header.misc.flipTextureT) {
         m_texCoords.y = -m_texCoords.y;
     }
 
-    if (resource->header.flags.hasChildResource && resource->childResource) {
+    if (header.flags.hasChildResource && child) {
         m_childTexCoords = {
-            glm::pow(2.0f, resource->childResource->misc.textureTileCountS),
-            glm::pow(2.0f, resource->childResource->misc.textureTileCountT)
+            glm::pow(2.0f, child->misc.textureTileCountS),
+            glm::pow(2.0f, child->misc.textureTileCountT)
         };
 
-        if (resource->childResource->misc.flipTextureS) {
+        if (child->misc.flipTextureS) {
             m_childTexCoords.x = -m_childTexCoords.x;
         }
 
-        if (resource->childResource->misc.flipTextureT) {
+        if (child->misc.flipTextureT) {
             m_childTexCoords.y = -m_childTexCoords.y;
         }
     }
-
-    m_crossAxis1 = {};
-    m_crossAxis2 = {};
 }
 
-SPLEmitter::~SPLEmitter() = default;
-
 void SPLEmitter::update(float deltaTime) {
     const auto& header = m_resource->header;
     constexpr auto wrap_f32 = [](f32 x) { return x - std::floor(x); };
 
-    if (!m_state.terminate) {
-        if (header.misc.emissionInterval == 0.0f || m_age == 0.0f) { // Special handling for the first frame, where lifeTime == emissionInterval
-            emit((u32)header.emissionCount);
-        } else {
-            if (m_age <= header.emitterLifeTime) {
-                while (m_emissionTimer >= header.misc.emissionInterval) {
-                    emit((u32)header.emissionCount);
-                    m_emissionTimer -= header.misc.emissionInterval;
-                }
-            }
-        }
+    const u32 emissions = consumeEmissions();
+    for (u32 i = 0; i < emissions; ++i) {
+        emit((u32)header.emissionCount);
     }
 
     struct AnimFunc {
@@ -223,13 +228,7 @@ void SPLEmitter::update(float deltaTime) {
         }
     }
 
-    m_age += deltaTime;
-    m_emissionTimer += deltaTime;
-
-    if (m_state.looping && m_age > header.emitterLifeTime) {
-        m_age = 0;
-        m_emissionTimer = 0;
-    }
+    advanceTimers(deltaTime);
 
     for (const auto ptcl : particlesToRemove) {
         std::erase(m_particles, ptcl);
@@ -468,17 +467,48 @@ void SPLEmitter::emitChildren(const SPLParticle& parent, u32 count) {
 }
 
 bool SPLEmitter::shouldTerminate() const {
-    #define EITHER(a, b) ((a) || (b))
+    return isFinished() && m_particles.empty() && m_childParticles.empty();
+}
 
+bool SPLEmitter::isFinished() const {
     if (m_state.looping && !m_state.terminate) {
         return false;
     }
 
     const auto& header = m_resource->header;
-    return EITHER(
-        header.flags.selfMaintaining && header.emitterLifeTime > 0 && m_state.started && m_age >= header.emitterLifeTime,
-        m_state.terminate
-    ) && m_particles.empty() && m_childParticles.empty();
+    return (header.flags.selfMaintaining && header.emitterLifeTime > 0 && m_state.started && m_age >= header.emitterLifeTime)
+        || m_state.terminate;
+}
+
+u32 SPLEmitter::consumeEmissions() {
+    if (m_state.terminate) {
+        return 0;
+    }
+
+    const auto& header = m_resource->header;
+    if (header.misc.emissionInterval == 0.0f || m_age == 0.0f) { // Special handling for the first frame, where lifeTime == emissionInterval
+        return 1;
+    }
+
+    u32 count = 0;
+    if (m_age <= header.emitterLifeTime) {
+        while (m_emissionTimer >= header.misc.emissionInterval) {
+            m_emissionTimer -= header.misc.emissionInterval;
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+void SPLEmitter::advanceTimers(f32 deltaTime) {
+    m_age += deltaTime;
+    m_emissionTimer += deltaTime;
+
+    if (m_state.looping && m_age > m_resource->header.emitterLifeTime) {
+        m_age = 0;
+        m_emissionTimer = 0;
+    }
 }
 
 void SPLEmitter::computeOrthogonalAxes() {
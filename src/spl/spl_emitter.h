@@ -29,12 +29,24 @@ public:
 
     bool shouldTerminate() const;
 
+    // Whether the emitter is done emitting, regardless of whether it still has live particles
+    bool isFinished() const;
+
     const SPLResource* getResource() const { return m_resource; }
 
+    // Moves the emitter over to another resource, e.g. the same one after its archive was reloaded.
+    // Position, age and live particles are kept, everything else is taken from the new resource.
+    void setResource(const SPLResource* resource);
+
 private:
+    void applyResource();
     void computeOrthogonalAxes();
     glm::vec3 tiltCoordinates(const glm::vec3& vec) const;
 
+    // Returns the number of emissions (of header.emissionCount particles each) due this frame
+    u32 consumeEmissions();
+    void advanceTimers(f32 deltaTime);
+
 private:
     const SPLResource *m_resource;
     ParticleSystem* m_system;
@@ -73,5 +85,7 @@ private:
     glm::vec3 m_crossAxis2;
 
     friend class ParticleSystem;
+    friend class GPUParticleSimulator;
     friend struct SPLCollisionPlaneBehavior;
+    friend struct SPLRandomBehavior;
 };
@@ -6,6 +6,23 @@
 #include <glm/gtx/norm.hpp>
 
 
+namespace {
+
+// The quad is built in the XY plane, reference plane 1 lays it flat onto XZ
+glm::mat4 getPlaneTransform(int referencePlane) {
+    if (referencePlane == 0) {
+        return glm::mat4(1);
+    }
+
+    return glm::mat4(
+        1, 0, 0, 0,
+        0, 0, 1, 0,
+        0, 1, 0, 0,
+        0, 0, 0, 1
+    );
+}
+
+}
 
 void SPLParticle::render(ParticleRenderer* renderer, const glm::vec3& cameraPos, f32 s, f32 t) const {
     switch (emitter->getResource()->header.flags.drawType) {
@@ -16,10 +33,13 @@ void SPLParticle::render(ParticleRenderer* renderer, const glm::vec3& cameraPos,
         renderDirectionalBillboard(renderer, cameraPos, s, t);
         break;
     case SPLDrawType::Polygon:
+        renderPolygon(renderer, s, t);
         break;
     case SPLDrawType::DirectionalPolygon:
+        renderDirectionalPolygon(renderer, s, t, false);
         break;
     case SPLDrawType::DirectionalPolygonCenter:
+        renderDirectionalPolygon(renderer, s, t, true);
         break;
     }
 }
@@ -29,54 +49,16 @@ glm::vec3 SPLParticle::getWorldPosition() const {
 }
 
 void SPLParticle::renderBillboard(ParticleRenderer* renderer, const glm::vec3& cameraPos, f32 s, f32 t) const {
-    const SPLResource* resource = emitter->getResource();
-    glm::vec3 scale = { baseScale * resource->header.aspectRatio, baseScale, 1 };
-
-    switch (resource->header.misc.scaleAnimDir) {
-    case SPLScaleAnimDir::XY:
-        scale.x *= animScale;
-        scale.y *= animScale;
-        break;
-    case SPLScaleAnimDir::X:
-        scale.x *= animScale;
-        break;
-    case SPLScaleAnimDir::Y:
-        scale.y *= animScale;
-        break;
-    }
-
     const auto transform = glm::translate(glm::mat4(1), getWorldPosition())
         * glm::rotate(glm::mat4(1), rotation, { 0, 0, 1 })
-        * glm::scale(glm::mat4(1), scale);
+        * glm::scale(glm::mat4(1), getScale());
 
-    renderer->submit(texture, {
-        .color = { color, visibility.baseAlpha * visibility.animAlpha },
-        .transform = transform,
-        .texCoords = {
-            { 0, 0 },
-            { s, 0 },
-            { s, t },
-            { 0, t }
-        }
-    });
+    submit(renderer, transform, s, t);
 }
 
 void SPLParticle::renderDirectionalBillboard(ParticleRenderer* renderer, const glm::vec3& cameraPos, f32 s, f32 t) const {
     const SPLResource* resource = emitter->getResource();
-    glm::vec3 scale = { baseScale * resource->header.aspectRatio, baseScale, 1 };
-
-    switch (resource->header.misc.scaleAnimDir) {
-    case SPLScaleAnimDir::XY:
-        scale.x *= animScale;
-        scale.y *= animScale;
-        break;
-    case SPLScaleAnimDir::X:
-        scale.x *= animScale;
-        break;
-    case SPLScaleAnimDir::Y:
-        scale.y *= animScale;
-        break;
-    }
+    glm::vec3 scale = getScale();
 
     const auto& view = renderer->getView();
     const auto cameraDir = glm::vec3(-view[0][2], -view[1][2], -view[2][2]);
@@ -103,6 +85,93 @@ void SPLParticle::renderDirectionalBillboard(ParticleRenderer* renderer, const g
         pos.x, pos.y, pos.z, 1
     );
 
+    submit(renderer, transform, s, t);
+}
+
+void SPLParticle::renderPolygon(ParticleRenderer* renderer, f32 s, f32 t) const {
+    const SPLResource* resource = emitter->getResource();
+    const auto& header = resource->header;
+
+    glm::mat4 rotationMatrix(1);
+    switch (header.flags.polygonRotAxis) {
+    case SPLPolygonRotAxis::Y:
+        rotationMatrix = glm::rotate(glm::mat4(1), rotation, { 0, 1, 0 });
+        break;
+    case SPLPolygonRotAxis::XYZ:
+        rotationMatrix = glm::rotate(glm::mat4(1), rotation, { 1, 0, 0 })
+            * glm::rotate(glm::mat4(1), rotation, { 0, 1, 0 })
+            * glm::rotate(glm::mat4(1), rotation, { 0, 0, 1 });
+        break;
+    }
+
+    const auto transform = glm::translate(glm::mat4(1), getWorldPosition())
+        * rotationMatrix
+        * getPlaneTransform(header.flags.polygonReferencePlane)
+        * glm::scale(glm::mat4(1), getScale())
+        * glm::translate(glm::mat4(1), { header.polygonX, header.polygonY, 0 });
+
+    submit(renderer, transform, s, t);
+}
+
+void SPLParticle::renderDirectionalPolygon(ParticleRenderer* renderer, f32 s, f32 t, bool center) const {
+    const SPLResource* resource = emitter->getResource();
+    const auto& header = resource->header;
+
+    // The polygon is stretched along its direction of travel, or away from the emitter
+    glm::vec3 dir = header.misc.dpolFaceEmitter ? position : velocity;
+    if (glm::length2(dir) < 0.0001f) {
+        return;
+    }
+
+    dir = glm::normalize(dir);
+
+    // The reference plane decides which way the polygon's face points when building the basis
+    glm::vec3 ref = header.flags.polygonReferencePlane == 0 ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+    if (glm::abs(glm::dot(dir, ref)) > 0.999f) {
+        ref = header.flags.polygonReferencePlane == 0 ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+    }
+
+    const auto side = glm::normalize(glm::cross(dir, ref));
+    const auto normal = glm::cross(side, dir);
+    const auto pos = getWorldPosition();
+    const auto basis = glm::mat4(
+        side.x, side.y, side.z, 0,
+        dir.x, dir.y, dir.z, 0,
+        normal.x, normal.y, normal.z, 0,
+        pos.x, pos.y, pos.z, 1
+    );
+
+    // Non-centered polygons start at the particle and extend forwards
+    const f32 offsetY = center ? header.polygonY : header.polygonY + 1.0f;
+    const auto transform = basis
+        * glm::rotate(glm::mat4(1), rotation, { 0, 1, 0 })
+        * glm::scale(glm::mat4(1), getScale())
+        * glm::translate(glm::mat4(1), { header.polygonX, offsetY, 0 });
+
+    submit(renderer, transform, s, t);
+}
+
+glm::vec3 SPLParticle::getScale() const {
+    const SPLResource* resource = emitter->getResource();
+    glm::vec3 scale = { baseScale * resource->header.aspectRatio, baseScale, 1 };
+
+    switch (resource->header.misc.scaleAnimDir) {
+    case SPLScaleAnimDir::XY:
+        scale.x *= animScale;
+        scale.y *= animScale;
+        break;
+    case SPLScaleAnimDir::X:
+        scale.x *= animScale;
+        break;
+    case SPLScaleAnimDir::Y:
+        scale.y *= animScale;
+        break;
+    }
+
+    return scale;
+}
+
+void SPLParticle::submit(ParticleRenderer* renderer, const glm::mat4& transform, f32 s, f32 t) const {
     renderer->submit(texture, {
         .color = { color, visibility.baseAlpha * visibility.animAlpha },
         .transform = transform,
@@ -16,6 +16,11 @@ public:
 private:
     void renderBillboard(ParticleRenderer* renderer, const glm::vec3& cameraPos, f32 s, f32 t) const;
     void renderDirectionalBillboard(ParticleRenderer* renderer, const glm::vec3& cameraPos, f32 s, f32 t) const;
+    void renderPolygon(ParticleRenderer* renderer, f32 s, f32 t) const;
+    void renderDirectionalPolygon(ParticleRenderer* renderer, f32 s, f32 t, bool center) const;
+
+    glm::vec3 getScale() const;
+    void submit(ParticleRenderer* renderer, const glm::mat4& transform, f32 s, f32 t) const;
 
 public:
     SPLEmitter* emitter; // The emitter that spawned this particle
@@ -0,0 +1,179 @@
+#include "spl_resource_index.h"
+#include "spl_catalog.h"
+#include "enum_names.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <fmt/format.h>
+
+
+namespace {
+
+constexpr std::array s_queryKeys = { "format", "behavior", "draw", "emission", "texhash", "reshash", "child", "anim" };
+
+// "Directional Billboard" -> "directionalbillboard", so names can be typed without quoting
+std::string normalize(std::string_view value) {
+    std::string result;
+    result.reserve(value.size());
+
+    for (const char c : value) {
+        if (std::isalnum((unsigned char)c)) {
+            result.push_back((char)std::tolower((unsigned char)c));
+        }
+    }
+
+    return result;
+}
+
+std::vector<u64> intersect(const std::vector<u64>& a, const std::vector<u64>& b) {
+    std::vector<u64> result;
+    result.reserve(std::min(a.size(), b.size()));
+    std::ranges::set_intersection(a, b, std::back_inserter(result));
+    return result;
+}
+
+}
+
+
+void SPLResourceIndex::build(const SPLCatalog& catalog) {
+    m_files.clear();
+    m_postings.clear();
+    m_all.clear();
+
+    // Sorted so file indices (and with them the query results) are stable
+    std::vector<const SPLCatalogEntry*> entries;
+    entries.reserve(catalog.size());
+    for (const auto& [path, entry] : catalog.getEntries()) {
+        entries.push_back(&entry);
+    }
+
+    std::ranges::sort(entries, {}, &SPLCatalogEntry::path);
+
+    for (const auto entry : entries) {
+        const u64 file = m_files.size();
+        m_files.push_back(entry->path);
+
+        for (size_t i = 0; i < entry->resources.size(); i++) {
+            const auto& resource = entry->resources[i];
+            const u64 ref = file << 16 | i;
+            m_all.push_back(ref);
+
+            add("emission", getEmissionType((SPLEmissionType)resource.emissionType), ref);
+            add("draw", getDrawType((SPLDrawType)resource.drawType), ref);
+            add("child", resource.features & SPLCatalogEntry::ChildResource ? "yes" : "no", ref);
+            add("reshash", fmt::format("{:016x}", resource.hash), ref);
+
+            for (u32 type = 0; type < 6; type++) {
+                if (resource.behaviors & (1 << type)) {
+                    add("behavior", getBehaviorType((SPLBehaviorType)type), ref);
+                }
+            }
+
+            constexpr std::array anims = {
+                std::pair{ SPLCatalogEntry::ScaleAnim, "scale" },
+                std::pair{ SPLCatalogEntry::ColorAnim, "color" },
+                std::pair{ SPLCatalogEntry::AlphaAnim, "alpha" },
+                std::pair{ SPLCatalogEntry::TexAnim, "tex" }
+            };
+
+            for (const auto& [feature, name] : anims) {
+                if (resource.features & feature) {
+                    add("anim", name, ref);
+                }
+            }
+
+            for (u32 t = 0; t < resource.textureCount; t++) {
+                const u8 texture = resource.textures[t];
+                if (texture >= entry->textures.size()) {
+                    continue;
+                }
+
+                add("format", getTextureFormat((TextureFormat)entry->textures[texture].format), ref);
+                add("texhash", fmt::format("{:016x}", entry->textures[texture].hash), ref);
+            }
+        }
+    }
+}
+
+SPLResourceIndex::QueryResult SPLResourceIndex::query(std::string_view query) const {
+    const auto start = std::chrono::steady_clock::now();
+    QueryResult result;
+
+    static const PostingList s_empty;
+    std::vector<const PostingList*> required;
+    std::vector<const PostingList*> excluded;
+
+    size_t position = 0;
+    while (position < query.size()) {
+        const size_t begin = query.find_first_not_of(" \t", position);
+        if (begin == std::string_view::npos) {
+            break;
+        }
+
+        const size_t end = std::min(query.find_first_of(" \t", begin), query.size());
+        auto token = query.substr(begin, end - begin);
+        position = end;
+
+        const bool negate = token.starts_with('-');
+        if (negate) {
+            token.remove_prefix(1);
+        }
+
+        const size_t colon = token.find(':');
+        if (colon == std::string_view::npos) {
+            result.error = fmt::format("Expected key:value, got '{}'", token);
+            return result;
+        }
+
+        const auto key = normalize(token.substr(0, colon));
+        if (std::ranges::find(s_queryKeys, key) == s_queryKeys.end()) {
+            result.error = fmt::format("Unknown key '{}', expected one of: {}", key, QUERY_KEYS);
+            return result;
+        }
+
+        const auto it = m_postings.find(makeTerm(key, token.substr(colon + 1)));
+        const auto list = it != m_postings.end() ? &it->second : &s_empty;
+        (negate ? excluded : required).push_back(list);
+    }
+
+    if (required.empty() && excluded.empty()) {
+        return result;
+    }
+
+    // Start with the rarest term so every following intersection is as small as possible
+    std::ranges::sort(required, {}, [](const PostingList* list) { return list->size(); });
+
+    PostingList matches = required.empty() ? m_all : *required.front();
+    for (size_t i = 1; i < required.size() && !matches.empty(); i++) {
+        matches = intersect(matches, *required[i]);
+    }
+
+    for (const auto list : excluded) {
+        PostingList remaining;
+        std::ranges::set_difference(matches, *list, std::back_inserter(remaining));
+        matches = std::move(remaining);
+    }
+
+    result.matches.reserve(matches.size());
+    for (const u64 ref : matches) {
+        result.matches.push_back({ (u32)(ref >> 16), (u16)(ref & 0xFFFF) });
+    }
+
+    result.milliseconds = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::string SPLResourceIndex::makeTerm(std::string_view key, std::string_view value) {
+    return normalize(key) + ':' + normalize(value);
+}
+
+void SPLResourceIndex::add(std::string_view key, std::string_view value, u64 ref) {
+    auto& list = m_postings[makeTerm(key, value)];
+
+    // A resource can reference the same format or texture several times
+    if (list.empty() || list.back() != ref) {
+        list.push_back(ref);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+class SPLCatalog;
+
+struct SPLResourceRef {
+    u32 file; // Index into SPLResourceIndex::getFiles()
+    u16 resource;
+};
+
+// Inverted index over the resources in an SPLCatalog.
+// Queries are whitespace separated key:value terms that all have to match, '-' negates a term:
+//   format:comp4x4 behavior:magnet -child:yes
+class SPLResourceIndex {
+public:
+    struct QueryResult {
+        std::vector<SPLResourceRef> matches;
+        std::string error;
+        f64 milliseconds = 0;
+    };
+
+    void build(const SPLCatalog& catalog);
+    QueryResult query(std::string_view query) const;
+
+    const std::vector<std::string>& getFiles() const { return m_files; }
+    size_t getResourceCount() const { return m_all.size(); }
+    size_t getTermCount() const { return m_postings.size(); }
+
+    static constexpr const char* QUERY_KEYS = "format, behavior, draw, emission, texhash, reshash, child, anim";
+
+private:
+    // Sorted (file << 16 | resource), which makes intersections a linear merge
+    using PostingList = std::vector<u64>;
+
+    static std::string makeTerm(std::string_view key, std::string_view value);
+    void add(std::string_view key, std::string_view value, u64 ref);
+
+private:
+    std::vector<std::string> m_files;
+    std::unordered_map<std::string, PostingList> m_postings;
+    PostingList m_all;
+};
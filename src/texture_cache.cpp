@@ -0,0 +1,184 @@
+#include "texture_cache.h"
+#include "hash.h"
+#include "spl/spl_resource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <spdlog/spdlog.h>
+
+
+namespace {
+
+struct BlobHeader {
+    u32 magic;
+    u32 version;
+    u16 width;
+    u16 height;
+    u32 size;
+};
+
+static_assert(sizeof(BlobHeader) == TextureCache::HEADER_SIZE);
+
+// Temporary files of crashed writers
+constexpr auto s_staleTempAge = std::chrono::hours(1);
+
+}
+
+
+TextureCache::TextureCache(std::filesystem::path directory, u64 maxSize)
+    : m_directory(std::move(directory)), m_maxSize(maxSize) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    if (ec) {
+        spdlog::warn("Failed to create texture cache {}: {}", m_directory.string(), ec.message());
+    }
+
+    // Also establishes the initial size
+    evict();
+}
+
+TextureCache::~TextureCache() {
+    spdlog::info("Texture cache: {} hits, {} misses, {:.1f} MB", m_hits.load(), m_misses.load(), m_size / (1024.0 * 1024.0));
+}
+
+u64 TextureCache::makeKey(const SPLTextureParam& param, size_t width, size_t height, std::span<const u8> tex, std::span<const u8> pal) {
+    const u64 settings = (u64)CACHE_VERSION << 48
+        | (u64)param.format << 40
+        | (u64)param.palColor0Transparent << 32
+        | (u64)width << 16
+        | (u64)height;
+
+    return hash::xxh64(pal, hash::xxh64(tex, settings));
+}
+
+std::optional<MappedFile> TextureCache::find(u64 key, size_t width, size_t height) {
+    const auto path = getBlobPath(key);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        ++m_misses;
+        return std::nullopt;
+    }
+
+    MappedFile file(path);
+    const size_t size = width * height * 4;
+
+    BlobHeader header;
+    const auto data = file.getData();
+    if (data.size() != sizeof(header) + size) {
+        ++m_misses;
+        return std::nullopt;
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != BLOB_MAGIC || header.version != CACHE_VERSION || header.width != width || header.height != height || header.size != size) {
+        ++m_misses;
+        return std::nullopt;
+    }
+
+    // The write time doubles as the last access time for eviction
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+    ++m_hits;
+    return file;
+}
+
+void TextureCache::store(u64 key, size_t width, size_t height, std::span<const u8> pixels) {
+    if (pixels.size() != width * height * 4) {
+        return;
+    }
+
+    const auto path = getBlobPath(key);
+    const auto temp = m_directory / fmt::format("{:016x}.{:08x}.tmp", key, std::random_device{}());
+
+    {
+        const BlobHeader header = { BLOB_MAGIC, CACHE_VERSION, (u16)width, (u16)height, (u32)pixels.size() };
+
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        stream.write((const char*)&header, sizeof(header));
+        stream.write((const char*)pixels.data(), (std::streamsize)pixels.size());
+
+        if (!stream) {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+
+    // Replaces a blob another process stored in the meantime, which has the same contents anyway
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        return;
+    }
+
+    if ((m_size += sizeof(BlobHeader) + pixels.size()) > m_maxSize) {
+        evict();
+    }
+}
+
+std::filesystem::path TextureCache::getBlobPath(u64 key) const {
+    return m_directory / fmt::format("{:016x}.rgba", key);
+}
+
+void TextureCache::evict() {
+    std::scoped_lock lock(m_evictMutex);
+
+    struct Blob {
+        std::filesystem::path path;
+        std::filesystem::file_time_type lastUse;
+        u64 size;
+    };
+
+    std::vector<Blob> blobs;
+    u64 total = 0;
+    const auto now = std::filesystem::file_time_type::clock::now();
+
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(m_directory, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::error_code entryError;
+        const auto lastWrite = it->last_write_time(entryError);
+        const u64 size = it->file_size(entryError);
+        if (entryError) {
+            continue;
+        }
+
+        if (it->path().extension() == ".tmp") {
+            if (now - lastWrite > s_staleTempAge) {
+                std::filesystem::remove(it->path(), entryError);
+            }
+
+            continue;
+        }
+
+        blobs.push_back({ it->path(), lastWrite, size });
+        total += size;
+    }
+
+    // Shrink well below the limit so a busy session doesn't rescan the directory on every store
+    if (total > m_maxSize) {
+        std::ranges::sort(blobs, {}, &Blob::lastUse);
+
+        size_t removed = 0;
+        for (const auto& blob : blobs) {
+            if (total <= m_maxSize / 4 * 3) {
+                break;
+            }
+
+            // Fails for blobs another process has mapped on Windows, they go next time
+            if (std::filesystem::remove(blob.path, ec)) {
+                total -= blob.size;
+                ++removed;
+            }
+        }
+
+        spdlog::info("Evicted {} textures from the cache", removed);
+    }
+
+    m_size = total;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "types.h"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+
+struct SPLTextureParam;
+
+// On-disk cache of decoded RGBA8 textures, shared by every running instance.
+// Every blob is its own file named after its key. Blobs are written to a temporary file and renamed
+// into place, so readers (in any process) only ever see complete files, and are mapped when read.
+// Hits refresh the file's write time, once the cache outgrows its limit the least recently used
+// blobs are deleted.
+class TextureCache {
+public:
+    explicit TextureCache(std::filesystem::path directory, u64 maxSize = DEFAULT_MAX_SIZE);
+    ~TextureCache();
+
+    // Covers everything the decoded pixels depend on
+    static u64 makeKey(const SPLTextureParam& param, size_t width, size_t height, std::span<const u8> tex, std::span<const u8> pal);
+
+    // Maps the cached pixels, nothing if they aren't cached (or the blob is damaged)
+    std::optional<MappedFile> find(u64 key, size_t width, size_t height);
+    void store(u64 key, size_t width, size_t height, std::span<const u8> pixels);
+
+    u64 getHits() const { return m_hits; }
+    u64 getMisses() const { return m_misses; }
+    u64 getSize() const { return m_size; }
+
+    // Offset of the pixels in a mapped blob
+    static constexpr size_t HEADER_SIZE = 16;
+
+    static constexpr u64 DEFAULT_MAX_SIZE = 256ull * 1024 * 1024;
+
+private:
+    // Bump when the decoders change, old blobs are then never hit again and age out
+    static constexpr u32 CACHE_VERSION = 1;
+    static constexpr u32 BLOB_MAGIC = 0x42435854; // 'TXCB'
+
+    std::filesystem::path getBlobPath(u64 key) const;
+    void evict();
+
+private:
+    std::filesystem::path m_directory;
+    u64 m_maxSize;
+
+    std::mutex m_evictMutex;
+    std::atomic<u64> m_size = 0; // Estimate, other processes write to the same directory
+    std::atomic<u64> m_hits = 0;
+    std::atomic<u64> m_misses = 0;
+};
+
+inline TextureCache* g_textureCache = nullptr;